@@ -325,6 +325,12 @@ RC_CHECK_PROG([$PKG_CONFIG], [--cflags gl], [--libs gl],
 
 ])
 
+#CLOCK_GETTIME (for timing, part of librt on older systems, w32 got its own):
+if test "$RC_TARGET" != "w32"; then
+	AC_SEARCH_LIBS([clock_gettime], [rt],,
+		[AC_MSG_ERROR([clock_gettime appears to be missing, install librt or similar])])
+fi
+
 #make available
 AC_SUBST(RC_FLAGS)
 AC_SUBST(RC_LIBS)
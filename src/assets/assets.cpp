@@ -23,23 +23,96 @@
 #include "common/log.hpp"
 #include <stdio.h>
 #include <string.h>
+#include <SDL/SDL_mutex.h>
 
 Assets *Assets::head = NULL;
 
+//starts out with room for quite many assets
+#define ASSETS_BUCKETS 256
+
+Assets **Assets::buckets = new Assets*[ASSETS_BUCKETS]();
+Uint32 Assets::bucket_count = ASSETS_BUCKETS;
+Uint32 Assets::count = 0;
+
+//(created before any threads can exist)
+static SDL_mutex *assets_mutex = SDL_CreateMutex();
+
+void Assets::Lock()
+{
+	SDL_mutexP(assets_mutex);
+}
+
+void Assets::Unlock()
+{
+	SDL_mutexV(assets_mutex);
+}
+
+//FNV-1a of string
+Uint32 Assets::Hash(const char *name)
+{
+	Uint32 hash = 2166136261u;
+	for (; *name; ++name)
+	{
+		hash ^= (Uint8)*name;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+//move all assets to new table
+void Assets::Rehash(Uint32 size)
+{
+	Log_Add(2, "resizing asset table to %u buckets", size);
+
+	Assets **old = buckets;
+	Uint32 old_count = bucket_count;
+	buckets = new Assets*[size]();
+	bucket_count = size;
+
+	Assets *tmp, *tmp_next;
+	for (Uint32 i=0; i<old_count; ++i)
+		for (tmp=old[i]; tmp; tmp=tmp_next)
+		{
+			tmp_next = tmp->bucket_next;
+			tmp->bucket_next = buckets[tmp->hash&(size-1)];
+			buckets[tmp->hash&(size-1)] = tmp;
+		}
+
+	delete[] old;
+}
+
 Assets::Assets(const char *n)
 {
 	name = new char[strlen(n)+1];
 	strcpy (name, n);
+	hash = Hash(name);
+
+	Lock();
 
 	prev = NULL;
 	next = head;
+	if (head)
+		head->prev = this;
 	head = this;
+
+	//keep about one asset per bucket
+	if (++count > bucket_count)
+		Rehash(bucket_count*2);
+
+	Assets **bucket = &buckets[hash&(bucket_count-1)];
+	bucket_next = *bucket;
+	*bucket = this;
+
+	Unlock();
 }
 
 Assets::~Assets()
 {
 	Log_Add(2, "removing asset called \"%s\"", name);
 
+	Lock();
+
 	//remove from list
 	if (prev)
 		prev->next=next;
@@ -48,6 +121,14 @@ Assets::~Assets()
 	if (next)
 		next->prev=prev;
 
+	//and from table
+	Assets **tmp;
+	for (tmp=&buckets[hash&(bucket_count-1)]; *tmp != this; tmp=&(*tmp)->bucket_next);
+	*tmp = bucket_next;
+	--count;
+
+	Unlock();
+
 	//remove string name
 	delete[] name;
 
@@ -62,4 +143,3 @@ void Assets::Clear_TMP()
 		delete head;
 
 }
-
@@ -24,6 +24,7 @@
 
 #include <typeinfo>
 #include <string.h>
+#include <SDL/SDL_stdinc.h>
 #include "common/log.hpp"
 
 class Assets
@@ -37,20 +38,24 @@ class Assets
 		template<typename T>
 		static T *Find(const char *name)
 		{
+			Uint32 hash = Hash(name);
 			Assets *tmp;
-			T *casted;
+			T *casted = NULL;
 
-			for (tmp=head; tmp; tmp=tmp->next) //loop
+			//only look through assets with same hash (bucket)
+			Lock();
+			for (tmp=buckets[hash&(bucket_count-1)]; tmp; tmp=tmp->bucket_next)
 			{
 				//type conversion+casting ok
-				if ((!strcmp(tmp->name, name)) && (casted=dynamic_cast<T*>(tmp)))
-				{
-					Log_Add(2, "asset data already existed for \"%s\" (already loaded)", name);
-					return casted;
-				}
+				if (tmp->hash == hash && (!strcmp(tmp->name, name)) && (casted=dynamic_cast<T*>(tmp)))
+					break;
 			}
+			Unlock();
 
-			return NULL; //else
+			if (casted)
+				Log_Add(2, "asset data already existed for \"%s\" (already loaded)", name);
+
+			return casted;
 		}
 
 	protected:
@@ -60,8 +65,21 @@ class Assets
 
 	private:
 		char *name; //name of specific data
+		Uint32 hash; //of name
 
 		static Assets *head;
 		Assets *prev, *next;
+
+		//hash table of all assets (by name), buckets are power of two
+		static Assets **buckets;
+		static Uint32 bucket_count, count;
+		Assets *bucket_next;
+
+		static Uint32 Hash(const char *name);
+		static void Rehash(Uint32 size);
+
+		//lookups and changes are thread safe
+		static void Lock();
+		static void Unlock();
 };
 #endif
@@ -22,6 +22,7 @@
 #include "car.hpp"
 #include "text_file.hpp"
 #include "assets.hpp"
+#include "loader.hpp"
 #include "assets/track.hpp"
 #include "common/internal.hpp"
 #include "common/log.hpp"
@@ -38,6 +39,7 @@ Car_Module::Car_Module(const char *name) :Assets(name)
 }
 
 Car *Car::head = NULL;
+unsigned int Car::serial_next = 0;
 
 //allocates car, add to list...
 Car::Car(void)
@@ -54,6 +56,8 @@ Car::Car(void)
 	oldsteerlimit = 0;
 	velocity = 0;
 
+	serial = serial_next++;
+
 	//linking
 	next=head;
 	head=this;
@@ -79,6 +83,13 @@ Car::~Car()
 		next->prev = prev;
 }
 
+//trimesh geom waiting for model to be processed
+struct Pending_Mesh
+{
+	size_t geom; //index in geoms
+	Model *model;
+};
+
 //loading/creating:
 Car_Module *Car_Module::Load (const char *path)
 {
@@ -114,6 +125,41 @@ Car_Module *Car_Module::Load (const char *path)
 		Load_Conf(dirs.Path(), (char *)&target->camera, camera_conf_index)) )
 		Log_Add(0, "WARNING: can not open camera configuration (%s)!", filepath.c_str());
 
+	//models are processed by loader (in parallel) while reading the rest, and
+	//created when done
+	Model *draw_model = NULL;
+	bool model_failed = false;
+	std::vector<Pending_Mesh> meshes;
+
+	//3D model, if specified
+	if (target->conf.model[0] != '\0')
+	{
+		char file[strlen(path)+1+strlen(target->conf.model)+1];
+		strcpy(file, path);
+		strcat(file, "/");
+		strcat(file, target->conf.model);
+
+		//check if already exists
+		if (!(target->model = Assets::Find<Model_Draw>(file)))
+		{
+			draw_model = new Model();
+
+			if (draw_model->Load(file))
+			{
+				draw_model->Resize(target->conf.resize);
+				draw_model->Rotate(target->conf.rotate[0], target->conf.rotate[1], target->conf.rotate[2]);
+				draw_model->Offset(target->conf.offset[0], target->conf.offset[1], target->conf.offset[2]);
+				Loader_Add_Model(draw_model);
+			}
+			else
+			{
+				delete draw_model;
+				draw_model = NULL;
+				model_failed = true;
+			}
+		}
+	}
+
 	//geoms.lst
 	filepath=path;
 	filepath+="/geoms.lst";
@@ -190,13 +236,25 @@ Car_Module *Car_Module::Load (const char *path)
 					strcat(model, "/");
 					strcat(model, file.words[1]);
 
-					tmp_geom.mesh = Model_Mesh::Quick_Load(model, atof(file.words[2]), 0, 0, 0, 0, 0, 0);
-
-					//failed to load
-					if (!tmp_geom.mesh)
+					//check if already exists
+					if (!(tmp_geom.mesh = Assets::Find<Model_Mesh>(model)))
 					{
-						Log_Add(-1, "Trimesh geom in car geom list could not be loaded!");
-						continue; //don't add
+						Model *mesh = new Model();
+
+						//failed to load
+						if (!mesh->Load(model))
+						{
+							Log_Add(-1, "Trimesh geom in car geom list could not be loaded!");
+							delete mesh;
+							continue; //don't add
+						}
+
+						mesh->Resize(atof(file.words[2]));
+						Loader_Add_Model(mesh);
+
+						//created when done (this will be the next geom)
+						Pending_Mesh pending = {target->geoms.size(), mesh};
+						meshes.push_back(pending);
 					}
 
 					pos = 3;
@@ -270,26 +328,43 @@ Car_Module *Car_Module::Load (const char *path)
 	}
 
 
-	//load model if specified
+	//wait for models to be processed
+	Loader_Wait();
+
+	//create trimeshes (backwards, removing failed geoms)
+	for (size_t i=meshes.size(); i>0; --i)
+	{
+		Pending_Mesh *pending = &meshes[i-1];
+
+		if (!(target->geoms[pending->geom].mesh = pending->model->Create_Mesh()))
+		{
+			Log_Add(-1, "Trimesh geom in car geom list could not be loaded!");
+			target->geoms.erase(target->geoms.begin()+pending->geom);
+		}
+
+		delete pending->model;
+	}
+
+	//create model if specified
 	if (target->conf.model[0] == '\0') //empty string
 	{
 		Log_Add(1, "WARNING: no car 3D model specified\n");
 		target->model=NULL;
 	}
-	else
+	else if (draw_model)
 	{
-		char file[strlen(path)+1+strlen(target->conf.model)+1];
-		strcpy(file, path);
-		strcat(file, "/");
-		strcat(file, target->conf.model);
+		target->model = draw_model->Create_Draw();
+		delete draw_model;
 
-		if ( !(target->model = Model_Draw::Quick_Load(file,
-				target->conf.resize,
-				target->conf.rotate[0], target->conf.rotate[1], target->conf.rotate[2],
-				target->conf.offset[0], target->conf.offset[1], target->conf.offset[2])) )
-			return NULL;
+		if (!target->model)
+			model_failed = true;
 	}
 
+	Loader_Clear(); //(decoded textures)
+
+	if (model_failed)
+		return NULL;
+
 	return target;
 }
 
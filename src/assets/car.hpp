@@ -460,8 +460,17 @@ class Car:public Object
 		static Car *head;
 		Car *prev, *next;
 
+		//unique, in order of creation (new cars are added at head of list,
+		//so position in list changes)
+		unsigned int serial;
+		static unsigned int serial_next;
+
 		//controls car
 		friend void Profile_Input_Step(Uint32 step);
+		friend bool Input_Log_Record(const char *file);
+		friend bool Input_Log_Replay(const char *file, unsigned int *steps);
+		friend void Input_Log_Step();
+		friend class Snapshot; //saves/restores state
 
 		//tmp: needs access to above pointers
 		friend int Interface_Loop ();
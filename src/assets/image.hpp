@@ -50,7 +50,7 @@ class Image_Texture: public Assets
 		friend void Render_List_Render();
 
 		//to allow destruction of temporary splash image texture
-		friend bool Interface_Splash(const char*, int, int);
+		friend void Interface_Splash_Quit();
 };
 
 //used to temporarily store image
@@ -0,0 +1,272 @@
+/*
+ * ReCaged - a Free Software, Futuristic, Racing Game
+ *
+ * Copyright (C) 2015 Mats Wahlberg
+ *
+ * This file is part of ReCaged.
+ *
+ * ReCaged is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ReCaged is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ReCaged.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <SDL/SDL_thread.h>
+#include <SDL/SDL_mutex.h>
+#include <SDL/SDL_timer.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "loader.hpp"
+#include "common/log.hpp"
+#include "common/clock.hpp"
+#include "common/threads.hpp"
+
+//one thing to do: process model or decode image
+struct Loader_Job
+{
+	Model *model; //(NULL if image)
+	size_t image; //(index in loader_images)
+};
+
+struct Loader_Image
+{
+	std::string name;
+	Image *image; //NULL until decoded (or if failed)
+};
+
+//everything protected by mutex (cond signaled when added or finished jobs)
+static SDL_mutex *loader_mutex = NULL;
+static SDL_cond *loader_cond = NULL;
+static bool loader_quit = false;
+
+static std::vector<SDL_Thread*> loader_threads;
+static std::deque<Loader_Job> loader_queue;
+static std::vector<Loader_Image> loader_images;
+
+//progress (since last wait)
+static unsigned int loader_total = 0, loader_done = 0;
+
+//run next job in queue (mutex locked when called and returning)
+static void Loader_Run()
+{
+	Loader_Job job = loader_queue.front();
+	loader_queue.pop_front();
+
+	//nothing shared, can unlock while working
+	if (job.model)
+	{
+		SDL_mutexV(loader_mutex);
+
+		//(failures are reported again when creating the actual assets)
+		job.model->Prepare();
+
+		SDL_mutexP(loader_mutex);
+	}
+	else
+	{
+		std::string name = loader_images[job.image].name;
+		SDL_mutexV(loader_mutex);
+
+		Image *image = new Image();
+		if (!image->Load(name.c_str()))
+		{
+			delete image;
+			image = NULL;
+		}
+
+		SDL_mutexP(loader_mutex);
+		loader_images[job.image].image = image;
+	}
+
+	++loader_done;
+	SDL_CondBroadcast(loader_cond);
+}
+
+static int Loader_Thread_Loop(void *data)
+{
+	SDL_mutexP(loader_mutex);
+
+	while (!loader_quit)
+	{
+		if (loader_queue.empty())
+			SDL_CondWait(loader_cond, loader_mutex);
+		else
+			Loader_Run();
+	}
+
+	SDL_mutexV(loader_mutex);
+	return 0;
+}
+
+//number of cpu cores
+static int Loader_Cores()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors;
+#else
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	return cores > 0? cores: 1;
+#endif
+}
+
+void Loader_Init(int threads)
+{
+	loader_mutex = SDL_CreateMutex();
+	loader_cond = SDL_CreateCond();
+	loader_quit = false;
+	loader_total = 0;
+	loader_done = 0;
+
+	if (threads <= 0)
+		threads = Loader_Cores();
+
+	//main thread is also working (while waiting)
+	for (int i=1; i<threads; ++i)
+	{
+		SDL_Thread *thread = SDL_CreateThread(Loader_Thread_Loop, NULL);
+
+		if (!thread)
+		{
+			Log_Add(0, "WARNING: could only create %i threads for loading", i);
+			break;
+		}
+
+		loader_threads.push_back(thread);
+	}
+
+	Log_Add(1, "Using %i threads for loading", (int)loader_threads.size()+1);
+}
+
+void Loader_Quit()
+{
+	SDL_mutexP(loader_mutex);
+	loader_quit = true;
+	SDL_CondBroadcast(loader_cond);
+	SDL_mutexV(loader_mutex);
+
+	for (size_t i=0; i<loader_threads.size(); ++i)
+		SDL_WaitThread(loader_threads[i], NULL);
+	loader_threads.clear();
+
+	//anything left (should not be)
+	loader_queue.clear();
+	Loader_Clear();
+
+	SDL_DestroyCond(loader_cond);
+	SDL_DestroyMutex(loader_mutex);
+	loader_cond = NULL;
+	loader_mutex = NULL;
+}
+
+int Loader_Thread_Count()
+{
+	return loader_threads.size()+1;
+}
+
+void Loader_Add_Model(Model *model)
+{
+	Loader_Job job = {model, 0};
+
+	SDL_mutexP(loader_mutex);
+	loader_queue.push_back(job);
+	++loader_total;
+	SDL_CondBroadcast(loader_cond);
+	SDL_mutexV(loader_mutex);
+}
+
+void Loader_Add_Image(const char *file)
+{
+	SDL_mutexP(loader_mutex);
+
+	//already queued?
+	for (size_t i=0; i<loader_images.size(); ++i)
+		if (loader_images[i].name == file)
+		{
+			SDL_mutexV(loader_mutex);
+			return;
+		}
+
+	Loader_Image image = {file, NULL};
+	Loader_Job job = {NULL, loader_images.size()};
+
+	loader_images.push_back(image);
+	loader_queue.push_back(job);
+	++loader_total;
+	SDL_CondBroadcast(loader_cond);
+	SDL_mutexV(loader_mutex);
+}
+
+void Loader_Wait()
+{
+	Uint64 start = Clock_Get();
+	Uint32 shown = SDL_GetTicks();
+	float progress;
+
+	SDL_mutexP(loader_mutex);
+
+	while (loader_done != loader_total)
+	{
+		//help out, or wait for others
+		if (!loader_queue.empty())
+			Loader_Run();
+		else
+			SDL_CondWaitTimeout(loader_cond, loader_mutex, 100);
+
+		//update splash screen now and then (might wait for vsync)
+		if (SDL_GetTicks()-shown >= 50)
+		{
+			progress = (float)loader_done/(float)loader_total;
+
+			SDL_mutexV(loader_mutex);
+			Interface_Splash_Progress(progress);
+			shown = SDL_GetTicks();
+			SDL_mutexP(loader_mutex);
+		}
+	}
+
+	//all done, start over
+	unsigned int total = loader_total;
+	loader_total = 0;
+	loader_done = 0;
+
+	SDL_mutexV(loader_mutex);
+
+	if (total)
+		Log_Add(2, "Loaded %u models/images in %fms", total, (Clock_Get()-start)/1000000.0);
+}
+
+Image *Loader_Find_Image(const char *file)
+{
+	//(only after wait, no locking needed)
+	for (size_t i=0; i<loader_images.size(); ++i)
+		if (loader_images[i].name == file)
+			return loader_images[i].image;
+
+	return NULL;
+}
+
+void Loader_Clear()
+{
+	for (size_t i=0; i<loader_images.size(); ++i)
+		delete loader_images[i].image;
+	loader_images.clear();
+}
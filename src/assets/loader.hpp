@@ -0,0 +1,53 @@
+/*
+ * ReCaged - a Free Software, Futuristic, Racing Game
+ *
+ * Copyright (C) 2015 Mats Wahlberg
+ *
+ * This file is part of ReCaged.
+ *
+ * ReCaged is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ReCaged is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ReCaged.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+#ifndef _ReCaged_LOADER_H
+#define _ReCaged_LOADER_H
+//loading of assets in parallel: reading, parsing and processing models and
+//decoding images is done by a pool of worker threads (and by the main thread
+//while waiting), while creation of the final assets (uploading to the gpu) is
+//left for the main thread (the only one with an opengl context)
+
+#include "model.hpp"
+#include "image.hpp"
+
+//start and stop threads (0=one per cpu core)
+void Loader_Init(int threads);
+void Loader_Quit();
+
+//how many threads (including main thread), for splitting up big jobs
+int Loader_Thread_Count();
+
+//queue model for processing (and its textures for decoding). Not allowed to
+//touch model until Loader_Wait returns
+void Loader_Add_Model(Model *model);
+//queue image for decoding (once)
+void Loader_Add_Image(const char *file);
+
+//process queue until everything is done (showing progress on splash screen)
+void Loader_Wait();
+
+//decoded image, NULL if not queued (or failed)
+Image *Loader_Find_Image(const char *file);
+//remove all decoded images (when not needed anymore)
+void Loader_Clear();
+
+#endif
@@ -0,0 +1,149 @@
+/*
+ * ReCaged - a Free Software, Futuristic, Racing Game
+ *
+ * Copyright (C) 2015 Mats Wahlberg
+ *
+ * This file is part of ReCaged.
+ *
+ * ReCaged is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ReCaged is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ReCaged.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+#include "mapped_file.hpp"
+#include "common/log.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+Mapped_File::Mapped_File()
+{
+	data = NULL;
+	size = 0;
+	mapped = false;
+}
+
+Mapped_File::~Mapped_File()
+{
+	Close();
+}
+
+bool Mapped_File::Open(const char *file)
+{
+	Close();
+
+#ifndef _WIN32
+	//try mapping it
+	int fd = open(file, O_RDONLY);
+	if (fd == -1)
+	{
+		Log_Add(-1, "Could not open file \"%s\": %s", file, strerror(errno));
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) == 0)
+	{
+		size = st.st_size;
+
+		//(can't map empty file, but that's fine)
+		if (!size)
+		{
+			close(fd);
+			data = "";
+			return true;
+		}
+
+		void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map != MAP_FAILED)
+		{
+			close(fd);
+
+			//will be read from start to end
+			madvise(map, size, MADV_SEQUENTIAL);
+
+			data = (const char*)map;
+			mapped = true;
+			return true;
+		}
+	}
+
+	close(fd);
+	Log_Add(2, "could not map \"%s\", reading it instead", file);
+#endif
+
+	//read whole file to buffer
+	FILE *fp = fopen(file, "rb");
+	if (!fp)
+	{
+		Log_Add(-1, "Could not open file \"%s\": %s", file, strerror(errno));
+		return false;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	long length = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	if (length < 0)
+	{
+		Log_Add(-1, "Could not get size of file \"%s\"", file);
+		fclose(fp);
+		return false;
+	}
+
+	size = length;
+	if (!size)
+	{
+		fclose(fp);
+		data = "";
+		return true;
+	}
+
+	char *buffer = new char[size];
+
+	if (fread(buffer, size, 1, fp) != 1)
+	{
+		Log_Add(-1, "Could not read file \"%s\"", file);
+		delete[] buffer;
+		fclose(fp);
+		size = 0;
+		return false;
+	}
+
+	fclose(fp);
+	data = buffer;
+	return true;
+}
+
+void Mapped_File::Close()
+{
+	if (mapped)
+	{
+#ifndef _WIN32
+		munmap((void*)data, size);
+#endif
+	}
+	else if (size)
+		delete[] data;
+
+	data = NULL;
+	size = 0;
+	mapped = false;
+}
@@ -0,0 +1,44 @@
+/*
+ * ReCaged - a Free Software, Futuristic, Racing Game
+ *
+ * Copyright (C) 2015 Mats Wahlberg
+ *
+ * This file is part of ReCaged.
+ *
+ * ReCaged is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ReCaged is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ReCaged.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+#ifndef _ReCaged_MAPPED_FILE_H
+#define _ReCaged_MAPPED_FILE_H
+//read-only view of a whole file in memory, for loaders that parse big files
+//(mapped directly where possible, otherwise read into a buffer)
+#include <stddef.h>
+
+class Mapped_File
+{
+	public:
+		Mapped_File();
+		~Mapped_File();
+
+		bool Open(const char *file);
+		void Close();
+
+		//contents (not null terminated!) and size
+		const char *data;
+		size_t size;
+
+	private:
+		bool mapped; //or allocated
+};
+#endif
@@ -71,6 +71,40 @@ bool Model::Compare_Name(const char *n)
 	return false;
 }
 
+//FNV-1a
+static Uint32 Model_Hash(Uint32 hash, const void *data, size_t size)
+{
+	const Uint8 *p = (const Uint8*)data;
+	for (size_t i=0; i<size; ++i)
+		hash = (hash^p[i])*16777619u;
+	return hash;
+}
+
+//of everything loaded (not cooked), for comparing loaders
+Uint32 Model::Checksum()
+{
+	Uint32 hash = 2166136261u;
+
+	if (!vertices.empty())
+		hash = Model_Hash(hash, &vertices[0], sizeof(Vector_Float)*vertices.size());
+	if (!normals.empty())
+		hash = Model_Hash(hash, &normals[0], sizeof(Vector_Float)*normals.size());
+	if (!texcoords.empty())
+		hash = Model_Hash(hash, &texcoords[0], sizeof(Vector2_Float)*texcoords.size());
+
+	for (size_t i=0; i<materials.size(); ++i)
+	{
+		Material *m = &materials[i];
+		hash = Model_Hash(hash, m->name.c_str(), m->name.size()+1);
+		hash = Model_Hash(hash, m->diffusetex.c_str(), m->diffusetex.size()+1);
+		hash = Model_Hash(hash, &m->material, sizeof(Material_Float));
+		if (!m->triangles.empty())
+			hash = Model_Hash(hash, &m->triangles[0], sizeof(Triangle_Uint)*m->triangles.size());
+	}
+
+	return hash;
+}
+
 //makes sure all normals are unit
 void Model::Normalize_Normals()
 {
@@ -159,6 +193,7 @@ void Model::Generate_Missing_Normals()
 }
 
 //resize, rotate, change offset stuff (TODO: DELETE THIS!):
+//(only remembered here, applied after loading)
 void Model::Resize(float r)
 {
 	if (r == 1.0) //no need
@@ -170,6 +205,40 @@ void Model::Resize(float r)
 		return;
 	}
 
+	Tool tool = {'s', r, r, r};
+	tools.push_back(tool);
+}
+
+void Model::Rotate(float x, float y, float z)
+{
+	if (x==0 && y==0 && z==0)
+		return;
+
+	Tool tool = {'r', x, y, z};
+	tools.push_back(tool);
+}
+
+void Model::Offset(float x, float y, float z)
+{
+	if (x==0 && y==0 && z==0)
+		return;
+
+	Tool tool = {'o', x, y, z};
+	tools.push_back(tool);
+}
+
+void Model::Compact()
+{
+	for (size_t i=0; i<tools.size(); ++i)
+		if (tools[i].type == 'c') //already
+			return;
+
+	Tool tool = {'c', 0.0, 0.0, 0.0};
+	tools.push_back(tool);
+}
+
+void Model::Apply_Resize(float r)
+{
 	size_t end = vertices.size();
 	size_t i;
 
@@ -181,11 +250,8 @@ void Model::Resize(float r)
 	}
 }
 
-void Model::Rotate(float x, float y, float z)
+void Model::Apply_Rotate(float x, float y, float z)
 {
-	if (x==0 && y==0 && z==0)
-		return;
-
 	//rotation matrix:
 	dMatrix3 rot;
 	dRFromEulerAngles (rot, x*(M_PI/180), y*(M_PI/180), z*(M_PI/180));
@@ -218,11 +284,8 @@ void Model::Rotate(float x, float y, float z)
 	}
 }
 
-void Model::Offset(float x, float y, float z)
+void Model::Apply_Offset(float x, float y, float z)
 {
-	if (x==0 && y==0 && z==0)
-		return;
-
 	size_t end = vertices.size();
 	size_t i;
 
@@ -277,6 +340,11 @@ std::string Model::Relative_Path(const char *file)
 //
 
 //wrapper for loading
+Model::Model()
+{
+	cooked.header = NULL;
+}
+
 bool Model::Load(const char *file)
 {
 	Log_Add(2, "Loading model from file \"%s\" (identifying suffix)", file);
@@ -286,9 +354,12 @@ bool Model::Load(const char *file)
 	texcoords.clear();
 	normals.clear();
 	materials.clear();
-
-	//set name to filename
-	name=file;
+	path.clear();
+	sources.clear();
+	tools.clear();
+	cooked.header = NULL;
+	cooked_buffer.clear();
+	cache.Close();
 
 	if (file == NULL)
 	{
@@ -308,6 +379,13 @@ bool Model::Load(const char *file)
 	//set name to filename (without full path)
 	name=file;
 
+	//supported?
+	if (strcasecmp(suffix, ".obj") && strcasecmp(suffix, ".road"))
+	{
+		Log_Add(-1, "Unknown 3D file suffix for \"%s\"", file);
+		return false;
+	}
+
 	//find
 	Directories dirs;
 	if (!dirs.Find(file, DATA, READ))
@@ -316,16 +394,28 @@ bool Model::Load(const char *file)
 		return false;
 	}
 
+	//ok, load when needed
+	path=dirs.Path();
+	return true;
+}
+
+bool Model::Parse()
+{
+	const char *suffix = strrchr(path.c_str(), '.');
+
+	sources.clear();
+	sources.push_back(path);
+
 	//see if match:
 	if (!strcasecmp(suffix, ".obj"))
-		return Load_OBJ(dirs.Path());
+		return Load_OBJ(path.c_str());
 	else if (!strcasecmp(suffix, ".road"))
-		return Load_Road(dirs.Path());
+		return Load_Road(path.c_str());
 	//else if (!strcasecmp(suffix, ".3ds"))
-		//return Load_3DS(dirs.Path());
+		//return Load_3DS(path.c_str());
 	
 	//else, no match
-	Log_Add(-1, "Unknown 3D file suffix for \"%s\"", file);
+	Log_Add(-1, "Unknown 3D file suffix for \"%s\"", path.c_str());
 	return false;
 }
 
@@ -359,7 +449,10 @@ bool Model::Load_Material(const char *file)
 
 	//see if match:
 	if (!strcasecmp(suffix, ".mtl"))
+	{
+		sources.push_back(dirs.Path()); //(changes should be noticed by cache)
 		return Load_MTL(dirs.Path());
+	}
 
 	//else, no match
 	Log_Add(-1, "Unknown material file suffix for \"%s\"", file);
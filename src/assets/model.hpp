@@ -31,6 +31,7 @@
 
 #include "image.hpp"
 #include "assets.hpp"
+#include "mapped_file.hpp"
 
 //definitions:
 struct Vector_Float{
@@ -68,6 +69,7 @@ struct Material_Float
 
 //for rendering (node) generation
 #define DEFAULT_VBO_SIZE 4194304 //usual size for trimesh VBOs
+#define DEFAULT_IBO_SIZE 4194304 //and for their index buffers
 class Model_Draw: public Assets
 {
 	public:
@@ -97,18 +99,28 @@ class Model_Draw: public Assets
 			GLfloat nx,ny,nz;
 		};
 
+		//compact element (half the size): position and texcoord quantized
+		//inside bounds of model (converted back by modelview and texture
+		//matrices), and normal as signed bytes
+		struct Compact_Vertex
+		{
+			GLshort x,y,z,w; //(w unused, for alignment)
+			GLshort u,v;
+			GLbyte nx,ny,nz,nw; //(nw unused)
+		};
+
 		//material (all elements are grouped by materials for performance)
 		struct Material
 		{
-			GLuint start; //where in vbo this material is used
-			GLsizei size; //how much to render
+			GLuint start; //where in index buffer this material is used
+			GLsizei size; //how many indices to render
 			GLuint diffusetex;
 			//TODO: ambient, normal texture, emission texture, specular exponent/highlight texture...
 
 			Material_Float material;
 		};
 
-		Model_Draw(const char* n, float r, GLuint vbo, Material* m, unsigned int mc); //constructor
+		Model_Draw(const char* n, float r, GLuint vbo, GLuint ibo, Material* m, unsigned int mc); //constructor
 		~Model_Draw(); //destructor
 		friend class Model; //only Model is allowed to create this...
 		friend class VBO; //...and VBO tracking (needs vertex definition)
@@ -121,9 +133,16 @@ class Model_Draw: public Assets
 
 		//VBO and position in VBO of array:
 		GLuint vbo_id; //which vbo got this model
+		GLuint ibo_id; //and its index buffer (always the same for same vbo)
+
+		//using compact vertices: position offset+scale, and texture matrix
+		bool compact;
+		GLfloat compact_position[4];
+		GLfloat texture_matrix[16];
 
 		//only graphics list rendering can access this stuff
 		friend void Render_List_Render();
+		friend void Render_List_Build();
 };
 
 //for collision detection (geom) generation
@@ -176,8 +195,10 @@ class Model_Mesh: public Assets
 class Model
 {
 	public:
+		Model();
 
-		//wrapper that decides loading function by file suffix:
+		//find file and check it can be loaded (actual loading is delayed
+		//until needed, since might be possible to use cached data instead)
 		bool Load(const char*);
 
 		//TODO:
@@ -191,15 +212,28 @@ class Model
 		Model_Draw *Create_Draw(); //for rendering
 		Model_Mesh *Create_Mesh(); //for collision
 
+		//load and process now instead of when creating (used by loader
+		//threads), and queue textures for decoding
+		bool Prepare();
+
 		//TODO: remove tools (move to creation of actual assets!)
-		//tools:
+		//tools (applied in same order after loading):
 		void Resize(float);
 		void Rotate(float,float,float);
 		void Offset(float, float, float);
+		//use compact vertices for rendering (less accurate, but half the size)
+		void Compact();
 		//check if name matches specified
 		bool Compare_Name(const char*);
 
+		//benchmarks and checks of loading (--check)
+		static bool Check_Road();
+		static bool Check_OBJ();
+
 	private:
+		//wrapper that decides loading function by file suffix:
+		bool Parse();
+
 		//like Load, for material files (private)
 		bool Load_Material(const char*);
 
@@ -207,14 +241,45 @@ class Model
 		//just for the other trimesh classes (for asset name)
 		std::string name;
 
+		//file to load (full path), and files actually loaded (with materials)
+		std::string path;
+		std::vector<std::string> sources;
+
+		//tools waiting to be applied (after loading)
+		struct Tool
+		{
+			Uint32 type; //'s'=resize, 'r'=rotate, 'o'=offset, 'c'=compact
+			float x, y, z;
+		};
+		std::vector<Tool> tools;
+
+		void Apply_Resize(float);
+		void Apply_Rotate(float,float,float);
+		void Apply_Offset(float, float, float);
+
 		//tools:
 		void Normalize_Normals(); //make sure normals are unit (for some loaders, like obj, maybe not...)
 		void Generate_Missing_Normals(); //if loaded incomplete normals, solve
 		unsigned int Find_Material(const char *); //find first matching material by name
 		float Find_Longest_Distance(); //find vertex furthest from center, and return its length
 
+		//rendering optimizations (model_optimize.cpp):
+		//reorder triangles for vertex cache and overdraw (one material at a time)
+		static void Optimize_Triangles(Uint32 *indices, Uint32 count,
+				const Model_Draw::Vertex *vertices, Uint32 vertex_count);
+		//reorder vertices by first use (after triangles)
+		static void Optimize_Vertices(std::vector<Model_Draw::Vertex> &vertices,
+				std::vector<Uint32> &indices);
+		//average vertex cache misses per triangle
+		static float Cache_Miss_Ratio(const Uint32 *indices, Uint32 count, Uint32 vertex_count);
+		//convert to compact vertices (and get offsets+scales for converting back)
+		void Compact_Vertices(const std::vector<Model_Draw::Vertex> &vertices,
+				std::vector<Model_Draw::Compact_Vertex> &compact,
+				float position[4], float texcoord[4]);
+
 		//other tools:
 		std::string Relative_Path(const char *); //builds paths to files relative to opened model
+		Uint32 Checksum(); //of loaded data (for checks)
 
 		//functions for loading 3d files:
 		//obj files (obj.cpp)
@@ -257,6 +322,73 @@ class Model
 
 		//default material
 		static const Material Material_Default;
+
+		//
+		//"cooked" data: everything needed for creating Model_Draw and
+		//Model_Mesh, processed and in final format. Either mapped from
+		//cache file (if up to date) or built after loading (and cached)
+		//
+		//(in order:)
+		struct Cooked_Header
+		{
+			char magic[4]; //"RCMC"
+			Uint32 version;
+			Uint32 tool_count, source_count;
+			float radius;
+			Uint32 draw_vertices, draw_indices, draw_materials;
+			Uint32 draw_compact; //0=Vertex, 1=Compact_Vertex
+			float compact_position[4], compact_texcoord[4]; //offsets, scales
+			Uint32 mesh_vertices, mesh_triangles, mesh_materials;
+			Uint32 strings_size;
+		};
+		//(tools)
+		struct Cooked_Source
+		{
+			Uint32 name; //(offset in strings)
+			Uint32 size, hash; //of file
+		};
+		//(Model_Draw::Vertex or Compact_Vertex, and Uint32 indices)
+		struct Cooked_Draw_Material
+		{
+			Uint32 start, size; //indices
+			Material_Float material;
+			Uint32 diffusetex; //(offset in strings, or INDEX_ERROR)
+		};
+		//(Vector_Float vertices, Uint32 indices and Vector_Float normals)
+		struct Cooked_Mesh_Material
+		{
+			Uint32 end; //triangle
+			Uint32 name; //(offset in strings)
+		};
+		//(strings)
+
+		//points at each part
+		struct Cooked
+		{
+			const Cooked_Header *header;
+			const Tool *tools;
+			const Cooked_Source *sources;
+			const Model_Draw::Vertex *draw_vertices; //(one of these two)
+			const Model_Draw::Compact_Vertex *draw_compact_vertices;
+			const Uint32 *draw_indices;
+			const Cooked_Draw_Material *draw_materials;
+			const Vector_Float *mesh_vertices;
+			const Uint32 *mesh_indices;
+			const Vector_Float *mesh_normals;
+			const Cooked_Mesh_Material *mesh_materials;
+			const char *strings;
+		} cooked;
+
+		//data is stored in one of these
+		Mapped_File cache;
+		std::vector<Uint8> cooked_buffer;
+
+		//load or build cooked (if not already), false if not possible
+		bool Cook();
+		bool Cook_Map(const Uint8 *data, size_t size);
+		bool Cook_Build();
+		bool Cache_Read(const char *file);
+		bool Cache_Write(const char *file);
 };
 
 #endif
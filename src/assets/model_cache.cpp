@@ -0,0 +1,628 @@
+/*
+ * ReCaged - a Free Software, Futuristic, Racing Game
+ *
+ * Copyright (C) 2015 Mats Wahlberg
+ *
+ * This file is part of ReCaged.
+ *
+ * ReCaged is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ReCaged is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ReCaged.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+//"cooking" of models: processes loaded models into the final data needed for
+//rendering and collision detection, and keeps it in a cache file which can be
+//mapped directly next time (skipping both loading and processing)
+
+#include <stdio.h>
+#include <string.h>
+#include <SDL/SDL_thread.h>
+
+#include "model.hpp"
+#include "loader.hpp"
+#include "common/internal.hpp"
+#include "common/log.hpp"
+#include "common/clock.hpp"
+#include "common/directories.hpp"
+#include "common/threads.hpp"
+
+#define COOKED_VERSION 3
+
+//length of vector
+#define v_length(x, y, z) (sqrt( (x)*(x) + (y)*(y) + (z)*(z) ))
+
+//quick checksum (FNV-1a, but 4 bytes at a time)
+static Uint32 Cook_Hash(const char *data, size_t size, Uint32 hash=2166136261u)
+{
+	Uint32 word;
+	size_t i;
+
+	for (i=0; i+4<=size; i+=4)
+	{
+		memcpy(&word, data+i, 4);
+		hash = (hash^word)*16777619u;
+	}
+	for (; i<size; ++i)
+		hash = (hash^(Uint8)data[i])*16777619u;
+
+	return hash;
+}
+
+//size and checksum of file
+static bool Cook_Source(const char *file, Uint32 *size, Uint32 *hash)
+{
+	Mapped_File source;
+	if (!source.Open(file))
+		return false;
+
+	*size = source.size;
+	*hash = Cook_Hash(source.data, source.size);
+	return true;
+}
+
+//adds string to table, returns offset
+static Uint32 Cook_String(std::string &strings, const std::string &s)
+{
+	Uint32 offset = strings.size();
+	strings += s;
+	strings += '\0';
+	return offset;
+}
+
+bool Model::Cook()
+{
+	//already done
+	if (cooked.header)
+		return true;
+
+	if (path.empty())
+	{
+		Log_Add(-1, "trimesh has not been loaded");
+		return false;
+	}
+
+	Uint64 start = Clock_Get();
+
+	//cache file is named after model file and tools
+	Uint32 key = Cook_Hash(path.c_str(), path.size());
+	if (!tools.empty())
+		key = Cook_Hash((const char*)&tools[0], sizeof(Tool)*tools.size(), key);
+
+	char cache_file[32];
+	snprintf(cache_file, sizeof(cache_file), "meshes/%08x.rcm", key);
+
+	if (internal.mesh_cache && Cache_Read(cache_file))
+	{
+		Log_Add(2, "Loaded processed model \"%s\" from cache in %fms", name.c_str(),
+				(Clock_Get()-start)/1000000.0);
+		return true;
+	}
+
+	//no, load and process
+	if (!Parse())
+		return false;
+
+	for (size_t i=0; i<tools.size(); ++i)
+	{
+		switch (tools[i].type)
+		{
+			case 's':
+				Apply_Resize(tools[i].x);
+				break;
+			case 'r':
+				Apply_Rotate(tools[i].x, tools[i].y, tools[i].z);
+				break;
+			case 'o':
+				Apply_Offset(tools[i].x, tools[i].y, tools[i].z);
+				break;
+			//('c' is only used when building rendering vertices)
+		}
+	}
+
+	if (!Cook_Build())
+		return false;
+
+	Log_Add(2, "Loaded and processed model \"%s\" in %fms", name.c_str(),
+			(Clock_Get()-start)/1000000.0);
+
+	if (internal.mesh_cache)
+		Cache_Write(cache_file);
+
+	return true;
+}
+
+//cook now, and let loader start decoding textures
+bool Model::Prepare()
+{
+	if (!Cook())
+		return false;
+
+	//(no textures when headless)
+	if (headless)
+		return true;
+
+	for (Uint32 m=0; m<cooked.header->draw_materials; ++m)
+		if (cooked.draw_materials[m].diffusetex != INDEX_ERROR)
+			Loader_Add_Image(cooked.strings+cooked.draw_materials[m].diffusetex);
+
+	return true;
+}
+
+//place part of count elements after offset, if it fits in size (counts are
+//from file, so checked before multiplying: might overflow size_t otherwise)
+static bool Cook_Part(size_t *offset, size_t *part, size_t count, size_t element, size_t size)
+{
+	if (count > (size-*offset)/element)
+		return false;
+
+	*part = *offset;
+	*offset += count*element;
+	return true;
+}
+
+//set up pointers to each part of cooked data, and make sure it's all sane
+bool Model::Cook_Map(const Uint8 *data, size_t size)
+{
+	cooked.header = NULL;
+
+	const Cooked_Header *header = (const Cooked_Header*)data;
+	if (size < sizeof(Cooked_Header) || memcmp(header->magic, "RCMC", 4) || header->version != COOKED_VERSION)
+		return false;
+
+	if (header->draw_compact > 1)
+		return false;
+	size_t vertex_size = header->draw_compact? sizeof(Model_Draw::Compact_Vertex): sizeof(Model_Draw::Vertex);
+
+	//offsets (each part must fit in what's left of data)
+	size_t offset = sizeof(Cooked_Header);
+	size_t tools_o, sources_o, draw_vertices_o, draw_indices_o, draw_materials_o;
+	size_t mesh_vertices_o, mesh_indices_o, mesh_normals_o, mesh_materials_o, strings_o;
+	if (	!Cook_Part(&offset, &tools_o, header->tool_count, sizeof(Tool), size) ||
+		!Cook_Part(&offset, &sources_o, header->source_count, sizeof(Cooked_Source), size) ||
+		!Cook_Part(&offset, &draw_vertices_o, header->draw_vertices, vertex_size, size) ||
+		!Cook_Part(&offset, &draw_indices_o, header->draw_indices, sizeof(Uint32), size) ||
+		!Cook_Part(&offset, &draw_materials_o, header->draw_materials, sizeof(Cooked_Draw_Material), size) ||
+		!Cook_Part(&offset, &mesh_vertices_o, header->mesh_vertices, sizeof(Vector_Float), size) ||
+		!Cook_Part(&offset, &mesh_indices_o, header->mesh_triangles, 3*sizeof(Uint32), size) ||
+		!Cook_Part(&offset, &mesh_normals_o, header->mesh_triangles, sizeof(Vector_Float), size) ||
+		!Cook_Part(&offset, &mesh_materials_o, header->mesh_materials, sizeof(Cooked_Mesh_Material), size) ||
+		!Cook_Part(&offset, &strings_o, header->strings_size, 1, size) ||
+		offset != size)
+		return false;
+
+	Cooked c;
+	c.header = header;
+	c.tools = (const Tool*)(data+tools_o);
+	c.sources = (const Cooked_Source*)(data+sources_o);
+	c.draw_vertices = NULL;
+	c.draw_compact_vertices = NULL;
+	if (header->draw_compact)
+		c.draw_compact_vertices = (const Model_Draw::Compact_Vertex*)(data+draw_vertices_o);
+	else
+		c.draw_vertices = (const Model_Draw::Vertex*)(data+draw_vertices_o);
+	c.draw_indices = (const Uint32*)(data+draw_indices_o);
+	c.draw_materials = (const Cooked_Draw_Material*)(data+draw_materials_o);
+	c.mesh_vertices = (const Vector_Float*)(data+mesh_vertices_o);
+	c.mesh_indices = (const Uint32*)(data+mesh_indices_o);
+	c.mesh_normals = (const Vector_Float*)(data+mesh_normals_o);
+	c.mesh_materials = (const Cooked_Mesh_Material*)(data+mesh_materials_o);
+	c.strings = (const char*)(data+strings_o);
+
+	//strings must be terminated, and all references inside data
+	Uint32 strings_size = header->strings_size;
+	if (strings_size && c.strings[strings_size-1] != '\0')
+		return false;
+
+	Uint32 i;
+	for (i=0; i<header->source_count; ++i)
+		if (c.sources[i].name >= strings_size)
+			return false;
+
+	for (i=0; i<header->draw_materials; ++i)
+		if (	(c.draw_materials[i].diffusetex != INDEX_ERROR && c.draw_materials[i].diffusetex >= strings_size) ||
+			c.draw_materials[i].start > header->draw_indices ||
+			c.draw_materials[i].size > header->draw_indices-c.draw_materials[i].start	)
+			return false;
+
+	for (i=0; i<header->draw_indices; ++i)
+		if (c.draw_indices[i] >= header->draw_vertices)
+			return false;
+
+	for (i=0; i<header->mesh_materials; ++i)
+		if (c.mesh_materials[i].name >= strings_size || c.mesh_materials[i].end > header->mesh_triangles)
+			return false;
+
+	//(as size_t: times 3 might not fit in 32 bits)
+	size_t mesh_indices = (size_t)header->mesh_triangles*3;
+	for (size_t j=0; j<mesh_indices; ++j)
+		if (c.mesh_indices[j] >= header->mesh_vertices)
+			return false;
+
+	cooked = c;
+	return true;
+}
+
+//build cooked data from loaded model
+bool Model::Cook_Build()
+{
+	//count triangles and (used) materials
+	Uint32 tris=0, mats=0, tmp;
+	size_t material_count=materials.size();
+	for (size_t mat=0; mat<material_count; ++mat)
+		if ((tmp = materials[mat].triangles.size()))
+		{
+			tris += tmp;
+			++mats;
+		}
+
+	//all strings (names)
+	std::string strings;
+	std::vector<Cooked_Source> source_list(sources.size());
+	for (size_t s=0; s<sources.size(); ++s)
+	{
+		source_list[s].name = Cook_String(strings, sources[s]);
+		if (!Cook_Source(sources[s].c_str(), &source_list[s].size, &source_list[s].hash))
+			return false;
+	}
+
+	//header
+	Cooked_Header header;
+	memcpy(header.magic, "RCMC", 4);
+	header.version = COOKED_VERSION;
+	header.tool_count = tools.size();
+	header.source_count = sources.size();
+	header.radius = Find_Longest_Distance();
+	header.draw_vertices = 0; //(set below)
+	header.draw_indices = 3*tris; //each triangle requires 3 indices
+	header.draw_materials = mats;
+	header.draw_compact = 0; //(set below)
+	header.mesh_vertices = vertices.size();
+	header.mesh_triangles = tris;
+	header.mesh_materials = mats;
+	header.strings_size = 0; //(set below)
+
+	//material names and textures
+	std::vector<Cooked_Draw_Material> draw_materials(mats);
+	std::vector<Cooked_Mesh_Material> mesh_materials(mats);
+	Uint32 m, t, mcount=0, tcount=0;
+	for (m=0; m<material_count; ++m)
+		if ((tmp = materials[m].triangles.size()))
+		{
+			draw_materials[mcount].start = 3*tcount;
+			draw_materials[mcount].size = 3*tmp;
+			draw_materials[mcount].material = materials[m].material;
+			if (materials[m].diffusetex.empty())
+				draw_materials[mcount].diffusetex = INDEX_ERROR;
+			else
+				draw_materials[mcount].diffusetex = Cook_String(strings, materials[m].diffusetex);
+
+			tcount += tmp;
+			mesh_materials[mcount].end = tcount;
+			mesh_materials[mcount].name = Cook_String(strings, materials[m].name);
+
+			++mcount;
+		}
+
+	//keep size multiple of 4
+	while (strings.size()%4)
+		strings += '\0';
+	header.strings_size = strings.size();
+
+	//
+	//rendering: list of all vertices sorted by material to minimize calls
+	//(interleaves the vertices+texcoords+normals, and only keeps one copy of
+	//identical vertices, found by hash table of vertex indices)
+	//
+	std::vector<Model_Draw::Vertex> vertex_list;
+	std::vector<Uint32> index_list(3*tris);
+	vertex_list.reserve(3*tris);
+
+	Uint32 hash_size = 1;
+	while (hash_size < 6*tris)
+		hash_size *= 2;
+	std::vector<Uint32> hash_table(hash_size, INDEX_ERROR);
+
+	Model_Draw::Vertex vertex;
+	unsigned int *vertexi, *texcoordi, *normali;
+	Uint32 icount=0, c, h;
+	for (m=0; m<material_count; ++m)
+	{
+		tmp = materials[m].triangles.size();
+		for (t=0; t<tmp; ++t)
+		{
+			//store indices:
+			vertexi = materials[m].triangles[t].vertex;
+			texcoordi = materials[m].triangles[t].texcoord;
+			normali = materials[m].triangles[t].normal;
+
+			for (c=0; c<3; ++c)
+			{
+				//vertex
+				vertex.x = vertices[vertexi[c]].x;
+				vertex.y = vertices[vertexi[c]].y;
+				vertex.z = vertices[vertexi[c]].z;
+
+				//texcoord
+				vertex.u = texcoords[texcoordi[c]].x;
+				vertex.v = texcoords[texcoordi[c]].y;
+
+				//normal
+				vertex.nx = normals[normali[c]].x;
+				vertex.ny = normals[normali[c]].y;
+				vertex.nz = normals[normali[c]].z;
+
+				//find identical, or add
+				h = Cook_Hash((const char*)&vertex, sizeof(vertex))&(hash_size-1);
+				while (	hash_table[h] != INDEX_ERROR &&
+					memcmp(&vertex_list[hash_table[h]], &vertex, sizeof(vertex)) )
+					h = (h+1)&(hash_size-1);
+
+				if (hash_table[h] == INDEX_ERROR)
+				{
+					hash_table[h] = vertex_list.size();
+					vertex_list.push_back(vertex);
+				}
+
+				index_list[icount++] = hash_table[h];
+			}
+		}
+	}
+
+	Uint32 vcount = vertex_list.size();
+	float acmr_before = Cache_Miss_Ratio(index_list.empty()? NULL: &index_list[0], icount, vcount);
+
+	//order triangles of each material for vertex cache, then vertices
+	for (m=0; m<mats; ++m)
+		Optimize_Triangles(&index_list[draw_materials[m].start], draw_materials[m].size,
+				vertex_list.empty()? NULL: &vertex_list[0], vcount);
+	Optimize_Vertices(vertex_list, index_list);
+
+	float acmr_after = Cache_Miss_Ratio(index_list.empty()? NULL: &index_list[0], icount, vcount);
+	header.draw_vertices = vcount;
+
+	//compact vertices if requested
+	std::vector<Model_Draw::Compact_Vertex> compact_list;
+	for (size_t tool=0; tool<tools.size(); ++tool)
+		if (tools[tool].type == 'c')
+			header.draw_compact = 1;
+
+	if (header.draw_compact)
+		Compact_Vertices(vertex_list, compact_list, header.compact_position, header.compact_texcoord);
+	else
+	{
+		memset(header.compact_position, 0, sizeof(header.compact_position));
+		memset(header.compact_texcoord, 0, sizeof(header.compact_texcoord));
+	}
+
+	size_t vertex_size = header.draw_compact? sizeof(Model_Draw::Compact_Vertex): sizeof(Model_Draw::Vertex);
+
+	Log_Add(2, "Rendering model \"%s\": %u vertices welded to %u (%u instead of %u bytes), "
+			"vertex cache misses per triangle: 3.000 unindexed, %.3f indexed, %.3f optimized",
+			name.c_str(), 3*tris, vcount,
+			vcount*(Uint32)vertex_size+icount*(Uint32)sizeof(Uint32),
+			3*tris*(Uint32)sizeof(Model_Draw::Vertex),
+			acmr_before, acmr_after);
+
+	//allocate
+	size_t size =	sizeof(Cooked_Header)+
+			tools.size()*sizeof(Tool)+
+			sources.size()*sizeof(Cooked_Source)+
+			header.draw_vertices*vertex_size+
+			header.draw_indices*sizeof(Uint32)+
+			mats*sizeof(Cooked_Draw_Material)+
+			header.mesh_vertices*sizeof(Vector_Float)+
+			tris*3*sizeof(Uint32)+
+			tris*sizeof(Vector_Float)+
+			mats*sizeof(Cooked_Mesh_Material)+
+			header.strings_size;
+
+	cooked_buffer.resize(size);
+	Uint8 *p = &cooked_buffer[0];
+
+	//copy all but vertices/indices/normals
+	memcpy(p, &header, sizeof(Cooked_Header)); p+=sizeof(Cooked_Header);
+	if (!tools.empty())
+		memcpy(p, &tools[0], tools.size()*sizeof(Tool));
+	p+=tools.size()*sizeof(Tool);
+	if (!source_list.empty())
+		memcpy(p, &source_list[0], sources.size()*sizeof(Cooked_Source));
+	p+=sources.size()*sizeof(Cooked_Source);
+
+	if (vcount)
+	{
+		if (header.draw_compact)
+			memcpy(p, &compact_list[0], vcount*vertex_size);
+		else
+			memcpy(p, &vertex_list[0], vcount*vertex_size);
+	}
+	p+=vcount*vertex_size;
+
+	if (icount)
+		memcpy(p, &index_list[0], icount*sizeof(Uint32));
+	p+=icount*sizeof(Uint32);
+
+	if (mats)
+		memcpy(p, &draw_materials[0], mats*sizeof(Cooked_Draw_Material));
+	p+=mats*sizeof(Cooked_Draw_Material);
+
+	if (!vertices.empty())
+		memcpy(p, &vertices[0], vertices.size()*sizeof(Vector_Float));
+	p+=vertices.size()*sizeof(Vector_Float);
+
+	Uint32 *i = (Uint32*)p;
+	p+=tris*3*sizeof(Uint32);
+	Vector_Float *n = (Vector_Float*)p;
+	p+=tris*sizeof(Vector_Float);
+
+	if (mats)
+		memcpy(p, &mesh_materials[0], mats*sizeof(Cooked_Mesh_Material));
+	p+=mats*sizeof(Cooked_Mesh_Material);
+
+	memcpy(p, strings.data(), strings.size());
+
+	//
+	//collision: triangles (using indexed vertices and an array of normals)
+	//
+	unsigned int *vp; //vertex index pointer
+	float ax,ay,az,bx,by,bz,x,y,z,l;
+	tcount=0;
+	for (m=0; m<material_count; ++m)
+	{
+		tmp = materials[m].triangles.size();
+		for (t=0; t<tmp; ++t)
+		{
+			vp = materials[m].triangles[t].vertex;
+
+			//indices
+			i[3*tcount] = vp[0];
+			i[3*tcount+1] = vp[1];
+			i[3*tcount+2] = vp[2];
+
+			//normals
+			//NOTE: ode uses one, not indexed, normal per triangle,
+			//use cross product to calculate one proper normal:
+			//(the same as in Generate_Missing_Normals)
+
+			//get vertices
+			Vector_Float v1 = vertices[vp[0]];
+			Vector_Float v2 = vertices[vp[1]];
+			Vector_Float v3 = vertices[vp[2]];
+
+			//create two vectors (a and b)
+			ax = (v2.x-v1.x);
+			ay = (v2.y-v1.y);
+			az = (v2.z-v1.z);
+
+			bx = (v3.x-v1.x);
+			by = (v3.y-v1.y);
+			bz = (v3.z-v1.z);
+
+			//cross product gives normal:
+			x = (ay*bz)-(az*by);
+			y = (az*bx)-(ax*bz);
+			z = (ax*by)-(ay*bx);
+			
+			//set and make unit:
+			l = v_length(x, y, z);
+
+			n[tcount].x = x/l;
+			n[tcount].y = y/l;
+			n[tcount].z = z/l;
+
+			//increase triangle count
+			++tcount;
+		}
+	}
+
+	if (!Cook_Map(&cooked_buffer[0], size))
+	{
+		Log_Add(-1, "Could not process model \"%s\" (bad indices?)", name.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+//use cache file if exists and is up to date
+bool Model::Cache_Read(const char *file)
+{
+	Directories dirs;
+	if (!dirs.Find(file, CACHE, READ) || !cache.Open(dirs.Path()))
+		return false;
+
+	const char *reason = NULL;
+	const Cooked_Header *header;
+
+	if (!Cook_Map((const Uint8*)cache.data, cache.size))
+		reason = "broken or old version";
+	else if ((header=cooked.header)->tool_count != tools.size() ||
+			(!tools.empty() && memcmp(cooked.tools, &tools[0], sizeof(Tool)*tools.size())))
+		reason = "different tools";
+	else if (!header->source_count || path != cooked.strings+cooked.sources[0].name)
+		reason = "different model";
+	else
+	{
+		//all files must be unchanged
+		Uint32 size, hash;
+		for (Uint32 i=0; i<header->source_count; ++i)
+		{
+			const char *source = cooked.strings+cooked.sources[i].name;
+			if (	!Cook_Source(source, &size, &hash) ||
+				size != cooked.sources[i].size || hash != cooked.sources[i].hash)
+			{
+				reason = "files changed";
+				break;
+			}
+		}
+	}
+
+	if (reason)
+	{
+		Log_Add(2, "Not using cached model \"%s\": %s", dirs.Path(), reason);
+		cooked.header = NULL;
+		cache.Close();
+		return false;
+	}
+
+	return true;
+}
+
+bool Model::Cache_Write(const char *file)
+{
+	Directories dirs;
+	if (!dirs.Find(file, CACHE, WRITE))
+	{
+		Log_Add(0, "WARNING: could not store model \"%s\" in cache", name.c_str());
+		return false;
+	}
+
+	Log_Add(2, "Storing processed model \"%s\" in cache file \"%s\"", name.c_str(), dirs.Path());
+
+	//written to temporary file first, and then renamed: other loader threads
+	//(or instances of the game) might be reading or writing the same file
+	char tmp[sizeof(".tmp")+10];
+	snprintf(tmp, sizeof(tmp), ".tmp%u", (unsigned int)SDL_ThreadID());
+	std::string tmp_path = dirs.Path();
+	tmp_path += tmp;
+
+	FILE *fp = fopen(tmp_path.c_str(), "wb");
+	if (!fp)
+	{
+		Log_Add(0, "WARNING: could not write model cache file \"%s\"", tmp_path.c_str());
+		return false;
+	}
+
+	bool ok = (fwrite(&cooked_buffer[0], cooked_buffer.size(), 1, fp) == 1);
+	if (fclose(fp))
+		ok = false;
+
+	if (!ok)
+	{
+		Log_Add(0, "WARNING: could not write model cache file \"%s\"", tmp_path.c_str());
+		remove(tmp_path.c_str());
+		return false;
+	}
+
+#ifdef _WIN32
+	//(rename does not replace existing files here)
+	remove(dirs.Path());
+#endif
+
+	if (rename(tmp_path.c_str(), dirs.Path()))
+	{
+		Log_Add(0, "WARNING: could not rename \"%s\" to \"%s\"", tmp_path.c_str(), dirs.Path());
+		remove(tmp_path.c_str());
+		return false;
+	}
+
+	return true;
+}
@@ -26,54 +26,64 @@
 #include <GL/glew.h>
 #include "image.hpp"
 #include "model.hpp"
+#include "loader.hpp"
 #include "conf.hpp"
 #include "common/internal.hpp"
 #include "common/log.hpp"
 #include "common/directories.hpp"
+#include "common/threads.hpp"
 
 //length of vector
 #define v_length(x, y, z) (sqrt( (x)*(x) + (y)*(y) + (z)*(z) ))
 
-//keep track of VBOs (new generated if not enough room in already existing)
+//keep track of VBOs (new generated if not enough room in already existing),
+//each vbo got its own index buffer (so binding one means binding both), and
+//only one kind of vertices (normal or compact)
 class VBO: public Assets
 {
 	public:
 		//find a vbo with enough room, if not create a new one
-		static VBO *Find_Enough_Room(unsigned int needed)
+		static VBO *Find_Enough_Room(unsigned int needed, unsigned int index_needed, bool compact)
 		{
-			Log_Add(2, "Locating vbo to hold %u bytes of data", needed);
+			Log_Add(2, "Locating vbo to hold %u bytes of data and %u bytes of indices", needed, index_needed);
 
 			//in case creating
 			GLsizei size=DEFAULT_VBO_SIZE;
+			GLsizei index_size=DEFAULT_IBO_SIZE;
 			bool dedicated=false;
 
 			//check so enough space in even a new vbo:
-			if (needed > DEFAULT_VBO_SIZE)
+			if (needed > DEFAULT_VBO_SIZE || index_needed > DEFAULT_IBO_SIZE)
 			{
-				Log_Add(2, "creating new vbo for single model, %u bytes of size", needed);
+				Log_Add(2, "creating new vbo for single model, %u+%u bytes of size", needed, index_needed);
 				dedicated=true;
 				size=needed;
+				index_size=index_needed;
 			}
 			else
 			{
 				//see if already exists
 				for (VBO *p=head; p; p=p->next)
-					if ( !p->dedicated && (p->usage)+needed <= (unsigned int) DEFAULT_VBO_SIZE ) //not dedicated+enough to hold
+					if (	!p->dedicated && p->compact == compact && //not dedicated+same kind+enough to hold
+						(p->usage)+needed <= (unsigned int) DEFAULT_VBO_SIZE &&
+						(p->index_usage)+index_needed <= (unsigned int) DEFAULT_IBO_SIZE )
 					{
 						Log_Add(2, "reusing already existing vbo for model");
 						return p;
 					}
 
 				//else, did not find enough room, create
-				Log_Add(2, "creating new vbo for multiple models, %u bytes of size", DEFAULT_VBO_SIZE);
+				Log_Add(2, "creating new vbo for multiple models, %u+%u bytes of size", DEFAULT_VBO_SIZE, DEFAULT_IBO_SIZE);
 			}
 
 
-			//create and bind vbo:
-			GLuint target;
-			glGenBuffers(1, &target); //create buffer
-			glBindBuffer(GL_ARRAY_BUFFER, target); //bind
+			//create and bind vbo and index buffer:
+			GLuint target[2];
+			glGenBuffers(2, target); //create buffers
+			glBindBuffer(GL_ARRAY_BUFFER, target[0]); //bind
 			glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STATIC_DRAW); //fill/allocate
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, target[1]);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_size, NULL, GL_STATIC_DRAW);
 
 			//check if allocated ok:
 			if (GLenum error = glGetError()) //if got error...
@@ -85,33 +95,38 @@ class VBO: public Assets
 					Log_Add(-1, "Unexpected opengl error!!! Fix this!");
 
 				//anyway, we return NULL to indicate failure
+				glDeleteBuffers(2, target);
 				return NULL;
 			}
 
 			//ok, so create a class to track it (until not needed anymore)
-			return new VBO(target, dedicated);
+			return new VBO(target[0], target[1], dedicated, compact);
 		}
 
-		GLuint id; //position of buffer (for mapping)
-		GLsizei usage; //how much of buffer is used (possibly GLint instead?)
-		bool dedicated;
+		GLuint id, index_id; //position of buffers (for mapping)
+		GLsizei usage, index_usage; //how much of buffers is used (possibly GLint instead?)
+		bool dedicated, compact;
 
 	private:
 		//normally, Assets is only for tracking loaded data, one class for each loaded...
 		//but this is slightly different: one vbo class can store several model sets
 		//(making it a Assets makes sure all VBOs gets deleted at the same time as models)
-		VBO(GLuint target, bool dedicated): Assets("VBO tracking class") //name all vbo classes this...
+		VBO(GLuint target, GLuint index_target, bool dedicated, bool compact): Assets("VBO tracking class") //name all vbo classes this...
 		{
 			//place on top of list
 			next=head;
 			head=this;
 			id=target;
+			index_id=index_target;
 			usage=0; //no data yet
+			index_usage=0;
 			this->dedicated=dedicated;
+			this->compact=compact;
 		}
 		~VBO()
 		{
 			glDeleteBuffers(1, &id);
+			glDeleteBuffers(1, &index_id);
 			//VBOs only removed on end of race (are racetime_data), all of them, so can safely just destroy old list
 			head = NULL;
 		}
@@ -127,8 +142,9 @@ VBO *VBO::head=NULL;
 //
 
 //constructor
-Model_Draw::Model_Draw(const char *name, float r, GLuint vbo, Material *mpointer, unsigned int mcount):
-	Assets(name), materials(mpointer), material_count(mcount), radius(r), vbo_id(vbo)
+Model_Draw::Model_Draw(const char *name, float r, GLuint vbo, GLuint ibo, Material *mpointer, unsigned int mcount):
+	Assets(name), materials(mpointer), material_count(mcount), radius(r), vbo_id(vbo), ibo_id(ibo),
+	compact(false)
 {
 }
 
@@ -243,32 +259,33 @@ Model_Draw *Model::Create_Draw()
 	else
 		Log_Add(2, "Creating rendering trimesh");
 
-	//check how many vertices (if any)
-	unsigned int vcount=0; //how many vertices
-	unsigned int mcount=0; //how many materials
-	size_t material_count=materials.size();
-	size_t tmp;
-	for (unsigned int mat=0; mat<material_count; ++mat)
-	{
-		//vertices (3 per triangle)
-		tmp = 3*materials[mat].triangles.size();
-		vcount+=tmp;
+	//load and process (or get from cache)
+	if (!Cook())
+		return NULL;
 
-		//but if this material got 0 triangles, don't use it
-		if (tmp)
-			++mcount;
-	}
+	//check how many vertices (if any)
+	unsigned int vcount=cooked.header->draw_vertices; //how many vertices
+	unsigned int icount=cooked.header->draw_indices; //how many indices
+	unsigned int mcount=cooked.header->draw_materials; //how many (used) materials
+	bool compact=cooked.header->draw_compact;
 
-	if (!vcount)
+	if (!icount)
 	{
 		Log_Add(-1, "trimesh is empty (at least no triangles)");
 		return NULL;
 	}
 	//mcount is always secured
 
-	//each triangle requires 3 vertices - vertex defined as "Vertex" in "Model_Draw"
-	unsigned int needed_vbo_size = sizeof(Model_Draw::Vertex)*(vcount);
-	VBO *vbo = VBO::Find_Enough_Room(needed_vbo_size);
+	//no opengl context when headless, so nothing to upload. Just create an
+	//empty model (will never be rendered anyway)
+	if (headless)
+		return new Model_Draw(name.c_str(), cooked.header->radius, 0, 0, NULL, 0);
+
+	//vertex defined as "Vertex" (or "Compact_Vertex") in "Model_Draw", each triangle requires 3 indices
+	unsigned int vertex_size = compact? sizeof(Model_Draw::Compact_Vertex): sizeof(Model_Draw::Vertex);
+	unsigned int needed_vbo_size = vertex_size*(vcount);
+	unsigned int needed_ibo_size = sizeof(GLuint)*(icount);
+	VBO *vbo = VBO::Find_Enough_Room(needed_vbo_size, needed_ibo_size, compact);
 
 	if (!vbo)
 		return NULL;
@@ -277,145 +294,61 @@ Model_Draw *Model::Create_Draw()
 	//ok, ready to go!
 	//
 	
-	Log_Add(2, "number of vertices: %u", vcount);
-
-	//quickly find furthest vertex of obj, so can determine radius
-	float radius = Find_Longest_Distance();
-	
-	//build a tmp list of all vertices sorted by material to minimize calls to be copied
-	//to vbo (graphics memory), and list of materials (with no duplicates or unused)
-
-	//first: how big should vertex list be?
-	Model_Draw::Vertex *vertex_list = new Model_Draw::Vertex[vcount];
+	Log_Add(2, "number of vertices: %u (%u indices)", vcount, icount);
 
-	//make material list as big as the number of materials
+	//vertices are already interleaved and indexed by material, only list of
+	//materials needs to be created (and textures loaded)
 	Model_Draw::Material *material_list = new Model_Draw::Material[mcount];
 
+	const Cooked_Draw_Material *material;
+	for (unsigned int m=0; m<mcount; ++m)
+	{
+		material = &cooked.draw_materials[m];
 
-	//some values needed:
-	unsigned int m,t; //looping of Material and Triangle
-	size_t m_size=materials.size();
-	size_t t_size;
-	mcount=0; //reset to 0 (will need to count again)
-	vcount=0; //the same here
-	unsigned int vcount_old=0; //keep track of last block of vertices
+		//
+		//copy material data:
+		//
+		material_list[m].material = material->material;
 
-	//points at current indices:
-	unsigned int *vertexi, *texcoordi, *normali;
+		//
+		//textures (disabled by default):
+		//
+		material_list[m].diffusetex = 0;
 
-	//loop through all materials, and for each used, loop through all triangles
-	//(removes indedexing -make copies- and interleaves the vertices+normals)
-	for (m=0; m<m_size; ++m)
-	{
-		//if this material is used for some triangle:
-		if ((t_size = materials[m].triangles.size()))
+		//got (diffuse) texture, try to use
+		if (material->diffusetex != INDEX_ERROR)
 		{
-			//
-			//copy vertices data:
-			//
-			for (t=0; t<t_size; ++t)
-			{
-				//store indices:
-				vertexi = materials[m].triangles[t].vertex;
-				texcoordi = materials[m].triangles[t].texcoord;
-				normali = materials[m].triangles[t].normal;
-
-				//vertex
-				vertex_list[vcount].x = vertices[vertexi[0]].x;
-				vertex_list[vcount].y = vertices[vertexi[0]].y;
-				vertex_list[vcount].z = vertices[vertexi[0]].z;
-
-				//texcoord
-				vertex_list[vcount].u = texcoords[texcoordi[0]].x;
-				vertex_list[vcount].v = texcoords[texcoordi[0]].y;
-
-				//normal
-				vertex_list[vcount].nx = normals[normali[0]].x;
-				vertex_list[vcount].ny = normals[normali[0]].y;
-				vertex_list[vcount].nz = normals[normali[0]].z;
-
-				//jump to next
-				++vcount;
-
-				//vertex
-				vertex_list[vcount].x = vertices[vertexi[1]].x;
-				vertex_list[vcount].y = vertices[vertexi[1]].y;
-				vertex_list[vcount].z = vertices[vertexi[1]].z;
-
-				//texcoord
-				vertex_list[vcount].u = texcoords[texcoordi[1]].x;
-				vertex_list[vcount].v = texcoords[texcoordi[1]].y;
-
-				//normal
-				vertex_list[vcount].nx = normals[normali[1]].x;
-				vertex_list[vcount].ny = normals[normali[1]].y;
-				vertex_list[vcount].nz = normals[normali[1]].z;
-
-				//jump to next
-				++vcount;
-
-				//vertex
-				vertex_list[vcount].x = vertices[vertexi[2]].x;
-				vertex_list[vcount].y = vertices[vertexi[2]].y;
-				vertex_list[vcount].z = vertices[vertexi[2]].z;
-
-				//texcoord
-				vertex_list[vcount].u = texcoords[texcoordi[2]].x;
-				vertex_list[vcount].v = texcoords[texcoordi[2]].y;
-
-				//normal
-				vertex_list[vcount].nx = normals[normali[2]].x;
-				vertex_list[vcount].ny = normals[normali[2]].y;
-				vertex_list[vcount].nz = normals[normali[2]].z;
-
-				//jump to next
-				++vcount;
-			}
-			//
-			//copy material data:
-			//
-			material_list[mcount].material = materials[m].material;
-
-			//
-			//textures (disabled by default):
-			//
-			material_list[mcount].diffusetex = 0;
-
-			//got (diffuse) texture, try to use
-			if (!materials[m].diffusetex.empty())
+			const char *diffusetex = cooked.strings+material->diffusetex;
+
+			//check if already exists
+			if (Image_Texture *tmp=Assets::Find<Image_Texture>(diffusetex))
+				material_list[m].diffusetex=tmp->GetID();
+			else
 			{
-				//check if already exists
-				if (Image_Texture *tmp=Assets::Find<Image_Texture>(materials[m].diffusetex.c_str()))
-					material_list[mcount].diffusetex=tmp->GetID();
+				//no, use image already decoded by loader, or load now
+				Image *image = Loader_Find_Image(diffusetex);
+				Image loaded;
 
-				//no, load
-				Image image;
+				if (!image && loaded.Load(diffusetex))
+					image = &loaded;
 
 				//if we could load, try to create texture
-				if (image.Load(materials[m].diffusetex.c_str()))
+				if (image)
 				{
-					Image_Texture *texture = image.Create_Texture();
+					Image_Texture *texture = image->Create_Texture();
 
 					if (texture)
-						material_list[mcount].diffusetex=texture->GetID();
+						material_list[m].diffusetex=texture->GetID();
 				}
 			}
-
-			//set up rendering tracking:
-			material_list[mcount].start=vcount_old;
-			material_list[mcount].size=(vcount-vcount_old);
-
-			//actually, the start should be offsetted by the current usage of vbo
-			//(since this new data will be placed after the last model)
-			//NOTE: instead of counting in bytes, this is counting in "vertices"
-			material_list[mcount].start += (vbo->usage)/sizeof(Model_Draw::Vertex);
-
-			//next time, this count will be needed
-			vcount_old=vcount;
-
-			//increase material counter
-			++mcount;
 		}
+
+		//set up rendering tracking:
+		//actually, the start should be offsetted by the current usage of index buffer
+		//(since this new data will be placed after the last model)
+		//NOTE: instead of counting in bytes, this is counting in "indices"
+		material_list[m].start=material->start + (vbo->index_usage)/sizeof(GLuint);
+		material_list[m].size=material->size;
 	}
 
 	Log_Add(2, "number of (used) materials: %u", mcount);
@@ -423,22 +356,46 @@ Model_Draw *Model::Create_Draw()
 	//create Model_Draw class from this data:
 	//set the name. NOTE: both Model_Draw and Model_Mesh will have the same name
 	//this is not a problem since they are different classes and Assets::Find will notice that
-	Model_Draw *mesh = new Model_Draw(name.c_str(), radius, vbo->id, material_list, mcount);
+	Model_Draw *mesh = new Model_Draw(name.c_str(), cooked.header->radius, vbo->id, vbo->index_id, material_list, mcount);
+
+	//compact: how to convert back to position and texcoord
+	if (compact)
+	{
+		mesh->compact = true;
+		memcpy(mesh->compact_position, cooked.header->compact_position, sizeof(GLfloat)*4);
+
+		const float *t = cooked.header->compact_texcoord;
+		GLfloat matrix[16] = {	t[2],0,0,0,
+					0,t[3],0,0,
+					0,0,1,0,
+					t[0],t[1],0,1};
+		memcpy(mesh->texture_matrix, matrix, sizeof(matrix));
+	}
 
 	//assume this vbo is not bound
 	glBindBuffer(GL_ARRAY_BUFFER, vbo->id);
 
-	//transfer data to vbo...
-	glBufferSubData(GL_ARRAY_BUFFER, vbo->usage, needed_vbo_size, vertex_list);
+	//transfer data to vbo (directly from cooked data)...
+	if (compact)
+		glBufferSubData(GL_ARRAY_BUFFER, vbo->usage, needed_vbo_size, cooked.draw_compact_vertices);
+	else
+		glBufferSubData(GL_ARRAY_BUFFER, vbo->usage, needed_vbo_size, cooked.draw_vertices);
 
-	//increase vbo usage counter
-	vbo->usage+=needed_vbo_size;
+	//...and indices, offsetted by vertices of the models before it
+	GLuint offset = (vbo->usage)/vertex_size;
+	std::vector<GLuint> indices(cooked.draw_indices, cooked.draw_indices+icount);
+	if (offset)
+		for (unsigned int i=0; i<icount; ++i)
+			indices[i]+=offset;
 
-	//free tmp memory
-	delete[] vertex_list;
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo->index_id);
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, vbo->index_usage, needed_ibo_size, &indices[0]);
+
+	//increase vbo usage counters
+	vbo->usage+=needed_vbo_size;
+	vbo->index_usage+=needed_ibo_size;
 
 	//ok, done
 	return mesh;
 }
 
-
@@ -26,9 +26,6 @@
 #include "common/internal.hpp"
 #include "common/log.hpp"
 
-//length of vector
-#define v_length(x, y, z) (sqrt( (x)*(x) + (y)*(y) + (z)*(z) ))
-
 //override index when merging of contacts (tmp solution until next version of ode!)
 //(see Geom *Model_Mesh::Create_Mesh(Object *obj) below for details)
 int mergecallback(dGeomID geom, int index1, int index2)
@@ -120,7 +117,8 @@ Geom *Model_Mesh::Create_Mesh(Object *obj)
 	//enable per-triangle collision detection (for different materials)
 	//always used to display which triangle is colliding:
 	geom->triangle_count = triangle_count;
-	geom->triangle_colliding = new bool[triangle_count];
+	geom->triangle_colliding = new bool[triangle_count](); //all false
+	Geom::triangles_total += triangle_count;
 	//(optional) used for assigning different surfaces for different materials:
 	geom->material_count = material_count;
 	geom->parent_materials = materials; //points at out simple material list
@@ -162,15 +160,12 @@ Model_Mesh *Model::Create_Mesh()
 	else
 		Log_Add(2, "Creating collision trimesh");
 
+	//load and process (or get from cache)
+	if (!Cook())
+		return NULL;
+
 	//check that we got any data (and how much?)
-	unsigned int tris=0, mats=0, tmp;;
-	size_t material_count=materials.size();
-	for (unsigned int mat=0; mat<material_count; ++mat)
-		if ((tmp = materials[mat].triangles.size()))
-		{
-			tris += tmp;
-			++mats;
-		}
+	unsigned int tris=cooked.header->mesh_triangles, mats=cooked.header->mesh_materials;
 
 	if (!tris)
 	{
@@ -179,7 +174,7 @@ Model_Mesh *Model::Create_Mesh()
 	}
 
 	//assumed to be non-empty
-	size_t verts = vertices.size();
+	size_t verts = cooked.header->mesh_vertices;
 
 	Log_Add(2, "number of vertices: %u, number of triangles: %u", verts, tris);
 
@@ -201,76 +196,21 @@ Model_Mesh *Model::Create_Mesh()
 	n = new Vector_Float[tris]; //one normal per triangle
 	m = new Model_Mesh::Material[mats]; //one material per material
 
-	//copy
-	//vertices
-	for (unsigned int loop=0; loop<verts; ++loop)
-		v[loop] = vertices[loop];
-
-	//triangles (using indexed vertices and an array of normals)
-	//by material:
-	unsigned int tcount=0, mcount=0; //total counters (for where to fill in data)
-	unsigned int *vp; //vertex index pointer
-	unsigned int mloop=0, tloop=0; //material/triangle looping
-	float ax,ay,az,bx,by,bz,x,y,z,l; //(fooling myself these declarations will increase speed)
-	unsigned int mtris; //how many triangles per material
-	for (mloop=0; mloop<material_count; ++mloop)
-		if ((mtris = materials[mloop].triangles.size()))
-		{
-			//copy triangles
-			for (tloop=0; tloop<mtris; ++tloop)
-			{
-				vp = materials[mloop].triangles[tloop].vertex;
-
-				//indices
-				i[3*tcount] = vp[0];
-				i[3*tcount+1] = vp[1];
-				i[3*tcount+2] = vp[2];
-
-				//normals
-				//NOTE: ode uses one, not indexed, normal per triangle,
-				//use cross product to calculate one proper normal:
-				//(the same as in Generate_Missing_Normals)
-
-				//get vertices
-				Vector_Float v1 = vertices[vp[0]];
-				Vector_Float v2 = vertices[vp[1]];
-				Vector_Float v3 = vertices[vp[2]];
-
-				//create two vectors (a and b)
-				ax = (v2.x-v1.x);
-				ay = (v2.y-v1.y);
-				az = (v2.z-v1.z);
-
-				bx = (v3.x-v1.x);
-				by = (v3.y-v1.y);
-				bz = (v3.z-v1.z);
-
-				//cross product gives normal:
-				x = (ay*bz)-(az*by);
-				y = (az*bx)-(ax*bz);
-				z = (ax*by)-(ay*bx);
-				
-				//set and make unit:
-				l = v_length(x, y, z);
-
-				n[tcount].x = x/l;
-				n[tcount].y = y/l;
-				n[tcount].z = z/l;
-
-				//increase triangle count
-				++tcount;
-			}
-
-			//"copy" material (name+triangle index):
-			m[mcount].end = tcount;
-			//allocate for name
-			m[mcount].name = new char[materials[mloop].name.size()+1];
-			//copy name
-			strcpy(m[mcount].name, materials[mloop].name.c_str());
-
-			//increase material counter
-			++mcount;
-		}
+	//copy (already in the right format)
+	memcpy(v, cooked.mesh_vertices, sizeof(Vector_Float)*verts);
+	memcpy(i, cooked.mesh_indices, sizeof(unsigned int)*tris*3);
+	memcpy(n, cooked.mesh_normals, sizeof(Vector_Float)*tris);
+
+	//materials (name+triangle index)
+	const char *mname;
+	for (unsigned int mloop=0; mloop<mats; ++mloop)
+	{
+		m[mloop].end = cooked.mesh_materials[mloop].end;
+
+		mname = cooked.strings+cooked.mesh_materials[mloop].name;
+		m[mloop].name = new char[strlen(mname)+1];
+		strcpy(m[mloop].name, mname);
+	}
 
 	//create
 	Model_Mesh *result = new Model_Mesh(name.c_str(),
@@ -286,5 +226,3 @@ Model_Mesh *Model::Create_Mesh()
 
 	return result;
 }
-
-
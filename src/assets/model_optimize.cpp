@@ -0,0 +1,459 @@
+/*
+ * ReCaged - a Free Software, Futuristic, Racing Game
+ *
+ * Copyright (C) 2015 Mats Wahlberg
+ *
+ * This file is part of ReCaged.
+ *
+ * ReCaged is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ReCaged is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ReCaged.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+//reordering of rendering triangles and vertices: triangles are sorted so
+//vertices are reused while still in the post-transform cache of graphics
+//cards (Forsyth, "Linear-Speed Vertex Cache Optimisation"), and then groups
+//of triangles are sorted so outer surfaces are drawn first (reducing
+//overdraw, Sander et al, "Fast Triangle Reordering for Vertex Locality and
+//Reduced Overdraw"). Also conversion to compact vertices
+
+#include <math.h>
+#include <algorithm>
+
+#include "model.hpp"
+#include "common/log.hpp"
+
+//cache size assumed when sorting (lru), and when measuring (fifo)
+#define OPTIMIZE_CACHE_SIZE 32
+#define MEASURE_CACHE_SIZE 16
+
+//largest position error of compact vertices before warning (in meters)
+#define COMPACT_WARNING_ERROR 0.01
+
+//how good it is to use a vertex next: favours vertices recently used and
+//vertices with few triangles left (so no lone triangles are left behind)
+static float Vertex_Score(int position, Uint32 valence)
+{
+	//no triangles left
+	if (!valence)
+		return -1.0;
+
+	float score = 0.0;
+	if (position >= 0)
+	{
+		//used by last triangle: fixed score (so not just following one strip)
+		if (position < 3)
+			score = 0.75;
+		else
+			score = powf(1.0-(position-3)*(1.0/(OPTIMIZE_CACHE_SIZE-3)), 1.5);
+	}
+
+	return score + 2.0/sqrtf(valence);
+}
+
+//simulated (fifo) vertex cache, for measuring and splitting into clusters
+class Cache_Fifo
+{
+	public:
+		Cache_Fifo(Uint32 vertex_count): stamp(vertex_count, 0), time(MEASURE_CACHE_SIZE+1) {}
+
+		//number of misses for triangle
+		int Misses(const Uint32 *triangle)
+		{
+			int misses = 0;
+			for (int c=0; c<3; ++c)
+				if (time-stamp[triangle[c]] > MEASURE_CACHE_SIZE)
+				{
+					stamp[triangle[c]] = time++;
+					++misses;
+				}
+			return misses;
+		}
+
+	private:
+		std::vector<Uint32> stamp;
+		Uint32 time;
+};
+
+//cluster of triangles, sorted by how far out it is facing
+struct Cluster
+{
+	Uint32 start, end;
+	float sort;
+};
+
+static bool Cluster_Compare(const Cluster &a, const Cluster &b)
+{
+	return a.sort > b.sort;
+}
+
+//sort triangles for vertex cache
+static void Optimize_Cache(Uint32 *indices, Uint32 count, Uint32 vertex_count)
+{
+	Uint32 tris = count/3;
+	Uint32 i, t, v;
+	int c;
+
+	//triangles using each vertex (only counting the ones not yet added)
+	std::vector<Uint32> valence(vertex_count, 0);
+	for (i=0; i<count; ++i)
+		++valence[indices[i]];
+
+	std::vector<Uint32> offset(vertex_count+1, 0);
+	for (v=0; v<vertex_count; ++v)
+		offset[v+1] = offset[v]+valence[v];
+
+	std::vector<Uint32> vertex_triangles(count);
+	std::vector<Uint32> fill(offset.begin(), offset.end()-1);
+	for (i=0; i<count; ++i)
+		vertex_triangles[fill[indices[i]]++] = i/3;
+
+	//scores
+	std::vector<int> position(vertex_count, -1);
+	std::vector<float> vertex_score(vertex_count, 0.0);
+	for (i=0; i<count; ++i)
+		vertex_score[indices[i]] = Vertex_Score(-1, valence[indices[i]]);
+
+	std::vector<float> triangle_score(tris);
+	std::vector<bool> added(tris, false);
+	Uint32 best = 0;
+	for (t=0; t<tris; ++t)
+	{
+		triangle_score[t] =	vertex_score[indices[3*t]]+
+					vertex_score[indices[3*t+1]]+
+					vertex_score[indices[3*t+2]];
+		if (triangle_score[t] > triangle_score[best])
+			best = t;
+	}
+
+	std::vector<Uint32> output(count);
+	Uint32 cache[OPTIMIZE_CACHE_SIZE+3], new_cache[OPTIMIZE_CACHE_SIZE+3];
+	Uint32 cache_size = 0, new_size, *list, cursor = 0;
+	const Uint32 *triangle;
+
+	for (Uint32 out=0; out<tris; ++out)
+	{
+		//add it
+		added[best] = true;
+		triangle = &indices[3*best];
+		output[3*out] = triangle[0];
+		output[3*out+1] = triangle[1];
+		output[3*out+2] = triangle[2];
+
+		//its vertices first in cache, and not counting it anymore
+		new_size = 0;
+		for (c=0; c<3; ++c)
+		{
+			v = triangle[c];
+			list = &vertex_triangles[offset[v]];
+			for (i=0; list[i] != best; ++i);
+			list[i] = list[--valence[v]];
+
+			if (std::find(new_cache, new_cache+new_size, v) == new_cache+new_size)
+				new_cache[new_size++] = v;
+		}
+
+		//then the rest of old cache
+		for (i=0; i<cache_size; ++i)
+			if (std::find(triangle, triangle+3, cache[i]) == triangle+3)
+				new_cache[new_size++] = cache[i];
+
+		//update positions and scores (also of those pushed out)
+		for (i=0; i<new_size; ++i)
+		{
+			v = new_cache[i];
+			position[v] = (i<OPTIMIZE_CACHE_SIZE)? i: -1;
+			vertex_score[v] = Vertex_Score(position[v], valence[v]);
+		}
+
+		cache_size = std::min(new_size, (Uint32)OPTIMIZE_CACHE_SIZE);
+		std::copy(new_cache, new_cache+cache_size, cache);
+
+		//best of the triangles using these vertices
+		float best_score = -1.0;
+		best = tris;
+		for (i=0; i<new_size; ++i)
+		{
+			v = new_cache[i];
+			list = &vertex_triangles[offset[v]];
+			for (Uint32 j=0; j<valence[v]; ++j)
+			{
+				t = list[j];
+				triangle_score[t] =	vertex_score[indices[3*t]]+
+							vertex_score[indices[3*t+1]]+
+							vertex_score[indices[3*t+2]];
+				if (triangle_score[t] > best_score)
+				{
+					best_score = triangle_score[t];
+					best = t;
+				}
+			}
+		}
+
+		//none, just take next unused
+		if (best == tris)
+		{
+			while (cursor < tris && added[cursor])
+				++cursor;
+			best = cursor;
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+//sort clusters of triangles (split where the cache is reloaded anyway) so
+//those facing away from center are drawn first (positions every stride floats)
+static void Optimize_Overdraw(Uint32 *indices, Uint32 count,
+		const float *positions, size_t stride, Uint32 vertex_count)
+{
+	Uint32 tris = count/3;
+	Uint32 i, t;
+
+	std::vector<Cluster> clusters;
+	Cache_Fifo fifo(vertex_count);
+	Cluster cluster;
+	cluster.start = 0;
+	for (t=0; t<tris; ++t)
+		if (fifo.Misses(&indices[3*t]) == 3 && t)
+		{
+			cluster.end = t;
+			clusters.push_back(cluster);
+			cluster.start = t;
+		}
+	cluster.end = tris;
+	clusters.push_back(cluster);
+
+	if (clusters.size() < 2)
+		return;
+
+	//center (weighted by area) and normal (length is area) of each cluster
+	std::vector<float> centers(3*clusters.size(), 0.0);
+	std::vector<float> normals(3*clusters.size(), 0.0);
+	float center[3] = {0.0, 0.0, 0.0}, area = 0.0;
+	float a[3], b[3], n[3], l;
+	const float *v1, *v2, *v3;
+
+	for (i=0; i<clusters.size(); ++i)
+	{
+		float cluster_area = 0.0;
+		float *c = &centers[3*i];
+
+		for (t=clusters[i].start; t<clusters[i].end; ++t)
+		{
+			v1 = positions+stride*indices[3*t];
+			v2 = positions+stride*indices[3*t+1];
+			v3 = positions+stride*indices[3*t+2];
+
+			a[0]=v2[0]-v1[0]; a[1]=v2[1]-v1[1]; a[2]=v2[2]-v1[2];
+			b[0]=v3[0]-v1[0]; b[1]=v3[1]-v1[1]; b[2]=v3[2]-v1[2];
+			n[0]=a[1]*b[2]-a[2]*b[1];
+			n[1]=a[2]*b[0]-a[0]*b[2];
+			n[2]=a[0]*b[1]-a[1]*b[0];
+			l = sqrtf(n[0]*n[0]+n[1]*n[1]+n[2]*n[2]);
+
+			c[0] += l*(v1[0]+v2[0]+v3[0])/3.0;
+			c[1] += l*(v1[1]+v2[1]+v3[1])/3.0;
+			c[2] += l*(v1[2]+v2[2]+v3[2])/3.0;
+			normals[3*i] += n[0];
+			normals[3*i+1] += n[1];
+			normals[3*i+2] += n[2];
+			cluster_area += l;
+		}
+
+		center[0] += c[0];
+		center[1] += c[1];
+		center[2] += c[2];
+		area += cluster_area;
+
+		if (cluster_area > 0.0)
+		{
+			c[0] /= cluster_area;
+			c[1] /= cluster_area;
+			c[2] /= cluster_area;
+		}
+	}
+
+	if (area > 0.0)
+	{
+		center[0] /= area;
+		center[1] /= area;
+		center[2] /= area;
+	}
+
+	//how far out, along its normal
+	for (i=0; i<clusters.size(); ++i)
+	{
+		float *c = &centers[3*i], *nc = &normals[3*i];
+		l = sqrtf(nc[0]*nc[0]+nc[1]*nc[1]+nc[2]*nc[2]);
+		if (l > 0.0)
+			clusters[i].sort = (	(c[0]-center[0])*nc[0]+
+						(c[1]-center[1])*nc[1]+
+						(c[2]-center[2])*nc[2]	)/l;
+		else
+			clusters[i].sort = 0.0;
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), Cluster_Compare);
+
+	std::vector<Uint32> output;
+	output.reserve(count);
+	for (i=0; i<clusters.size(); ++i)
+		output.insert(output.end(), indices+3*clusters[i].start, indices+3*clusters[i].end);
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void Model::Optimize_Triangles(Uint32 *indices, Uint32 count,
+		const Model_Draw::Vertex *vertices, Uint32 vertex_count)
+{
+	if (count < 6)
+		return;
+
+	Optimize_Cache(indices, count, vertex_count);
+	Optimize_Overdraw(indices, count, &vertices[0].x,
+			sizeof(Model_Draw::Vertex)/sizeof(GLfloat), vertex_count);
+}
+
+void Model::Optimize_Vertices(std::vector<Model_Draw::Vertex> &vertices, std::vector<Uint32> &indices)
+{
+	std::vector<Uint32> remap(vertices.size(), INDEX_ERROR);
+	std::vector<Model_Draw::Vertex> ordered;
+	ordered.reserve(vertices.size());
+
+	Uint32 v;
+	for (size_t i=0; i<indices.size(); ++i)
+	{
+		v = indices[i];
+		if (remap[v] == INDEX_ERROR)
+		{
+			remap[v] = ordered.size();
+			ordered.push_back(vertices[v]);
+		}
+		indices[i] = remap[v];
+	}
+
+	vertices.swap(ordered);
+}
+
+float Model::Cache_Miss_Ratio(const Uint32 *indices, Uint32 count, Uint32 vertex_count)
+{
+	Uint32 tris = count/3;
+	if (!tris)
+		return 0.0;
+
+	Cache_Fifo fifo(vertex_count);
+	Uint32 misses = 0;
+	for (Uint32 t=0; t<tris; ++t)
+		misses += fifo.Misses(&indices[3*t]);
+
+	return (float)misses/tris;
+}
+
+//value as (rounded) number of steps from offset
+static GLshort Quantize(float value, float offset, float scale)
+{
+	float steps = floorf((value-offset)/scale+0.5);
+	return (GLshort) std::max(-32767.0f, std::min(32767.0f, steps));
+}
+
+static GLbyte Quantize_Normal(float value)
+{
+	float steps = floorf(value*127.0+0.5);
+	return (GLbyte) std::max(-127.0f, std::min(127.0f, steps));
+}
+
+void Model::Compact_Vertices(const std::vector<Model_Draw::Vertex> &vertices,
+		std::vector<Model_Draw::Compact_Vertex> &compact,
+		float position[4], float texcoord[4])
+{
+	size_t count = vertices.size();
+	compact.resize(count);
+
+	//bounds
+	float min[5], max[5];
+	size_t i;
+	int a;
+	for (a=0; a<5; ++a)
+	{
+		min[a] = count? (&vertices[0].x)[a]: 0.0;
+		max[a] = min[a];
+	}
+
+	for (i=0; i<count; ++i)
+		for (a=0; a<5; ++a)
+		{
+			float value = (&vertices[i].x)[a];
+			min[a] = std::min(min[a], value);
+			max[a] = std::max(max[a], value);
+		}
+
+	//position: same scale for all axes (so normals are not distorted)
+	float size = 0.0;
+	for (a=0; a<3; ++a)
+	{
+		position[a] = (min[a]+max[a])/2.0;
+		size = std::max(size, (max[a]-min[a])/2.0f);
+	}
+	position[3] = size>0.0? size/32767.0: 1.0;
+
+	//texcoords: separate scales
+	for (a=0; a<2; ++a)
+	{
+		texcoord[a] = (min[3+a]+max[3+a])/2.0;
+		texcoord[2+a] = max[3+a]>min[3+a]? (max[3+a]-min[3+a])/2.0/32767.0: 1.0;
+	}
+
+	//convert, and find largest errors
+	float position_error = 0.0, normal_error = 0.0, texcoord_error = 0.0;
+	float x, y, z, l, dot;
+	for (i=0; i<count; ++i)
+	{
+		const Model_Draw::Vertex *v = &vertices[i];
+		Model_Draw::Compact_Vertex *c = &compact[i];
+
+		c->x = Quantize(v->x, position[0], position[3]);
+		c->y = Quantize(v->y, position[1], position[3]);
+		c->z = Quantize(v->z, position[2], position[3]);
+		c->w = 0;
+		c->u = Quantize(v->u, texcoord[0], texcoord[2]);
+		c->v = Quantize(v->v, texcoord[1], texcoord[3]);
+
+		//(normal made unit first)
+		l = sqrtf(v->nx*v->nx + v->ny*v->ny + v->nz*v->nz);
+		if (l == 0.0)
+			l = 1.0;
+		c->nx = Quantize_Normal(v->nx/l);
+		c->ny = Quantize_Normal(v->ny/l);
+		c->nz = Quantize_Normal(v->nz/l);
+		c->nw = 0;
+
+		x = position[0]+c->x*position[3] - v->x;
+		y = position[1]+c->y*position[3] - v->y;
+		z = position[2]+c->z*position[3] - v->z;
+		position_error = std::max(position_error, sqrtf(x*x+y*y+z*z));
+
+		texcoord_error = std::max(texcoord_error, fabsf(texcoord[0]+c->u*texcoord[2] - v->u));
+		texcoord_error = std::max(texcoord_error, fabsf(texcoord[1]+c->v*texcoord[3] - v->v));
+
+		x = c->nx; y = c->ny; z = c->nz;
+		dot = (x*v->nx + y*v->ny + z*v->nz)/(l*sqrtf(x*x+y*y+z*z));
+		normal_error = std::max(normal_error, acosf(std::min(dot, 1.0f)));
+	}
+
+	Log_Add(2, "Compact vertices for model \"%s\": largest error %fm position, %f degrees normal, %f texcoord",
+			name.c_str(), position_error, normal_error*(180.0/M_PI), texcoord_error);
+
+	if (position_error > COMPACT_WARNING_ERROR)
+		Log_Add(0, "WARNING: compact vertices of model \"%s\" are off by up to %fm (model too big?)",
+				name.c_str(), position_error);
+}
@@ -20,28 +20,287 @@
  */ 
 
 #include <SDL/SDL.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "common/log.hpp"
+#include "common/clock.hpp"
 #include "model.hpp"
-#include "text_file.hpp"
+#include "mapped_file.hpp"
 
+//
+//the obj/mtl files are parsed directly from the (mapped) file, without copying
+//lines or words. Words are split the same way as by Text_File, and numbers are
+//converted to the same values as by atof/sscanf (but much faster). The aim of
+//10 times faster loading was not met: a 215MB file loads about 4-5 times
+//faster (and just reading each byte once takes a fifth of the new time)
+//
+
+struct OBJ_Word
+{
+	const char *start;
+	size_t length;
+};
+
+//same as isspace in "C" locale (space, \t, \n, \v, \f or \r)
+static inline bool OBJ_Space(char c)
+{
+	return (c == ' ' || (c >= '\t' && c <= '\r'));
+}
+
+//character in word (or \0 if after end, like in null terminated string)
+static inline char OBJ_Char(const OBJ_Word &word, size_t i)
+{
+	return (i < word.length)? word.start[i]: '\0';
+}
+
+static inline bool OBJ_Is(const OBJ_Word &word, const char *text)
+{
+	return (!strncmp(word.start, text, word.length) && text[word.length] == '\0');
+}
+
+static inline std::string OBJ_String(const OBJ_Word &word)
+{
+	return std::string(word.start, word.length);
+}
+
+//splits next line with words into list, returns false at end of file
+static bool OBJ_Next_Line(const char *&pos, const char *end, std::vector<OBJ_Word> &words)
+{
+	OBJ_Word word;
+	words.clear();
+
+	while (pos < end)
+	{
+		if (*pos == '\n') //end of line, done if got any words
+		{
+			++pos;
+			if (!words.empty())
+				return true;
+		}
+		else if (OBJ_Space(*pos))
+			++pos;
+		else if (*pos == '#') //comment, throw rest of line
+		{
+			pos = (const char*)memchr(pos, '\n', end-pos);
+			if (!pos)
+				pos = end;
+		}
+		else if (*pos == '\"') //quotation: "word" begins after " and ends at "
+		{
+			++pos;
+
+			if (pos == end || *pos == '\n')
+			{
+				Log_Add(0, "WARNING: OBJ line ended just after quotation mark (ignored)...");
+				continue;
+			}
+
+			word.start = pos;
+			while (pos < end && *pos != '\"' && *pos != '\n')
+				++pos;
+			word.length = pos-word.start;
+			words.push_back(word);
+
+			if (pos == end || *pos == '\n')
+				Log_Add(0, "WARNING: OBJ reached end of line before end of quote (ignored)...");
+			else
+				++pos; //jump over "
+		}
+		else //normal: word ends at space
+		{
+			word.start = pos;
+			while (pos < end && !OBJ_Space(*pos))
+				++pos;
+			word.length = pos-word.start;
+			words.push_back(word);
+		}
+	}
+
+	return !words.empty();
+}
+
+//powers of 10 that are exact as doubles
+static const double OBJ_Exact_Pow10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+//like atof, but quick for normal decimal numbers: if the digits fit in the
+//double mantissa, and the power of ten is exact, a single multiplication or
+//division gives the correctly rounded value (the same as strtod). Anything
+//else (long numbers, hex, inf...) is passed on to strtod
+static double OBJ_Float(const OBJ_Word &word)
+{
+	const char *p = word.start, *end = word.start+word.length;
+	bool negative = false;
+
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = (*(p++) == '-');
+
+	Uint64 mantissa = 0;
+	int digits = 0; //significant
+	int exponent = 0;
+	bool got_digit = false;
+
+	for (; p < end && *p >= '0' && *p <= '9'; ++p)
+	{
+		got_digit = true;
+		if (mantissa || *p != '0')
+		{
+			mantissa = mantissa*10 + (*p-'0');
+			++digits;
+		}
+	}
+
+	if (p < end && *p == '.')
+	{
+		for (++p; p < end && *p >= '0' && *p <= '9'; ++p)
+		{
+			got_digit = true;
+			if (mantissa || *p != '0')
+			{
+				mantissa = mantissa*10 + (*p-'0');
+				++digits;
+			}
+			--exponent;
+		}
+	}
+
+	//only exponent if followed by digits
+	if (got_digit && p+1 < end && (*p == 'e' || *p == 'E'))
+	{
+		const char *e = p+1;
+		bool e_negative = false;
+		if (*e == '-' || *e == '+')
+			e_negative = (*(e++) == '-');
+
+		if (e < end && *e >= '0' && *e <= '9')
+		{
+			int e_value = 0;
+			for (; e < end && *e >= '0' && *e <= '9'; ++e)
+				if (e_value < 10000)
+					e_value = e_value*10 + (*e-'0');
+
+			exponent += e_negative? -e_value: e_value;
+			p = e;
+		}
+	}
+
+	//fast path possible?
+	if (got_digit && p == end && digits <= 19 && mantissa <= ((Uint64)1<<53))
+	{
+		double value = (double)mantissa;
+
+		if (!mantissa)
+			return negative? -0.0: 0.0;
+		if (exponent >= 0 && exponent <= 22)
+			value *= OBJ_Exact_Pow10[exponent];
+		else if (exponent < 0 && exponent >= -22)
+			value /= OBJ_Exact_Pow10[-exponent];
+		else
+			goto fallback;
+
+		return negative? -value: value;
+	}
+
+	fallback:
+	char buffer[64];
+	if (word.length < sizeof(buffer))
+	{
+		memcpy(buffer, word.start, word.length);
+		buffer[word.length] = '\0';
+		return strtod(buffer, NULL);
+	}
+	else
+		return strtod(OBJ_String(word).c_str(), NULL);
+}
+
+//like scanning "%u" (including optional sign), returns false if no number
+static bool OBJ_Uint(const char *&p, const char *end, unsigned int &value)
+{
+	const char *s = p;
+	bool negative = false;
+
+	if (s < end && (*s == '-' || *s == '+'))
+		negative = (*(s++) == '-');
+
+	if (s == end || *s < '0' || *s > '9')
+		return false;
+
+	unsigned long number = 0;
+	bool overflow = false;
+	for (; s < end && *s >= '0' && *s <= '9'; ++s)
+	{
+		if (number > (((unsigned long)-1)-9)/10)
+			overflow = true;
+		else
+			number = number*10 + (*s-'0');
+	}
+
+	if (overflow)
+		number = (unsigned long)-1;
+	else if (negative)
+		number = -number;
+
+	value = (unsigned int)number;
+	p = s;
+	return true;
+}
+
+//like sscanf(word, "%u/%u/%u", &v, &t, &n), returns number of values read
+static int OBJ_Index(const OBJ_Word &word, unsigned int &v, unsigned int &t, unsigned int &n)
+{
+	const char *p = word.start, *end = word.start+word.length;
+
+	if (!OBJ_Uint(p, end, v))
+		return 0;
+	if (p == end || *p != '/')
+		return 1;
+	++p;
+	if (!OBJ_Uint(p, end, t))
+		return 1;
+	if (p == end || *p != '/')
+		return 2;
+	++p;
+	if (!OBJ_Uint(p, end, n))
+		return 2;
+	return 3;
+}
+
+//like sscanf(word, "%*u//%u", &n) == 1
+static bool OBJ_Index_Normal(const OBJ_Word &word, unsigned int &n)
+{
+	const char *p = word.start, *end = word.start+word.length;
+	unsigned int skip;
+
+	if (!OBJ_Uint(p, end, skip) || end-p < 2 || p[0] != '/' || p[1] != '/')
+		return false;
+
+	p+=2;
+	return OBJ_Uint(p, end, n);
+}
 
 bool Model::Load_OBJ(const char *f)
 {
 	Log_Add(2, "Loading model from OBJ file %s", f);
 
-	Text_File file;
+	Uint64 start_time = Clock_Get();
+	Mapped_File file;
 
 	//check if ok...
 	if (!file.Open(f))
 	{
-		Log_Add(-1, "Unable to open 3D file \"%s\": %s", f, SDL_GetError());
+		Log_Add(-1, "Unable to open 3D file \"%s\"", f);
 		return false;
 	}
 
 	//
 	//ok, start processing
 	//
+	const char *pos = file.data, *end = file.data+file.size;
+	std::vector<OBJ_Word> words;
+	size_t word_count;
+
 	Vector_Float vector;
 	Vector2_Float vector2;
 	Triangle_Uint triangle; //for building a triangle
@@ -51,33 +310,36 @@ bool Model::Load_OBJ(const char *f)
 	unsigned int vi, ti, ni; //vertex, uv, normal index
 	int count;
 
-	while (file.Read_Line())
+	while (OBJ_Next_Line(pos, end, words))
 	{
+		word_count = words.size();
+		const OBJ_Word &first = words[0];
+
 		// "v" vertex and 4 words
-		if (file.words[0][0]=='v' && file.words[0][1]=='\0' && file.word_count==4)
+		if (first.length==1 && first.start[0]=='v' && word_count==4)
 		{
-			vector.x=atof(file.words[1]);
-			vector.y=atof(file.words[2]);
-			vector.z=atof(file.words[3]);
+			vector.x=OBJ_Float(words[1]);
+			vector.y=OBJ_Float(words[2]);
+			vector.z=OBJ_Float(words[3]);
 
 			vertices.push_back(vector); //add to list
 		} // "vn" normal and 4 words
-		else if (file.words[0][0]=='v' && file.words[0][1]=='n' && file.words[0][2]=='\0' && file.word_count==4)
+		else if (first.length==2 && first.start[0]=='v' && first.start[1]=='n' && word_count==4)
 		{
-			vector.x=atof(file.words[1]);
-			vector.y=atof(file.words[2]);
-			vector.z=atof(file.words[3]);
+			vector.x=OBJ_Float(words[1]);
+			vector.y=OBJ_Float(words[2]);
+			vector.z=OBJ_Float(words[3]);
 
 			normals.push_back(vector); //add to list
 		} // "f" uv and at least 3 words (2D coordinates, any more elements ignored)
-		else if (file.words[0][0]=='v' && file.words[0][1]=='t' && file.words[0][2]=='\0' && file.word_count>=3)
+		else if (first.length==2 && first.start[0]=='v' && first.start[1]=='t' && word_count>=3)
 		{
-			vector2.x=atof(file.words[1]);
-			vector2.y=-atof(file.words[2]); //needs to reverse this one (counteract opengl weirdness)
+			vector2.x=OBJ_Float(words[1]);
+			vector2.y=-OBJ_Float(words[2]); //needs to reverse this one (counteract opengl weirdness)
 
 			texcoords.push_back(vector2); //add to list
 		} // "f" index and more than 3 words (needs at least 3 indices)
-		else if (file.words[0][0]=='f' && file.words[0][1]=='\0' && file.word_count>3)
+		else if (first.length==1 && first.start[0]=='f' && word_count>3)
 		{
 			//no material right now, warn and create default:
 			if (matnr == INDEX_ERROR)
@@ -87,14 +349,16 @@ bool Model::Load_OBJ(const char *f)
 				matnr = 0;
 			}
 
-			for (int i=1; i<file.word_count; ++i)
+			std::vector<Triangle_Uint> &triangles = materials[matnr].triangles;
+
+			for (size_t i=1; i<word_count; ++i)
 			{
 				// - format: v/(t)/(n) - vertex, texture, normal
 				// only v is absolutely needed, and not optional
 				// t ignored for now
 				ti = 0; //default
 				ni = INDEX_ERROR; //default
-				count = sscanf(file.words[i], "%u/%u/%u", &vi, &ti, &ni);
+				count = OBJ_Index(words[i], vi, ti, ni);
 
 				if (count == 0) //nothing read
 				{
@@ -113,12 +377,10 @@ bool Model::Load_OBJ(const char *f)
 					}
 					else if (count == 2) //no normal, but uv
 						--ti; //like above, but not normals
-					else if (count == 1 && sscanf(file.words[i], "%*u//%u", &ni) == 1) //not t, perhaps n is stil there?
+					else if (count == 1 && OBJ_Index_Normal(words[i], ni)) //not t, perhaps n is stil there?
 						--ni;
 				}
 
-				//now we got indices, see what to do with them
-				//note: this checking is ugly from performance point of view, but helps keep the code clean
 				//the first two times, just store indices, then start build triangles for each new index
 				if (i>2) //time to build
 				{
@@ -133,7 +395,7 @@ bool Model::Load_OBJ(const char *f)
 					triangle.normal[2]=ni; //normal
 
 					//store
-					materials[matnr].triangles.push_back(triangle);
+					triangles.push_back(triangle);
 				}
 				else if (i==2) //second time
 				{
@@ -149,9 +411,9 @@ bool Model::Load_OBJ(const char *f)
 				}
 			}
 		}
-		else if (!strcmp(file.words[0], "usemtl") && file.word_count==2)
+		else if (OBJ_Is(first, "usemtl") && word_count==2)
 		{
-			tmpmatnr = Find_Material(file.words[1]);
+			tmpmatnr = Find_Material(OBJ_String(words[1]).c_str());
 
 			if (tmpmatnr == INDEX_ERROR)
 				Log_Add(0, "WARNING: ignoring change of material (things will probably look wrong)");
@@ -160,9 +422,9 @@ bool Model::Load_OBJ(const char *f)
 
 			//else, we now have material switch for next triangles
 		}
-		else if (!strcmp(file.words[0], "mtllib") && file.word_count==2)
+		else if (OBJ_Is(first, "mtllib") && word_count==2)
 		{
-			matpath=Relative_Path(file.words[1]);
+			matpath=Relative_Path(OBJ_String(words[1]).c_str());
 			Load_Material(matpath.c_str()); //don't care if fails, continue anyway
 		}
 	}
@@ -233,7 +495,8 @@ bool Model::Load_OBJ(const char *f)
 	Normalize_Normals();
 	Generate_Missing_Normals(); //creates missing normals - unit, don't need normalizing
 
-	Log_Add(2, "OBJ loading info: %u triangles, %u materials", triangle_count, materials.size());
+	Log_Add(2, "OBJ loading info: %u triangles, %u materials, %fms", triangle_count, materials.size(),
+			(Clock_Get()-start_time)/1000000.0);
 
 	return true;
 }
@@ -242,7 +505,7 @@ bool Model::Load_MTL(const char *f)
 {
 	Log_Add(2, "Loading model material(s) from MTL file %s", f);
 
-	Text_File file;
+	Mapped_File file;
 	Material_Float *material;
 
 	//check if ok...
@@ -252,15 +515,21 @@ bool Model::Load_MTL(const char *f)
 	//
 	//start processing
 	//
+	const char *pos = file.data, *end = file.data+file.size;
+	std::vector<OBJ_Word> words;
+	size_t word_count;
 	unsigned int mat_nr=INDEX_ERROR;
 
-	while (file.Read_Line())
+	while (OBJ_Next_Line(pos, end, words))
 	{
-		if ( (!strcmp(file.words[0], "newmtl")) && file.word_count == 2 )
+		word_count = words.size();
+		const OBJ_Word &first = words[0];
+
+		if ( OBJ_Is(first, "newmtl") && word_count == 2 )
 		{
 			mat_nr = materials.size(); //how much used, which number to give this material
 			materials.push_back(Material_Default); //add new material (with defaults)
-			materials[mat_nr].name = file.words[1]; //set name
+			materials[mat_nr].name = OBJ_String(words[1]); //set name
 		}
 		else if (mat_nr == INDEX_ERROR)
 			Log_Add(-1, "\"%s\" wants to specify material properties for unnamed material?! Ignoring", f);
@@ -270,45 +539,45 @@ bool Model::Load_MTL(const char *f)
 			material=&materials[mat_nr].material;
 
 			//material properties:
-			if (file.words[0][0] == 'K') //K=colours?
+			if (OBJ_Char(first, 0) == 'K') //K=colours?
 			{
-				if (file.words[0][1] == 'a' && file.word_count == 4) //ambient
+				if (OBJ_Char(first, 1) == 'a' && word_count == 4) //ambient
 				{
-					material->ambient[0] = atof(file.words[1]);
-					material->ambient[1] = atof(file.words[2]);
-					material->ambient[2] = atof(file.words[3]);
+					material->ambient[0] = OBJ_Float(words[1]);
+					material->ambient[1] = OBJ_Float(words[2]);
+					material->ambient[2] = OBJ_Float(words[3]);
 				}
-				else if (file.words[0][1] == 'd' && file.word_count == 4) //diffuse
+				else if (OBJ_Char(first, 1) == 'd' && word_count == 4) //diffuse
 				{
-					material->diffuse[0] = atof(file.words[1]);
-					material->diffuse[1] = atof(file.words[2]);
-					material->diffuse[2] = atof(file.words[3]);
+					material->diffuse[0] = OBJ_Float(words[1]);
+					material->diffuse[1] = OBJ_Float(words[2]);
+					material->diffuse[2] = OBJ_Float(words[3]);
 				}
-				else if (file.words[0][1] == 's' && file.word_count == 4) //specular
+				else if (OBJ_Char(first, 1) == 's' && word_count == 4) //specular
 				{
-					material->specular[0] = atof(file.words[1]);
-					material->specular[1] = atof(file.words[2]);
-					material->specular[2] = atof(file.words[3]);
+					material->specular[0] = OBJ_Float(words[1]);
+					material->specular[1] = OBJ_Float(words[2]);
+					material->specular[2] = OBJ_Float(words[3]);
 				}
 
 				//the following seems to be an unofficial extension of the mtl format (which us usefull):
-				else if (file.words[0][1] == 'e' && file.word_count == 4) //emission
+				else if (OBJ_Char(first, 1) == 'e' && word_count == 4) //emission
 				{
-					material->emission[0] = atof(file.words[1]);
-					material->emission[1] = atof(file.words[2]);
-					material->emission[2] = atof(file.words[3]);
+					material->emission[0] = OBJ_Float(words[1]);
+					material->emission[1] = OBJ_Float(words[2]);
+					material->emission[2] = OBJ_Float(words[3]);
 				}
 			}
-			else if (file.words[0][0] == 'N') //some other stuff?
+			else if (OBJ_Char(first, 0) == 'N') //some other stuff?
 			{
 				//only one of these are used:
-				if (file.words[0][1] == 's' && file.word_count == 2) //shininess
+				if (OBJ_Char(first, 1) == 's' && word_count == 2) //shininess
 				{
 					//from what I've read, this vary between 0 to 1000 for obj
-					//materials[mat_nr].shininess = (atof(file.words[1])*(128.0/1000.0));
+					//materials[mat_nr].shininess = (OBJ_Float(words[1])*(128.0/1000.0));
 					//...but all mtl files I've seen are under 128 (valid opengl range),
 					//so lets just load it directly (without converting)...?
-					material->shininess = atof(file.words[1]);
+					material->shininess = OBJ_Float(words[1]);
 
 					//seems like there are mtl files out there with Ns>128?
 					if (material->shininess > 128.0)
@@ -318,9 +587,9 @@ bool Model::Load_MTL(const char *f)
 					}
 				}
 			}
-			else if (!strcmp(file.words[0], "map_Kd") &&file.word_count == 2) //textures (K=colours?)
+			else if (OBJ_Is(first, "map_Kd") && word_count == 2) //textures (K=colours?)
 			{
-				materials[mat_nr].diffusetex = Relative_Path(file.words[1]);
+				materials[mat_nr].diffusetex = Relative_Path(OBJ_String(words[1]).c_str());
 				//TODO: Ka, Ks, Ke, Ns, bump mapping...
 			}
 
@@ -354,3 +623,150 @@ bool Model::Load_MTL(const char *f)
 	return true;
 }
 
+
+//
+//check (--check): the number parsers above must give exactly the same values
+//as atof and sscanf (used before, as implemented by glibc), for every word of
+//a file with odd numbers and for lots of generated words. The file is also
+//loaded, and compared with the checksum of what the old loader gave
+//
+#define OBJ_CHECK_FILE "checks/numbers.obj"
+#define OBJ_CHECK_CHECKSUM 0x44d5edbe
+#define OBJ_CHECK_GENERATED 1000000
+
+static bool OBJ_Check_Word(const OBJ_Word &word)
+{
+	std::string s = OBJ_String(word);
+
+	double a = OBJ_Float(word), b = atof(s.c_str());
+	if (memcmp(&a, &b, sizeof(double)))
+		return false;
+
+	unsigned int v[2]={0,0}, t[2]={0,0}, n[2]={0,0};
+	if (	OBJ_Index(word, v[0], t[0], n[0]) != sscanf(s.c_str(), "%u/%u/%u", &v[1], &t[1], &n[1]) ||
+		v[0] != v[1] || t[0] != t[1] || n[0] != n[1])
+		return false;
+
+	n[0] = n[1] = 0;
+	if (OBJ_Index_Normal(word, n[0]) != (sscanf(s.c_str(), "%*u//%u", &n[1]) == 1) || n[0] != n[1])
+		return false;
+
+	return true;
+}
+
+static char OBJ_Check_Random(Uint32 &seed, const char *chars)
+{
+	seed = seed*1664525u + 1013904223u;
+	return chars[(seed>>16)%strlen(chars)];
+}
+
+//number (or index) like word, with lots of digits, signs and exponents
+static void OBJ_Check_Generate(Uint32 &seed, std::string &word)
+{
+	char c;
+	word.clear();
+	switch (OBJ_Check_Random(seed, "ffffiiir"))
+	{
+		case 'f': //float
+			c = OBJ_Check_Random(seed, "--++..nnnn");
+			if (c != 'n')
+				word += c;
+			while (OBJ_Check_Random(seed, "0123456789dddddde") != 'e')
+				word += OBJ_Check_Random(seed, "0123456789");
+			if (OBJ_Check_Random(seed, ".. ") == '.')
+				word += '.';
+			while (OBJ_Check_Random(seed, "0123456789ddde") != 'e')
+				word += OBJ_Check_Random(seed, "0123456789");
+			if (OBJ_Check_Random(seed, "eEnnnnn") != 'n')
+			{
+				word += OBJ_Check_Random(seed, "eE");
+				word += OBJ_Check_Random(seed, "-+12");
+				while (OBJ_Check_Random(seed, "0123456789dde") != 'e')
+					word += OBJ_Check_Random(seed, "0123456789");
+			}
+			break;
+
+		case 'i': //index
+			for (int i=0; i<3; ++i)
+			{
+				word += OBJ_Check_Random(seed, "-+1111111111");
+				while (OBJ_Check_Random(seed, "0123456789dde") != 'e')
+					word += OBJ_Check_Random(seed, "0123456789");
+				if (OBJ_Check_Random(seed, "//// ") != '/')
+					break;
+				word += '/';
+			}
+			break;
+
+		default: //anything
+			do
+				word += OBJ_Check_Random(seed, "0123456789.eE-+/xXpPinfa");
+			while (OBJ_Check_Random(seed, "dddddddde") != 'e');
+			break;
+	}
+
+	if (word.empty())
+		word = "0";
+}
+
+bool Model::Check_OBJ()
+{
+	Log_Add(1, "Checking OBJ loading with \"%s\"", OBJ_CHECK_FILE);
+
+	Model model;
+	if (!model.Load(OBJ_CHECK_FILE))
+		return false;
+
+	//all words in file
+	Mapped_File file;
+	if (!file.Open(model.path.c_str()))
+	{
+		Log_Add(-1, "Unable to open \"%s\"", model.path.c_str());
+		return false;
+	}
+
+	const char *pos = file.data, *end = file.data+file.size;
+	std::vector<OBJ_Word> words;
+	unsigned int checked = 0, errors = 0;
+	while (OBJ_Next_Line(pos, end, words))
+		for (size_t i=0; i<words.size(); ++i, ++checked)
+			if (!OBJ_Check_Word(words[i]) && !errors++)
+				Log_Add(-1, "OBJ check: \"%s\" not parsed like by atof/sscanf",
+						OBJ_String(words[i]).c_str());
+
+	//generated
+	Uint32 seed = 1;
+	std::string generated;
+	OBJ_Word word;
+	for (int i=0; i<OBJ_CHECK_GENERATED; ++i, ++checked)
+	{
+		OBJ_Check_Generate(seed, generated);
+		word.start = generated.c_str();
+		word.length = generated.size();
+
+		if (!OBJ_Check_Word(word) && !errors++)
+			Log_Add(-1, "OBJ check: \"%s\" not parsed like by atof/sscanf", generated.c_str());
+	}
+
+	if (errors)
+		Log_Add(-1, "OBJ check: %u of %u words parsed differently", errors, checked);
+
+	//and the whole file
+	if (!model.Parse())
+		return false;
+
+	Uint32 checksum = model.Checksum();
+	if (checksum != OBJ_CHECK_CHECKSUM)
+	{
+		Log_Add(-1, "OBJ check failed: checksum %08x, old loader gave %08x",
+				checksum, OBJ_CHECK_CHECKSUM);
+		return false;
+	}
+
+	if (errors)
+		return false;
+
+	Log_Add(1, "OBJ check passed (%u words, checksum %08x)", checked, checksum);
+	return true;
+}
+
@@ -19,19 +19,109 @@
  * along with ReCaged.  If not, see <http://www.gnu.org/licenses/>.
  */ 
 
+#include <SDL/SDL_thread.h>
+#include <string.h>
+
 #include "model.hpp"
+#include "loader.hpp"
 #include "common/log.hpp"
+#include "common/clock.hpp"
 #include "text_file.hpp"
-#include <string.h>
+
+//don't bother with threads for less vertices than this
+#define ROAD_THREAD_VERTICES 65536
 
 //TODO: this code needs much more documentation...
 
+//weights (binomial coefficient * t^i * (1-t)^(n-i)) for all points along x of
+//bezier curves of degree n, and for their derivatives. The same for all
+//sections, so only calculated once for each degree and resolution
+struct Basis
+{
+	int n, xres;
+	std::vector<float> pos; //[i*(xres+1)+x], i=0...n
+	std::vector<float> dir; //[i*(xres+1)+x], i=0...n-1
+
+	Basis(int degree, int resolution):
+		n(degree), xres(resolution), pos((n+1)*(xres+1)), dir(n*(xres+1))
+	{
+		int points = xres+1;
+
+		//for looping through all positions along x
+		float dx=1.0/float(xres);
+		float t=0.0;
+
+		int i, k;
+		float t1, t2, t2mod;
+
+		for (int x=0; x<points; ++x)
+		{
+			//if t=1, then prevent NaN...
+			t2mod = t==1.0? 1.0:1.0/(1.0-t);
+
+			//simple way of calculating binomial coefficients for each i
+			k=1;
+			t1=1.0; //t^i
+			t2=1.0; //(1-t)^(n-i)
+			for (i=0; i<=n-1; ++i)
+				t2*=(1.0-t);
+
+			for (i=0; i<=n; ++i)
+			{
+				//if at last, set to 1
+				if (i==n)
+					t2=1;
+
+				pos[i*points+x] = float(k)*t1*t2;
+
+				//coefficient for next time
+				k*=(n-i);
+				k/=(i+1);
+
+				//t1&t2
+				t1*=t;
+				t2*=t2mod;
+			}
+
+			//derivative, same for n-1
+			k=1;
+			t1=1.0; //t^i
+			t2=1.0; //(1-t)^(n-1-i)
+			for (i=0; i<=n-2; ++i)
+				t2*=(1.0-t);
+
+			for (i=0; i<=(n-1); ++i)
+			{
+				if (i==n-1)
+					t2=1;
+
+				dir[i*points+x] = float(k)*t1*t2;
+
+				k*=(n-1-i);
+				k/=(i+1);
+
+				t1*=t;
+				t2*=t2mod;
+			}
+
+			t+=dx;
+		}
+	}
+};
+
+//positions and directions (x and y separated) for all points along a section
+struct Samples
+{
+	std::vector<float> pos_x, pos_y;
+	std::vector<float> dir_x, dir_y;
+};
+
 //class for processing bezier curves
 class Bezier
 {
 	public:
-		//create from current line in file:
-		Bezier(Text_File *file)
+		//create from current line in file (and add to list):
+		Bezier(Text_File *file, Bezier **head)
 		{
 			//name
 			name = file->words[1];
@@ -50,15 +140,15 @@ class Bezier
 			}
 
 			//link
-			next = head;
-			head = this;
+			next = *head;
+			*head = this;
 		}
 		~Bezier()
 		{
 			//free
 			delete[] p;
 		}
-		static Bezier *Find(const char *name)
+		static Bezier *Find(Bezier *head, const char *name)
 		{
 			for (Bezier *point=head; point; point=point->next)
 				if (point->name == name)
@@ -68,108 +158,89 @@ class Bezier
 			Log_Add(0, "WARNING: unable to find section of road named \"%s\"", name);
 			return NULL;
 		}
-		void GetPos(float t, float *pos)
+		int Degree()
 		{
-			pos[0]=0;
-			pos[1]=0;
-
-			//simple way of calculating binomial coefficients for each i
-			int k=1;
-
-			//power-off for each term:
-			float t1=1.0; //t^i
-
-			float t2=1.0; //(1-t)^(n-i)
-			for (int i=0; i<=n-1; ++i)
-				t2*=(1.0-t);
-
-			//if t=1, then prevent NaN...
-			float t2mod = t==1.0? 1.0:1.0/(1.0-t);
-
-			//calculate
-			for (int i=0; i<=n; ++i)
-			{
-				//if at last, set to 1
-				if (i==n)
-					t2=1;
-
-				//binomial coefficient (fixed n=row, for each i)
-				pos[0] += float(k)*t1*t2*p[i].x;
-				pos[1] += float(k)*t1*t2*p[i].y;
-
-				//coefficient for next time
-				k*=(n-i);
-				k/=(i+1);
-
-				//t1&t2
-				t1*=t;
-				t2*=t2mod;
-			}
-			//done
+			return n;
 		}
-		void GetDir(float t, float *dir)
+		//positions and (unit) directions for all points along x
+		//(x loop innermost, for vectorization)
+		void Sample(const Basis *basis, Samples *samples)
 		{
-			dir[0]=0;
-			dir[1]=0;
-
-			//calculate (derivation of above)
-			int k=1;
-			//power-off for each term:
-			float t1=1.0; //t^i
-			float t2=1.0; //(1-t)^(n-1-i)
-			for (int i=0; i<=n-2; ++i)
-				t2*=(1.0-t);
-
-			//if t=1, then prevent NaN...
-			float t2mod = t==1.0? 1.0:1.0/(1.0-t);
-
-			//calculate
-			for (int i=0; i<=(n-1); ++i)
+			int points = basis->xres+1;
+
+			samples->pos_x.assign(points, 0.0);
+			samples->pos_y.assign(points, 0.0);
+			samples->dir_x.assign(points, 0.0);
+			samples->dir_y.assign(points, 0.0);
+
+			float *pos_x = &samples->pos_x[0];
+			float *pos_y = &samples->pos_y[0];
+			float *dir_x = &samples->dir_x[0];
+			float *dir_y = &samples->dir_y[0];
+			const float *w;
+			float px, py;
+			int i, x;
+
+			//position
+			for (i=0; i<=n; ++i)
 			{
-				//if at last, set to 1
-				if (i==n-1)
-					t2=1;
+				w = &basis->pos[i*points];
+				px = p[i].x;
+				py = p[i].y;
 
-				//binomial coefficient (fixed n=row, for each i)
-				dir[0] += float(k)*t1*t2*(p[i+1].x-p[i].x);
-				dir[1] += float(k)*t1*t2*(p[i+1].y-p[i].y);
+				for (x=0; x<points; ++x)
+				{
+					pos_x[x] += w[x]*px;
+					pos_y[x] += w[x]*py;
+				}
+			}
 
-				//coefficient for next time
-				k*=(n-1-i);
-				k/=(i+1);
+			//direction (derivative of above)
+			for (i=0; i<=(n-1); ++i)
+			{
+				w = &basis->dir[i*points];
+				px = p[i+1].x-p[i].x;
+				py = p[i+1].y-p[i].y;
 
-				//t1&t2
-				t1*=t;
-				t2*=t2mod;
+				for (x=0; x<points; ++x)
+				{
+					dir_x[x] += w[x]*px;
+					dir_y[x] += w[x]*py;
+				}
 			}
-			dir[0]*=n;
-			dir[1]*=n;
 
 			//normalize
-			float l = sqrt(dir[0]*dir[0]+dir[1]*dir[1]);
-
-			//specially crafted bezier curves (where p0=p1 and/or p(n-1)=pn)
-			//can not be derived correctly for t=0 and t=1. make safetycheck.
-			if (l == 0)
-			{
-				Log_Add(0, "WARNING: equal road section points exists, derivative not possible!");
-				dir[0]=1.0;
-				dir[1]=0.0;
-			}
-			else
+			float l;
+			for (x=0; x<points; ++x)
 			{
-				dir[0]/=l;
-				dir[1]/=l;
+				dir_x[x]*=n;
+				dir_y[x]*=n;
+
+				l = sqrt(dir_x[x]*dir_x[x]+dir_y[x]*dir_y[x]);
+
+				//specially crafted bezier curves (where p0=p1 and/or p(n-1)=pn)
+				//can not be derived correctly for t=0 and t=1. make safetycheck.
+				if (l == 0)
+				{
+					Log_Add(0, "WARNING: equal road section points exists, derivative not possible!");
+					dir_x[x]=1.0;
+					dir_y[x]=0.0;
+				}
+				else
+				{
+					dir_x[x]/=l;
+					dir_y[x]/=l;
+				}
 			}
 		}
-		static void RemoveAll()
+		static void RemoveAll(Bezier **head)
 		{
 			Bezier *next;
-			while (head)
+			while (*head)
 			{
-				next=head->next;
-				delete head;
-				head=next;
+				next=(*head)->next;
+				delete *head;
+				*head=next;
 			}
 		}
 
@@ -184,11 +255,8 @@ class Bezier
 		int n;
 
 		Bezier *next;
-		static Bezier *head;
 };
 
-Bezier *Bezier::head = NULL;
-
 //for storing all needed info about an end of a piece of road
 struct End
 {
@@ -204,24 +272,17 @@ struct End
 
 //adds vertices for one section along one block of road
 //performs transformation (morphing between different ends and rotation)
-void GenVertices(std::vector<Vector_Float> *vertices,
+void GenVertices(Vector_Float *vertices,
 		float *pos, float *rot, bool top, End *oldend, End *newend,
+		const Samples *oldshape, const Samples *newshape,
 		float angle, float t, int xres)
 {
 	//how much of the rotation should be done
 	angle*=t;
 
 	//variables
-	float dir[2];
 	float tmp1[2], tmp2[2], tmp[2], point[2]; //different points, merge together
 
-	//for looping through all positions along x
-	float dx=1.0/float(xres);
-	float x=0.0;
-
-	//for storing the generated data (before copying)
-	Vector_Float vertex;
-
 	float offset1, offset2;
 	if (top)
 	{
@@ -234,138 +295,127 @@ void GenVertices(std::vector<Vector_Float> *vertices,
 		offset2=-newend->offset;
 	}
 
+	//rotation is the same for all points
+	float rcos=cos(angle);
+	float rsin=sin(angle);
+
 	for (int i=0; i<=xres; ++i)
 	{
 		//first alternative of point
-		oldend->shape->GetPos(x, tmp1);
-		oldend->shape->GetDir(x, dir);
-		tmp1[0]-=dir[1]*offset1;
-		tmp1[1]+=dir[0]*offset1;
+		tmp1[0]=oldshape->pos_x[i]-oldshape->dir_y[i]*offset1;
+		tmp1[1]=oldshape->pos_y[i]+oldshape->dir_x[i]*offset1;
 
 		//second alternative
-		newend->shape->GetPos(x, tmp2);
-		newend->shape->GetDir(x, dir);
-		tmp2[0]-=dir[1]*offset2;
-		tmp2[1]+=dir[0]*offset2;
+		tmp2[0]=newshape->pos_x[i]-newshape->dir_y[i]*offset2;
+		tmp2[1]=newshape->pos_y[i]+newshape->dir_x[i]*offset2;
 
 		//transform between points (based on t)
 		tmp[0] = tmp1[0]*(1.0-t)+tmp2[0]*t;
 		tmp[1] = tmp1[1]*(1.0-t)+tmp2[1]*t;
 
 		//rotate between 0 and "angle" rotation
-		point[0] = +cos(angle)*tmp[0] +sin(angle)*tmp[1];
-		point[1] = -sin(angle)*tmp[0] +cos(angle)*tmp[1];
+		point[0] = +rcos*tmp[0] +rsin*tmp[1];
+		point[1] = -rsin*tmp[0] +rcos*tmp[1];
 
 		//apply to 3d space
-		vertex.x=pos[0]+rot[0]*point[0]+rot[2]*point[1];
-		vertex.y=pos[1]+rot[3]*point[0]+rot[5]*point[1];
-		vertex.z=pos[2]+rot[6]*point[0]+rot[8]*point[1];
-
-		//add
-		vertices->push_back(vertex);
-
-		x+=dx;
+		vertices[i].x=pos[0]+rot[0]*point[0]+rot[2]*point[1];
+		vertices[i].y=pos[1]+rot[3]*point[0]+rot[5]*point[1];
+		vertices[i].z=pos[2]+rot[6]*point[0]+rot[8]*point[1];
 	}
 }
 
-//for info output
-int triangle_count=0;
-
 //generates indices and normals for one surface of a block of road
-void GenNormalsAndIndices(std::vector<Triangle_Uint> *triangles,
-		std::vector<Vector_Float> *vertices, std::vector<Vector_Float> *normals,
+void GenNormalsAndIndices(Triangle_Uint *triangles,
+		const Vector_Float *vertices, Vector_Float *normals, int nstart,
 		int start, int xstride, int ystride,
 		int xres, int yres)
 {
 	//for each vertex, try to estimate a good normal (smooth reflections)
-	int nstart=normals->size();
 	int nstride=xres+1;
 	float A[3], B[3]; //A=X, B=Y  .... normal=AxB
-	Vector_Float A0, A1, B0, B1; //A=A1-A0, B=B1-B0
-	Vector_Float normal;
+	const Vector_Float *A0, *A1, *B0, *B1; //A=A1-A0, B=B1-B0
+	Vector_Float *normal = normals+nstart;
 	for (int y=0; y<=yres; ++y)
 		for (int x=0; x<=xres; ++x)
 		{
 			//check if at left or right end of surface
 			if (x==0)
 			{
-				A0=vertices->at(start+ystride*y);
-				A1=vertices->at(start+xstride+ystride*y);
+				A0=&vertices[start+ystride*y];
+				A1=&vertices[start+xstride+ystride*y];
 			}
 			else if (x==xres)
 			{
-				A0=vertices->at(start+xstride*(xres-1)+ystride*y);
-				A1=vertices->at(start+xstride*xres+ystride*y);
+				A0=&vertices[start+xstride*(xres-1)+ystride*y];
+				A1=&vertices[start+xstride*xres+ystride*y];
 			}
 			else //normal
 			{
-				A0=vertices->at(start+xstride*(x-1)+ystride*y);
-				A1=vertices->at(start+xstride*(x+1)+ystride*y);
+				A0=&vertices[start+xstride*(x-1)+ystride*y];
+				A1=&vertices[start+xstride*(x+1)+ystride*y];
 			}
 
 			//and for y (if at start or end)
 			if (y==0)
 			{
-				B0=vertices->at(start+xstride*x);
-				B1=vertices->at(start+xstride*x+ystride);
+				B0=&vertices[start+xstride*x];
+				B1=&vertices[start+xstride*x+ystride];
 			}
 			else if (y==yres)
 			{
-				B0=vertices->at(start+xstride*x+ystride*(yres-1));
-				B1=vertices->at(start+xstride*x+ystride*yres);
+				B0=&vertices[start+xstride*x+ystride*(yres-1)];
+				B1=&vertices[start+xstride*x+ystride*yres];
 			}
 			else //normal
 			{
-				B0=vertices->at(start+xstride*x+ystride*(y-1));
-				B1=vertices->at(start+xstride*x+ystride*(y+1));
+				B0=&vertices[start+xstride*x+ystride*(y-1)];
+				B1=&vertices[start+xstride*x+ystride*(y+1)];
 			}
 
 			//calculate A and B
-			A[0] = A1.x-A0.x;
-			A[1] = A1.y-A0.y;
-			A[2] = A1.z-A0.z;
-			B[0] = B1.x-B0.x;
-			B[1] = B1.y-B0.y;
-			B[2] = B1.z-B0.z;
+			A[0] = A1->x-A0->x;
+			A[1] = A1->y-A0->y;
+			A[2] = A1->z-A0->z;
+			B[0] = B1->x-B0->x;
+			B[1] = B1->y-B0->y;
+			B[2] = B1->z-B0->z;
 
 			//cross product gives normal
-			normal.x=A[1]*B[2]-A[2]*B[1];
-			normal.y=A[2]*B[0]-A[0]*B[2];
-			normal.z=A[0]*B[1]-A[1]*B[0];
+			normal->x=A[1]*B[2]-A[2]*B[1];
+			normal->y=A[2]*B[0]-A[0]*B[2];
+			normal->z=A[0]*B[1]-A[1]*B[0];
 
 			//store
-			normals->push_back(normal);
+			++normal;
 		}
 
-	Triangle_Uint triangle;
+	Triangle_Uint *triangle = triangles;
 
 	for (int y=0; y<yres; ++y)
 		for (int x=0; x<xres; ++x)
 		{
 			//two triangles per "square"
-			triangle.vertex[0]=start+xstride*(x+0)+ystride*(y+0);
-			triangle.vertex[1]=start+xstride*(x+1)+ystride*(y+0);
-			triangle.vertex[2]=start+xstride*(x+0)+ystride*(y+1);
-			triangle.normal[0]=nstart+(x+0)+nstride*(y+0);
-			triangle.normal[1]=nstart+(x+1)+nstride*(y+0);
-			triangle.normal[2]=nstart+(x+0)+nstride*(y+1);
-			triangle.texcoord[0]=0;
-			triangle.texcoord[1]=0;
-			triangle.texcoord[2]=0;
-			triangles->push_back(triangle);
-
-			triangle.vertex[0]=start+xstride*(x+1)+ystride*(y+0);
-			triangle.vertex[1]=start+xstride*(x+1)+ystride*(y+1);
-			triangle.vertex[2]=start+xstride*(x+0)+ystride*(y+1);
-			triangle.normal[0]=nstart+(x+1)+nstride*(y+0);
-			triangle.normal[1]=nstart+(x+1)+nstride*(y+1);
-			triangle.normal[2]=nstart+(x+0)+nstride*(y+1);
-			triangle.texcoord[0]=0;
-			triangle.texcoord[1]=0;
-			triangle.texcoord[2]=0;
-			triangles->push_back(triangle);
-
-			triangle_count+=2;
+			triangle->vertex[0]=start+xstride*(x+0)+ystride*(y+0);
+			triangle->vertex[1]=start+xstride*(x+1)+ystride*(y+0);
+			triangle->vertex[2]=start+xstride*(x+0)+ystride*(y+1);
+			triangle->normal[0]=nstart+(x+0)+nstride*(y+0);
+			triangle->normal[1]=nstart+(x+1)+nstride*(y+0);
+			triangle->normal[2]=nstart+(x+0)+nstride*(y+1);
+			triangle->texcoord[0]=0;
+			triangle->texcoord[1]=0;
+			triangle->texcoord[2]=0;
+			++triangle;
+
+			triangle->vertex[0]=start+xstride*(x+1)+ystride*(y+0);
+			triangle->vertex[1]=start+xstride*(x+1)+ystride*(y+1);
+			triangle->vertex[2]=start+xstride*(x+0)+ystride*(y+1);
+			triangle->normal[0]=nstart+(x+1)+nstride*(y+0);
+			triangle->normal[1]=nstart+(x+1)+nstride*(y+1);
+			triangle->normal[2]=nstart+(x+0)+nstride*(y+1);
+			triangle->texcoord[0]=0;
+			triangle->texcoord[1]=0;
+			triangle->texcoord[2]=0;
+			++triangle;
 		}
 }
 
@@ -415,6 +465,214 @@ void Position(float *pos, float *p0, float *p1, float *p2, float *p3, float t)
 	pos[2]=p0[2]*(1.0-t)*(1.0-t)*(1.0-t) +3.0*p1[2]*(1.0-t)*(1.0-t)*t +3.0*p2[2]*(1.0-t)*t*t +p3[2]*t*t*t;
 }
 
+//
+//all blocks are generated after reading the whole file, into already allocated
+//ranges (so can be done in parallel)
+//
+
+//one block of road (between two ends)
+struct Block
+{
+	End oldend, newend;
+	float p0[3], p1[3], p2[3], p3[3]; //bezier for position and rotation
+	int xres, yres;
+	bool cubic, dpt;
+	bool reuse; //first row of vertices already generated by last block
+	int start; //first vertex (including reused)
+	const Basis *oldbasis, *newbasis;
+};
+
+//one surface of a block (normals and triangles)
+struct Road_Surface
+{
+	size_t material, triangle; //first triangle in material
+	Triangle_Uint *triangles; //(set when allocated)
+	int normal; //first normal
+	int start, xstride, ystride, xres, yres;
+};
+
+//generate vertices for block
+void GenBlock(Block *block, Vector_Float *vertices)
+{
+	End *oldend=&block->oldend;
+	End *newend=&block->newend;
+	int xres=block->xres;
+	int yres=block->yres;
+	float *p0=block->p0, *p1=block->p1, *p2=block->p2, *p3=block->p3;
+
+	//variables used
+	float rot[9]={1.0,0.0,0.0, 0.0,1.0,0.0, 0.0,0.0,1.0};;
+	float pos[3]={0.0, 0.0, 0.0};;
+	float t;
+	float dy=1.0/float(yres);
+
+	//determine how rotation differs after twitching from first to second end
+	//(needs to be compensated when transforming between the two ends)
+	//simulate rotation from generation before actual rotation:
+	//copy first rotation:
+	memcpy(rot, oldend->rot, sizeof(float)*9);
+	t=0.0;
+	for (int i=0; i<=yres; ++i)
+	{
+		Rotation(rot, p0, p1, p2, p3, t);
+		t+=dy;
+	}
+	//angle of difference: v=arccos(Z*Z1)
+	float v;
+	//safetycheck in case outside range of acos
+	float dot=rot[2]*newend->rot[2] +rot[5]*newend->rot[5] +rot[8]*newend->rot[8];
+	if (dot > 1.0)
+		v=0.0;
+	else if (dot < -1.0)
+		v=M_PI;
+	else
+		v=acos(dot);
+
+	//direction of difference: Z*X1 > 0.0 -> v<0.0
+	if (rot[2]*newend->rot[0] +rot[5]*newend->rot[3] +rot[8]*newend->rot[6] > 0.0)
+		v=-v;
+
+	//shapes of both ends (the same for all rows)
+	Samples oldshape, newshape;
+	oldend->shape->Sample(block->oldbasis, &oldshape);
+	newend->shape->Sample(block->newbasis, &newshape);
+
+	//done, start real generation.
+	Vector_Float *vertex=vertices+block->start;
+	//copy original rotation again
+	memcpy(rot, oldend->rot, sizeof(float)*9);
+	//vertices
+	t=0.0;
+	int i=0;
+
+	//skip first "row" of vertices if reusing
+	if (block->reuse)
+	{
+		t+=dy;
+		i+=1;
+
+		if (block->dpt) //if depth (two rows to skip)
+			vertex+=2*(xres+1);
+		else //one row
+			vertex+=xres+1;
+	}
+
+	float s; //transformation
+	for (; i<=yres; ++i)
+	{
+		Rotation(rot, p0, p1, p2, p3, t);
+		Position(pos, p0, p1, p2, p3, t);
+
+		if (block->cubic) //use "cubic" transformation (=smooth)
+			s=(3*t*t-2*t*t*t);
+		else //use linear approach
+			s=t;
+
+		GenVertices(vertex, pos, rot, true, oldend, newend, &oldshape, &newshape, v, s, xres);
+		vertex+=xres+1;
+
+		//other side
+		if (block->dpt)
+		{
+			GenVertices(vertex, pos, rot, false, oldend, newend, &oldshape, &newshape, v, s, xres);
+			vertex+=xres+1;
+		}
+
+		t+=dy;
+	}
+}
+
+//work for each generation thread (every count:th block/surface, from id)
+struct Road_Work
+{
+	int id, count;
+	std::vector<Block> *blocks;
+	std::vector<Road_Surface> *surfaces;
+	Vector_Float *vertices, *normals;
+};
+
+int Road_Vertices_Thread(void *data)
+{
+	Road_Work *work = (Road_Work*)data;
+	size_t end = work->blocks->size();
+
+	for (size_t b=work->id; b<end; b+=work->count)
+		GenBlock(&(*work->blocks)[b], work->vertices);
+
+	return 0;
+}
+
+int Road_Normals_Thread(void *data)
+{
+	Road_Work *work = (Road_Work*)data;
+	size_t end = work->surfaces->size();
+	Road_Surface *s;
+
+	for (size_t i=work->id; i<end; i+=work->count)
+	{
+		s = &(*work->surfaces)[i];
+		GenNormalsAndIndices(s->triangles, work->vertices, work->normals, s->normal,
+				s->start, s->xstride, s->ystride, s->xres, s->yres);
+	}
+
+	return 0;
+}
+
+//run on several threads (including this one) and wait for all
+void Road_Run(int (*function)(void*), const Road_Work *work, int threads)
+{
+	std::vector<Road_Work> works(threads, *work);
+	std::vector<SDL_Thread*> created(threads, (SDL_Thread*)NULL);
+
+	for (int i=0; i<threads; ++i)
+	{
+		works[i].id = i;
+		works[i].count = threads;
+	}
+
+	for (int i=1; i<threads; ++i)
+		created[i] = SDL_CreateThread(function, &works[i]);
+
+	function(&works[0]);
+
+	for (int i=1; i<threads; ++i)
+	{
+		if (created[i])
+			SDL_WaitThread(created[i], NULL);
+		else //failed to create, do it here instead
+			function(&works[i]);
+	}
+}
+
+//add surface to generate, and count needed normals and triangles
+void AddSurface(std::vector<Road_Surface> *surfaces, std::vector<size_t> *material_triangles,
+		int *normal_count, size_t material,
+		int start, int xstride, int ystride,
+		int xres, int yres)
+{
+	if (material_triangles->size() <= material)
+		material_triangles->resize(material+1, 0);
+
+	Road_Surface surface = {material, (*material_triangles)[material], NULL, *normal_count,
+				start, xstride, ystride, xres, yres};
+	surfaces->push_back(surface);
+
+	(*material_triangles)[material] += 2*xres*yres;
+	*normal_count += (xres+1)*(yres+1);
+}
+
+//find (or create) basis for degree and resolution
+const Basis *FindBasis(std::vector<Basis*> *bases, int degree, int xres)
+{
+	for (size_t i=0; i<bases->size(); ++i)
+		if ((*bases)[i]->n == degree && (*bases)[i]->xres == xres)
+			return (*bases)[i];
+
+	Basis *basis = new Basis(degree, xres);
+	bases->push_back(basis);
+	return basis;
+}
+
 bool Model::Load_Road(const char *f)
 {
 	Log_Add(2, "Loading model from ROAD file %s", f);
@@ -439,10 +697,17 @@ bool Model::Load_Road(const char *f)
 	float rotation[9] = {1.0,0.0,0.0, 0.0,1.0,0.0, 0.0,0.0,1.0};
 	float stiffness[2] = {5,5};
 	Bezier *section = NULL; //shape of road
+	Bezier *sections = NULL; //all shapes (local, several roads might load at once)
 	End oldend={false}, newend={false}; //keep track of both ends of the piece of road
 
+	//blocks and surfaces to generate (when done reading)
+	std::vector<Basis*> bases;
+	std::vector<Block> blocks;
+	std::vector<Road_Surface> surfaces;
+	std::vector<size_t> material_triangles; //how many triangles per material
+	int vertex_count=0, normal_count=0;
+
 	//misc:
-	triangle_count=0; //for info output
 	int last_xres=0; //to prevent getting fooled (guaranteed to be accurate)
 	bool last_dpt=false; //the same, set correctly after each road block
 	std::string matpath; //for material file path
@@ -450,7 +715,7 @@ bool Model::Load_Road(const char *f)
 	while  (file.Read_Line())
 	{
 		if (!strcmp(file.words[0], "section") && file.word_count >= 4 && !(file.word_count&1))
-			new Bezier(&file);
+			new Bezier(&file, &sections);
 		else if (!strcmp(file.words[0], "add") && file.word_count == 4)
 		{
 			//check to see if something is wrong (no shape selected)
@@ -494,13 +759,17 @@ bool Model::Load_Road(const char *f)
 				material=&materials[0];
 			}
 
-			//variables used
-			float rot[9]={1.0,0.0,0.0, 0.0,1.0,0.0, 0.0,0.0,1.0};;
-			float pos[3]={0.0, 0.0, 0.0};;
-			float t;
-			float dy=1.0/float(yres);
+			Block block;
+			block.oldend=oldend;
+			block.newend=newend;
+			block.xres=xres;
+			block.yres=yres;
+			block.cubic=cubic;
+			block.dpt=dpt;
+			block.oldbasis=FindBasis(&bases, oldend.shape->Degree(), xres);
+			block.newbasis=FindBasis(&bases, newend.shape->Degree(), xres);
 
-			float p0[3], p1[3], p2[3], p3[3];
+			float *p0=block.p0, *p1=block.p1, *p2=block.p2, *p3=block.p3;
 
 			memcpy(p0, oldend.pos, sizeof(float)*3);
 			memcpy(p3, newend.pos, sizeof(float)*3);
@@ -513,95 +782,42 @@ bool Model::Load_Road(const char *f)
 			p2[1]=p3[1]-newend.rot[4]*stiffness[1];
 			p2[2]=p3[2]-newend.rot[7]*stiffness[1];
 
-			//determine how rotation differs after twitching from first to second end
-			//(needs to be compensated when transforming between the two ends)
-			//simulate rotation from generation before actual rotation:
-			//copy first rotation:
-			memcpy(rot, oldend.rot, sizeof(float)*9);
-			t=0.0;
-			for (int i=0; i<=yres; ++i)
-			{
-				Rotation(rot, p0, p1, p2, p3, t);
-				t+=dy;
-			}
-			//angle of difference: v=arccos(Z*Z1)
-			float v;
-			//safetycheck in case outside range of acos
-			float dot=rot[2]*newend.rot[2] +rot[5]*newend.rot[5] +rot[8]*newend.rot[8];
-			if (dot > 1.0)
-				v=0.0;
-			else if (dot < -1.0)
-				v=M_PI;
-			else
-				v=acos(dot);
-
-			//direction of difference: Z*X1 > 0.0 -> v<0.0
-			if (rot[2]*newend.rot[0] +rot[5]*newend.rot[3] +rot[8]*newend.rot[6] > 0.0)
-				v=-v;
-
-			//done, start real generation.
-			int start=vertices.size(); //store current position (before adding more data)
-			//copy original rotation again
-			memcpy(rot, oldend.rot, sizeof(float)*9);
-			//vertices
-			t=0.0;
-			int i=0;
+			int start=vertex_count; //store current position (before adding more data)
+			int rows=yres+1;
+			int row_size=dpt? 2*(xres+1): xres+1;
 
 			//check if we can reuse the old vertices (everything matches)... :-)
-			if (last_xres==xres && last_dpt==dpt)
+			block.reuse = (last_xres==xres && last_dpt==dpt);
+			if (block.reuse)
 			{
-				t+=dy; //skip first "row" of vertices
-				i+=1; //skip for for looping variable too
-
-				//go back a bit
-				if (dpt) //if depth (two rows to skip)
-					start-=2*(xres+1);
-				else //one row
-					start-=xres+1;
+				start-=row_size; //go back a bit
+				rows-=1;
 			}
 
-			for (; i<=yres; ++i)
-			{
-				Rotation(rot, p0, p1, p2, p3, t);
-				Position(pos, p0, p1, p2, p3, t);
-
-				if (cubic) //use "cubic" transformation (=smooth)
-				{
-					GenVertices(&vertices, pos, rot, true, &oldend, &newend, v, (3*t*t-2*t*t*t), xres);
-
-					//other side
-					if (dpt)
-						GenVertices(&vertices, pos, rot, false, &oldend, &newend, v, (3*t*t-2*t*t*t), xres);
-				}
-				else //use linear approach
-				{
-					GenVertices(&vertices, pos, rot, true, &oldend, &newend, v, t, xres);
-					if (dpt)
-						GenVertices(&vertices, pos, rot, false, &oldend, &newend, v, t, xres);
-				}
-
-				t+=dy;
-			}
+			block.start=start;
+			blocks.push_back(block);
+			vertex_count+=rows*row_size;
 
 			//indices
+			size_t m = material-&materials[0];
 			if (dpt)
 			{
 				//top
-				GenNormalsAndIndices(&material->triangles, &vertices, &normals, start, 1, 2*(xres+1), xres, yres);
+				AddSurface(&surfaces, &material_triangles, &normal_count, m, start, 1, 2*(xres+1), xres, yres);
 
 				//bottom
-				GenNormalsAndIndices(&material->triangles, &vertices, &normals, start+2*xres+1, -1, 2*(xres+1), xres, yres);
+				AddSurface(&surfaces, &material_triangles, &normal_count, m, start+2*xres+1, -1, 2*(xres+1), xres, yres);
 
 				//sides
-				GenNormalsAndIndices(&material->triangles, &vertices, &normals, start+xres, xres+1, 2*(xres+1), 1, yres);
-				GenNormalsAndIndices(&material->triangles, &vertices, &normals, start+xres+1, -(xres+1), 2*(xres+1), 1, yres);
+				AddSurface(&surfaces, &material_triangles, &normal_count, m, start+xres, xres+1, 2*(xres+1), 1, yres);
+				AddSurface(&surfaces, &material_triangles, &normal_count, m, start+xres+1, -(xres+1), 2*(xres+1), 1, yres);
 
 				//capping of this end (first, got depth and conf wants)?
 				if (cap&&oldend.offset&&capping)
-					GenNormalsAndIndices(&material->triangles, &vertices, &normals, start+xres+1, 1, -(xres+1), xres, 1);
+					AddSurface(&surfaces, &material_triangles, &normal_count, m, start+xres+1, 1, -(xres+1), xres, 1);
 			}
 			else //only top
-				GenNormalsAndIndices(&material->triangles, &vertices, &normals, start, 1, xres+1, xres, yres);
+				AddSurface(&surfaces, &material_triangles, &normal_count, m, start, 1, xres+1, xres, yres);
 
 			//keep track of what settings were used
 			last_xres = xres;
@@ -609,7 +825,7 @@ bool Model::Load_Road(const char *f)
 		}
 		else if (!strcmp(file.words[0], "select") && file.word_count == 2)
 		{
-			Bezier *tmp=Bezier::Find(file.words[1]);
+			Bezier *tmp=Bezier::Find(sections, file.words[1]);
 			if (tmp)
 				section=tmp;
 			else
@@ -686,10 +902,46 @@ bool Model::Load_Road(const char *f)
 
 	//at end, should cap?
 	if (oldend.active && newend.active && newend.offset && capping)
-		GenNormalsAndIndices(&material->triangles, &vertices, &normals, vertices.size()-2*(last_xres+1), 1, last_xres+1, last_xres, 1);
+		AddSurface(&surfaces, &material_triangles, &normal_count, material-&materials[0],
+				vertex_count-2*(last_xres+1), 1, last_xres+1, last_xres, 1);
+
+	//
+	//generate everything
+	//
+	vertices.resize(vertex_count);
+	normals.resize(normal_count);
+
+	size_t triangle_count=0; //for info output
+	std::vector<size_t> material_start(material_triangles.size());
+	for (size_t m=0; m<material_triangles.size(); ++m)
+	{
+		material_start[m] = materials[m].triangles.size();
+		materials[m].triangles.resize(material_start[m]+material_triangles[m]);
+		triangle_count += material_triangles[m];
+	}
+
+	for (size_t i=0; i<surfaces.size(); ++i)
+		surfaces[i].triangles = &materials[surfaces[i].material].triangles[material_start[surfaces[i].material]+surfaces[i].triangle];
+
+	//(only use several threads if enough to do)
+	int threads=1;
+	if (vertex_count > ROAD_THREAD_VERTICES)
+		threads = Loader_Thread_Count();
+
+	Road_Work work = {0, 1, &blocks, &surfaces, NULL, NULL};
+	if (vertex_count)
+		work.vertices=&vertices[0];
+	if (normal_count)
+		work.normals=&normals[0];
+
+	//all vertices first, since surfaces use vertices of neighbouring blocks
+	Road_Run(Road_Vertices_Thread, &work, threads);
+	Road_Run(Road_Normals_Thread, &work, threads);
 
 	//done, remove all data:
-	Bezier::RemoveAll();
+	Bezier::RemoveAll(&sections);
+	for (size_t i=0; i<bases.size(); ++i)
+		delete bases[i];
 
 	//check that at least something got loaded:
 	if (materials.empty() || vertices.empty())
@@ -705,7 +957,46 @@ bool Model::Load_Road(const char *f)
 	Vector2_Float tmpuv={0,0};
 	texcoords.push_back(tmpuv);
 
-	Log_Add(2, "ROAD generation info: %u triangles, %u materials", triangle_count, materials.size());
+	Log_Add(2, "ROAD generation info: %u triangles, %u materials, %i threads", triangle_count, materials.size(), threads);
+
+	return true;
+}
+
+//
+//benchmark (--check): generates a long road (superbowl.road, but 100x400 per
+//block) and compares the result with the checksum of what the original (not
+//precomputed or threaded) generator made for the same file
+//
+#define ROAD_CHECK_FILE "checks/long_road.road"
+#define ROAD_CHECK_CHECKSUM 0xf41d5141
+
+bool Model::Check_Road()
+{
+	Log_Add(1, "Checking road generation with \"%s\"", ROAD_CHECK_FILE);
+
+	Model model;
+	if (!model.Load(ROAD_CHECK_FILE))
+		return false;
+
+	Uint64 start = Clock_Get();
+	if (!model.Parse())
+		return false;
+	double time = (Clock_Get()-start)/1000000.0;
+
+	Uint32 checksum = model.Checksum();
+
+	Log_Add(1, "Generated %u vertices in %fms (%i threads)",
+			(unsigned int)model.vertices.size(), time, Loader_Thread_Count());
+
+	//(might also differ if floating point math is done differently, like by
+	//x87 instead of sse)
+	if (checksum != ROAD_CHECK_CHECKSUM)
+	{
+		Log_Add(-1, "Road check failed: checksum %08x, original generator gave %08x",
+				checksum, ROAD_CHECK_CHECKSUM);
+		return false;
+	}
 
+	Log_Add(1, "Road check passed (checksum %08x)", checksum);
 	return true;
 }
@@ -21,28 +21,34 @@
 
 #include "text_file.hpp"
 #include "common/log.hpp"
+#include "common/directories.hpp"
 
 #include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
+#include <stdlib.h>
 
 //NOTE: it might seem strange to use C text processing in C++ code,
 //but it is simply more suitable in this case
 
+//same as isspace in "C" locale (space, \t, \n, \v, \f or \r)
+static inline bool Text_File_Space(char c)
+{
+	return (c == ' ' || (c >= '\t' && c <= '\r'));
+}
+
 Text_File::Text_File ()
 {
-	fp = NULL; //default until attempting opening
+	open = false; //default until attempting opening
 	word_count = 0; //no words read yet
 
-	//allocate buffer anyway (even if not open), if reopening
-	buffer_size = INITIAL_TEXT_FILE_BUFFER_SIZE;
+	buffer = NULL; //allocated when opening
+	buffer_size = 0;
+	pos = end = NULL;
+
 	list_size = INITIAL_TEXT_FILE_LIST_SIZE;
-	buffer = new char[buffer_size];
 	words = new char*[list_size];
 }
 
-#include <unistd.h>
 Text_File::~Text_File ()
 {
 	Close();
@@ -56,198 +62,152 @@ bool Text_File::Open (const char *file)
 	//close old
 	Close();
 
-	//open
-#ifndef _WIN32
-	//proper version
-	fp = fopen(file, "r");
-#else
-	//windows always expects carriage return before newline
-	//(since we are processing unix-based text files, go binary)
-	fp = fopen(file, "rb");
-#endif
-
-	//check success
-	if (fp)
-	{
-		return true;
-	}
-	else
+	//open (binary, \r is just treated as space anyway)
+	FILE *fp = fopen(file, "rb");
+
+	if (!fp)
 	{
 		Log_Add(-1, "Text_File could not open file %s!", file);
 		return false;
 	}
-}
 
-void Text_File::Close()
-{
-	//make sure no old data is left
-	if (fp)
+	//read everything at once (with room for an extra \0 at end)
+	size_t size = 0;
+	while (true)
 	{
-		fclose (fp);
-		Clear_List();
+		if (size+1 >= buffer_size)
+		{
+			//double (or at least 4kiB)
+			size_t new_size = buffer_size? buffer_size*2: 4096;
+			char *new_buffer = new char[new_size];
+
+			memcpy(new_buffer, buffer, size);
+			delete[] buffer;
+			buffer = new_buffer;
+			buffer_size = new_size;
+		}
+
+		size_t read = fread(buffer+size, 1, buffer_size-size-1, fp);
+		size += read;
+
+		if (read == 0)
+			break;
 	}
-}
 
-bool Text_File::Read_Line ()
-{
-	//first check if we got an open file...
-	if (!fp)
+	if (ferror(fp))
 	{
-		Log_Add(0, "WARNING: Text_File tried reading without an open file!");
+		Log_Add(-1, "Text_File could not read file %s!", file);
+		fclose(fp);
 		return false;
 	}
 
-	//remove the old words
-	Clear_List();
+	fclose(fp);
 
-	//the following actions goes false if end of file
-	if (!Seek_First())
-		return false;
-	if (!Line_To_Buffer())
-		return false;
-	if (!Buffer_To_List())
-		return false;
+	buffer[size] = '\0';
+	pos = buffer;
+	end = buffer+size;
+	open = true;
 
-	//ok
 	return true;
 }
 
-bool Text_File::Seek_First()
+void Text_File::Close()
 {
-	char c;
-	while (true)
-	{
-		c = fgetc(fp);
-		if (c == EOF)
-			return false;
-
-		else if (!isspace(c)) //not space
-		{
-			if (c == '#') //commented line, get next
-			{
-				Throw_Line();
-				return Seek_First();
-			}
-
-			//else, we now have first word
-			//(push back first char)
-			ungetc (c, fp);
-			return true;
-		}
-	}
+	//make sure no old data is left
+	open = false;
+	word_count = 0;
 }
 
-bool Text_File::Line_To_Buffer()
+//words are split by space (and lines by newline), except when "quoted". And
+//lines/rest of lines beginning with # are comments
+bool Text_File::Read_Line ()
 {
-	//make sure to reallocate buffer if too small
-	int text_read=0; //no text already read
-
-	while (true)
+	//first check if we got an open file...
+	if (!open)
 	{
-		//this should always work, but just to be safe
-		if (!(fgets( (&buffer[text_read]) , (buffer_size-text_read) , fp)))
-			return false;
-
-		text_read = strlen(buffer);
-
-		//if EOF or read a newline, everything ok
-		if (feof(fp) || buffer[text_read-1] == '\n')
-			return true;
-		
-		//else: I guess the buffer was too small...
-		Log_Add(2, "Text_File line buffer was too small, resizing");
-		buffer_size += INITIAL_TEXT_FILE_BUFFER_SIZE;
-
-		//copy old vyffer content
-		char *oldbuffer=buffer;
-		buffer = new char[buffer_size];
-		strcpy(buffer, oldbuffer);
-		delete[] oldbuffer;
+		Log_Add(0, "WARNING: Text_File tried reading without an open file!");
+		return false;
 	}
-}
 
-bool Text_File::Buffer_To_List()
-{
-	char *buffer_ptr = buffer; //position buffer pointer to start of buffer
+	//remove the old words
+	word_count = 0;
 
-	while (true)
+	while (pos < end)
 	{
-		//seek for char not space (if not end of buffer)
-		while (*buffer_ptr != '\0' && isspace(*buffer_ptr))
-			++buffer_ptr;
-
-		//reached end (end of buffer, comment or newline)
-		if (*buffer_ptr == '\0' || *buffer_ptr == '#' || *buffer_ptr == '\n')
-			break;
-
-		//
-		//ok got start of new word
-		//
-
-		//there are two kinds of "words"
-		if (*buffer_ptr == '\"') //quotation: "word" begins after " and ends at " (or \0)
+		if (*pos == '\n') //end of line, done if got any words
+		{
+			++pos;
+			if (word_count)
+				return true;
+		}
+		else if (Text_File_Space(*pos))
+			++pos;
+		else if (*pos == '#') //comment, throw rest of line
+		{
+			pos = (char*)memchr(pos, '\n', end-pos);
+			if (!pos)
+				pos = end;
+		}
+		else if (*pos == '\"') //quotation: "word" begins after " and ends at "
 		{
 			//go one step more (don't want " in word)
-			++buffer_ptr;
+			++pos;
 
 			//wery unusual error (line ends after quotation mark)
-			if (*buffer_ptr == '\0')
+			if (pos == end || *pos == '\n')
 			{
 				Log_Add(0, "WARNING: Text_File line ended just after quotation mark (ignored)...");
-				break;
+				continue;
 			}
 
 			//ok
-			Append_To_List(buffer_ptr);
+			Append_To_List(pos);
 
 			//find next " or end of line
-			while (*buffer_ptr!='\"' && *buffer_ptr!='\0')
-				++buffer_ptr;
+			while (pos < end && *pos != '\"' && *pos != '\n')
+				++pos;
 
-			if (*buffer_ptr=='\0') //end of line before end of quote
+			//end of line before end of quote
+			if (pos == end)
+				Log_Add(0, "WARNING: Text_File reached end of line before end of quote (ignored)...");
+			else if (*pos == '\n')
+			{
 				Log_Add(0, "WARNING: Text_File reached end of line before end of quote (ignored)...");
+				*pos = '\0'; //end of word (and line)
+				++pos;
+				return true;
+			}
 			else
 			{
-				*buffer_ptr = '\0'; //make this end (instead of ")
-				++buffer_ptr; //jump over this "local" end
+				*pos = '\0'; //make this end (instead of ")
+				++pos; //jump over this "local" end
 			}
 		}
-		else //normal: word begins after space and ends at space (or \0)
+		else //normal: word begins after space and ends at space (or end of file)
 		{
-			Append_To_List(buffer_ptr);
+			Append_To_List(pos);
 
-			//look for end of word (space or end of buffer)
-			++buffer_ptr;
-			while (*buffer_ptr != '\0' && !isspace(*buffer_ptr))
-				++buffer_ptr;
+			//look for end of word
+			++pos;
+			while (pos < end && !Text_File_Space(*pos))
+				++pos;
 
-			//if word ended by end of buffer, do nothing. else
-			if (*buffer_ptr != '\0')
+			//if word ended by end of file, already terminated. else
+			if (pos < end)
 			{
-				*buffer_ptr = '\0'; //mark as end of word
-				++buffer_ptr; //jump over local end
+				bool newline = (*pos == '\n');
+
+				*pos = '\0'; //mark as end of word
+				++pos; //jump over local end
+
+				if (newline)
+					return true;
 			}
 		}
 	}
 
-	//in case no words were read from buffer
-	if (word_count==0)
-		return false;
-	
-	return true;
-}
-
-bool Text_File::Throw_Line ()
-{
-	char c;
-	while (true)
-	{
-		c = fgetc(fp);
-		if (c == EOF)
-			return false;
-		else if (c == '\n')
-			return true;
-	}
+	//end of file, might still have got last line
+	return (word_count != 0);
 }
 
 void Text_File::Append_To_List(char *word)
@@ -261,20 +221,89 @@ void Text_File::Append_To_List(char *word)
 
 		char **oldwords=words;
 		words = new char*[list_size];
-		memcpy(words, oldwords, word_count*sizeof(char*));
+		memcpy(words, oldwords, (word_count-1)*sizeof(char*));
 		delete[] oldwords;
 	}
 
 	words[word_count-1] = word; //point to word in buffer
 }
 
-void Text_File::Clear_List()
+//check file, and words expected from it: for each line with words, a line
+//with the number of words and then one line for each word. Generated by the
+//old (line buffered) reader, except for unterminated quotes: they now end
+//at the newline (not included), and a quote just before newline is ignored
+#define TEXT_FILE_CHECK_FILE "checks/words.txt"
+#define TEXT_FILE_CHECK_EXPECTED "checks/words.expected"
+
+//read next line of expected, without the newline
+static bool Text_File_Check_Line(FILE *fp, char *line, size_t size)
 {
-	//this isn't necessary (since word count is set to 0)
-	for (int i=0; i<word_count; ++i)
-		words[i]=NULL;
-	//
+	if (!fgets(line, size, fp))
+		return false;
 
-	word_count = 0;
+	size_t length = strlen(line);
+	if (length && line[length-1] == '\n')
+		line[length-1] = '\0';
+
+	return true;
 }
 
+bool Text_File::Check()
+{
+	Log_Add(1, "Checking Text_File with \"%s\"", TEXT_FILE_CHECK_FILE);
+
+	Directories dirs;
+	Text_File file;
+	if (!dirs.Find(TEXT_FILE_CHECK_FILE, DATA, READ) || !file.Open(dirs.Path()))
+	{
+		Log_Add(-1, "Unable to open \"%s\"", TEXT_FILE_CHECK_FILE);
+		return false;
+	}
+
+	FILE *fp = NULL;
+	if (!dirs.Find(TEXT_FILE_CHECK_EXPECTED, DATA, READ) || !(fp = fopen(dirs.Path(), "rb")))
+	{
+		Log_Add(-1, "Unable to open \"%s\"", TEXT_FILE_CHECK_EXPECTED);
+		return false;
+	}
+
+	char line[256];
+	unsigned int lines = 0, words = 0;
+	bool ok = true;
+	while (ok && file.Read_Line())
+	{
+		++lines;
+		if (!Text_File_Check_Line(fp, line, sizeof(line)) || atoi(line) != file.word_count)
+		{
+			Log_Add(-1, "Text_File check: line %u got %i words, expected %s",
+					lines, file.word_count, line);
+			ok = false;
+			break;
+		}
+
+		for (int i=0; i<file.word_count; ++i, ++words)
+		{
+			if (!Text_File_Check_Line(fp, line, sizeof(line)) || strcmp(line, file.words[i]))
+			{
+				Log_Add(-1, "Text_File check: line %u word %i is \"%s\", expected \"%s\"",
+						lines, i+1, file.words[i], line);
+				ok = false;
+				break;
+			}
+		}
+	}
+
+	//should have used all expected lines
+	if (ok && Text_File_Check_Line(fp, line, sizeof(line)))
+	{
+		Log_Add(-1, "Text_File check: only got %u lines, more expected", lines);
+		ok = false;
+	}
+
+	fclose(fp);
+
+	if (ok)
+		Log_Add(1, "Text_File check passed (%u lines, %u words)", lines, words);
+
+	return ok;
+}
@@ -23,10 +23,9 @@
 #define _ReCaged_TEXT_FILE_H
 //definition of class for easy text file processing
 //(provides a list of words for each line)
-#include <stdio.h>
+#include <stddef.h>
 
 //initial values for holding data (automatically resized if needed)
-#define INITIAL_TEXT_FILE_BUFFER_SIZE 150 //how manny characters
 #define INITIAL_TEXT_FILE_LIST_SIZE 8 //how many words
 
 class Text_File
@@ -47,32 +46,24 @@ class Text_File
 		//(useful if wanting to reuse object)
 		bool Open(const char *file);
 
-	private:
-		//std::ifstream stream;
-		FILE *fp;
+		//compare words read from check file with expected (--check)
+		static bool Check();
 
-		//manualy allocate/free buffer to allow reallocating
+	private:
+		//whole file is read at once, words are pointing directly into it
+		//(terminated in place, no copying)
 		char *buffer;
 		size_t buffer_size;
+		char *pos, *end; //next line, end of file
+		bool open;
 
 		//how many words can be stored in "words"
 		int list_size;
 
-		//throws text until newline
-		bool Throw_Line();
-		//find first word (that isn't commented)
-		bool Seek_First();
-		//copy the line to buffer
-		bool Line_To_Buffer();
-		//split buffer to list of words
-		bool Buffer_To_List();
-
-		//copy word to list
+		//add word to list
 		void Append_To_List(char * word);
-		//clear the word list
-		void Clear_List();
 
-		//function for closing fp and freeing word list
+		//function for closing file and clearing word list
 		void Close();
 };
 #endif
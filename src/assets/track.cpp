@@ -20,13 +20,16 @@
  */ 
 
 #include <stdlib.h>
+#include <algorithm>
 
 #include "track.hpp"
 #include "text_file.hpp"
 #include "object.hpp"
+#include "loader.hpp"
 
 #include "common/internal.hpp"
 #include "common/log.hpp"
+#include "common/clock.hpp"
 #include "common/directories.hpp"
 #include "common/threads.hpp"
 
@@ -77,6 +80,108 @@ void RemoveMeshes()
 		delete models[i];
 	models.clear();
 }
+
+//first pass over geom list: find all models and apply modifications, and let
+//loader process them (in parallel) as soon as used by a geom
+bool PrepareMeshes(const char *path, const char *glist)
+{
+	Directories dirs;
+	Text_File file;
+
+	//(missing list reported when creating geoms)
+	if (!(dirs.Find(glist, DATA, READ) && file.Open(dirs.Path())))
+		return true;
+
+	std::vector<Model*> prepared;
+	Model *mesh;
+	bool ok = true;
+
+	while (ok && file.Read_Line())
+	{
+		//model manipulation
+		if (!strcmp(file.words[0], ">") && file.word_count >= 3 && !strcmp(file.words[1], "modify"))
+		{
+			Log_Add(2, "overriding model properties");
+
+			if (!(mesh = FindOrLoadMesh(path, file.words[2])))
+			{
+				ok = false;
+				break;
+			}
+
+			//can't change while processing (it's too late anyway)
+			if (std::find(prepared.begin(), prepared.end(), mesh) != prepared.end())
+			{
+				Log_Add(0, "WARNING: model \"%s\" already used by geom, can not modify", file.words[2]);
+				continue;
+			}
+
+			//now process the rest for extra options
+			int pos = 3;
+			while (pos < file.word_count)
+			{
+				int left=file.word_count-pos;
+
+				//resize, takes the word resize and one value
+				if (!strcmp(file.words[pos], "resize") && left >= 2)
+				{
+					mesh->Resize(atof(file.words[pos+1]));
+					pos+=2;
+				}
+				//rotate, takes the word rotate and 3 values
+				else if (!strcmp(file.words[pos], "rotate") && left >= 4)
+				{
+					mesh->Rotate(atof(file.words[pos+1]), //x
+							atof(file.words[pos+2]), //y
+							atof(file.words[pos+3])); //z
+					pos+=4;
+				}
+				//offset, takes the word offset and 3 values
+				else if (!strcmp(file.words[pos], "offset") && left >= 4)
+				{
+					mesh->Offset(atof(file.words[pos+1]), //x
+							atof(file.words[pos+2]), //y
+							atof(file.words[pos+3])); //z
+					pos+=4;
+				}
+				//compact (rendering) vertices, takes just the word compact
+				else if (!strcmp(file.words[pos], "compact"))
+				{
+					mesh->Compact();
+					pos+=1;
+				}
+				else
+				{
+					Log_Add(0, "WARNING: models loading option \"%s\" not known", file.words[pos]);
+					++pos;
+				}
+			}
+		}
+		//geom to create, models needed
+		else if (strcmp(file.words[0], ">") && (file.word_count == 8 || file.word_count == 7))
+		{
+			for (int i=6; i<file.word_count; ++i)
+			{
+				if (!(mesh = FindOrLoadMesh(path, file.words[i])))
+				{
+					ok = false;
+					break;
+				}
+
+				if (std::find(prepared.begin(), prepared.end(), mesh) == prepared.end())
+				{
+					prepared.push_back(mesh);
+					Loader_Add_Model(mesh);
+				}
+			}
+		}
+	}
+
+	//wait for everything (even if failed, models are still being processed)
+	Loader_Wait();
+
+	return ok;
+}
 //
 //
 
@@ -84,6 +189,7 @@ void RemoveMeshes()
 bool load_track (const char *path)
 {
 	Log_Add(1, "Loading track: %s", path);
+	Uint64 start = Clock_Get();
 	Directories dirs;
 
 	//
@@ -107,16 +213,20 @@ bool load_track (const char *path)
 
 	}
 	//all data loaded, start building
-	//background (for now)
-	glClearColor (track.background[0],track.background[1],track.background[2],track.background[3]);
-	//fog
-	glFogfv(GL_FOG_COLOR, track.fog_colour);
-	
-	//sun position and colour
-	glLightfv (GL_LIGHT0, GL_AMBIENT, track.ambient);
-	glLightfv (GL_LIGHT0, GL_DIFFUSE, track.diffuse);
-	glLightfv (GL_LIGHT0, GL_SPECULAR, track.specular);
-	glLightfv (GL_LIGHT0, GL_POSITION, track.position);
+	//(no opengl context when headless)
+	if (!headless)
+	{
+		//background (for now)
+		glClearColor (track.background[0],track.background[1],track.background[2],track.background[3]);
+		//fog
+		glFogfv(GL_FOG_COLOR, track.fog_colour);
+
+		//sun position and colour
+		glLightfv (GL_LIGHT0, GL_AMBIENT, track.ambient);
+		glLightfv (GL_LIGHT0, GL_DIFFUSE, track.diffuse);
+		glLightfv (GL_LIGHT0, GL_SPECULAR, track.specular);
+		glLightfv (GL_LIGHT0, GL_POSITION, track.position);
+	}
 
 	//set track specific global ode params:
 	dWorldSetGravity (simulation_thread.world, track.gravity[0], track.gravity[1], track.gravity[2]);
@@ -133,6 +243,14 @@ bool load_track (const char *path)
 	strcpy (glist,path);
 	strcat (glist,"/geoms.lst");
 
+	//load and process all models first
+	if (!PrepareMeshes(path, glist))
+	{
+		RemoveMeshes();
+		delete track.object;
+		return false;
+	}
+
 	Log_Add(2, "Loading track geom list: %s", glist);
 	Text_File file;
 
@@ -148,55 +266,9 @@ bool load_track (const char *path)
 			//if requesting optional stuff
 			if (!strcmp(file.words[0], ">") && file.word_count >= 2)
 			{
-				//model manipulation
+				//model manipulation (already done when preparing)
 				if (!strcmp(file.words[1], "modify"))
-				{
-					Log_Add(2, "overriding model properties");
-
-					Model *mesh = FindOrLoadMesh(path, file.words[2]);
-
-					if (!mesh)
-					{
-						RemoveMeshes();
-						delete track.object;
-						return false;
-					}
-
-					//now process the rest for extra options
-					int pos = 3;
-					while (pos < file.word_count)
-					{
-						int left=file.word_count-pos;
-
-						//resize, takes the word resize and one value
-						if (!strcmp(file.words[pos], "resize") && left >= 2)
-						{
-							mesh->Resize(atof(file.words[pos+1]));
-							pos+=2;
-						}
-						//rotate, takes the word rotate and 3 values
-						else if (!strcmp(file.words[pos], "rotate") && left >= 4)
-						{
-							mesh->Rotate(atof(file.words[pos+1]), //x
-									atof(file.words[pos+2]), //y
-									atof(file.words[pos+3])); //z
-							pos+=4;
-						}
-						//offset, takes the word offset and 3 values
-						else if (!strcmp(file.words[pos], "offset") && left >= 4)
-						{
-							mesh->Offset(atof(file.words[pos+1]), //x
-									atof(file.words[pos+2]), //y
-									atof(file.words[pos+3])); //z
-							pos+=4;
-						}
-						else
-						{
-							Log_Add(0, "WARNING: models loading option \"%s\" not known", file.words[pos]);
-							++pos;
-						}
-					}
-				}
+					continue;
 				//surface manipulation (of latest geom)
 				else if (!strcmp(file.words[1], "surface") && file.word_count >= 3)
 				{
@@ -332,6 +404,7 @@ bool load_track (const char *path)
 	}
 
 	RemoveMeshes();
+	Loader_Clear(); //(decoded textures)
 
 	//
 	//objects
@@ -393,7 +466,8 @@ bool load_track (const char *path)
 	else
 		Log_Add(0, "WARNING: no object list for track, no default objects created");
 
-	//that's it!
+	//that's it! (time useful for checking if cached models were used)
+	Log_Add(1, "Track loaded in %fms", (Clock_Get()-start)/1000000.0);
 	return true;
 }
 
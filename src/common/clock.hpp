@@ -0,0 +1,33 @@
+/*
+ * ReCaged - a Free Software, Futuristic, Racing Game
+ *
+ * Copyright (C) 2015 Mats Wahlberg
+ *
+ * This file is part of ReCaged.
+ *
+ * ReCaged is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ReCaged is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ReCaged.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+//high resolution (nanosecond) clock, for measuring how long things take
+//(SDL_GetTicks only got millisecond resolution, too coarse for single steps)
+
+#ifndef _ReCaged_CLOCK_H
+#define _ReCaged_CLOCK_H
+
+#include <SDL/SDL_stdinc.h> //Uint64
+
+//current time (in ns, from arbitrary starting point)
+Uint64 Clock_Get();
+
+#endif
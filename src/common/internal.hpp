@@ -34,12 +34,23 @@ extern struct internal_struct {
 	//for multithreading
 	bool sync_simulation, sync_interface;
 	bool spinning;
+	bool interpolation;
+
+	//debugging
+	bool profiler;
+	bool tyre_check;
+	int rewind_snapshots;
+
+	//loading
+	bool mesh_cache;
+	int loading_threads;
 
 	//physics
 	dReal stepsize;
 	int iterations;
 	int multiplier;
 	int contact_points;
+	int threads;
 	dReal surface_layer;
 	dReal erp,cfm;
 	dReal linear_drag, angular_drag;
@@ -56,6 +67,8 @@ extern struct internal_struct {
 	bool culling;
 	bool fullscreen;
 	int msaa;
+	bool instancing;
+	bool sort_draws;
 	int filter;
 	bool separate_specular;
 	float vfov, hfov;
@@ -67,10 +80,17 @@ const struct internal_struct internal_defaults = {
 	true,
 	true,true,
 	false,
+	false,
+	false,
+	false,
+	0,
+	true,
+	0,
 	0.01,
 	5,
 	4,
 	20,
+	1,
 	0.001,
 	0.8, 0.00001,
 	5.0,5.0,
@@ -83,6 +103,8 @@ const struct internal_struct internal_defaults = {
 	true,
 	false,
 	4,
+	true,
+	true,
 	1,
 	true,
 	75.0,
@@ -96,12 +118,21 @@ const struct Conf_Index internal_index[] = {
 	{"sync_simulation",	'b',1, offsetof(struct internal_struct, sync_simulation)},
 	{"sync_interface",	'b',1, offsetof(struct internal_struct, sync_interface)},
 	{"spinning",		'b',1, offsetof(struct internal_struct, spinning)},
+	{"interpolation",	'b',1, offsetof(struct internal_struct, interpolation)},
+
+	{"profiler",		'b',1, offsetof(struct internal_struct, profiler)},
+	{"tyre_check",		'b',1, offsetof(struct internal_struct, tyre_check)},
+	{"rewind_snapshots",	'i',1, offsetof(struct internal_struct, rewind_snapshots)},
+
+	{"mesh_cache",		'b',1, offsetof(struct internal_struct, mesh_cache)},
+	{"loading_threads",	'i',1, offsetof(struct internal_struct, loading_threads)},
 
 	//physics
 	{"stepsize",		'R',1, offsetof(struct internal_struct, stepsize)},
 	{"iterations",		'i',1, offsetof(struct internal_struct, iterations)},
 	{"multiplier",		'i',1, offsetof(struct internal_struct, multiplier)},
 	{"contact_points",	'i',1, offsetof(struct internal_struct, contact_points)},
+	{"threads",		'i',1, offsetof(struct internal_struct, threads)},
 	{"surface_layer",	'R',1, offsetof(struct internal_struct, surface_layer)},
 	{"default_erp",		'R',1, offsetof(struct internal_struct, erp)},
 	{"default_cfm",		'R',1, offsetof(struct internal_struct, cfm)},
@@ -119,6 +150,8 @@ const struct Conf_Index internal_index[] = {
 	{"backface_culling",	'b',1, offsetof(struct internal_struct, culling)},
 	{"fullscreen",		'b',1, offsetof(struct internal_struct, fullscreen)},
 	{"multisample",		'i',1, offsetof(struct internal_struct, msaa)},
+	{"instancing",		'b',1, offsetof(struct internal_struct, instancing)},
+	{"sort_draws",		'b',1, offsetof(struct internal_struct, sort_draws)},
 	{"texture:filter",	'i',1, offsetof(struct internal_struct, filter)},
 	{"texture:separate_specular",'b',1, offsetof(struct internal_struct, separate_specular)},
 	{"vFOV",		'f',1, offsetof(struct internal_struct, vfov)},
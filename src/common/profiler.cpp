@@ -0,0 +1,96 @@
+/*
+ * ReCaged - a Free Software, Futuristic, Racing Game
+ *
+ * Copyright (C) 2015 Mats Wahlberg
+ *
+ * This file is part of ReCaged.
+ *
+ * ReCaged is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ReCaged is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ReCaged.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+#include <stdlib.h>
+
+#include "profiler.hpp"
+#include "log.hpp"
+
+Profiler *Profiler::head = NULL;
+bool Profiler::enabled = false;
+
+//profilers are normally static/global, so this is done before main() starts
+Profiler::Profiler(const char *n): name(n)
+{
+	//place last in list, so printed in order of creation
+	next = NULL;
+	Profiler **p;
+	for (p=&head; *p; p=&(*p)->next);
+	*p = this;
+
+	position=0;
+	count=0;
+	total=0;
+	max=0;
+}
+
+void Profiler::Reset_All()
+{
+	for (Profiler *p=head; p; p=p->next)
+	{
+		p->position=0;
+		p->count=0;
+		p->total=0;
+		p->max=0;
+	}
+}
+
+//for sorting samples
+static int compare_samples(const void *a, const void *b)
+{
+	Uint64 x = *(const Uint64*)a, y = *(const Uint64*)b;
+	return (x>y) - (x<y);
+}
+
+void Profiler::Print_All(Uint64 wall_time)
+{
+	Log_puts(0, "\n   <[ Profiler ]>\n\n");
+	Log_puts(0, " (time in microseconds, percentiles from latest samples)\n");
+	Log_printf(0, " %-20s %9s %9s %9s %9s %9s %6s\n",
+			"", "calls", "average", "p50", "p99", "max", "share");
+
+	Uint64 sorted[PROFILER_SAMPLES];
+	unsigned int samples;
+	for (Profiler *p=head; p; p=p->next)
+	{
+		if (!p->count)
+		{
+			Log_printf(0, " %-20s %9s\n", p->name, "-");
+			continue;
+		}
+
+		//latest samples, in order of size
+		samples = (p->count < PROFILER_SAMPLES)? p->count: PROFILER_SAMPLES;
+		for (unsigned int i=0; i<samples; ++i)
+			sorted[i] = p->samples[i];
+		qsort(sorted, samples, sizeof(Uint64), compare_samples);
+
+		Log_printf(0, " %-20s %9u %9.2f %9.2f %9.2f %9.2f %5.1f%%\n",
+				p->name, p->count,
+				p->total/1000.0/p->count,
+				sorted[(samples-1)/2]/1000.0,
+				sorted[(samples-1)*99/100]/1000.0,
+				p->max/1000.0,
+				wall_time? (100.0*p->total)/wall_time: 0.0);
+	}
+
+	Log_puts(0, "\n");
+}
@@ -0,0 +1,98 @@
+/*
+ * ReCaged - a Free Software, Futuristic, Racing Game
+ *
+ * Copyright (C) 2015 Mats Wahlberg
+ *
+ * This file is part of ReCaged.
+ *
+ * ReCaged is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ReCaged is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ReCaged.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+//Low-overhead timing of hot code paths (like the stages of the simulation
+//step). Each Profiler keeps totals and a ring buffer of the latest samples,
+//which are used for calculating percentiles when printed. Timing is done by
+//placing a Profiler_Scope at the start of a block (stops at end of block).
+//Only one thread should use each Profiler.
+
+#ifndef _ReCaged_PROFILER_H
+#define _ReCaged_PROFILER_H
+
+#include "clock.hpp"
+
+//number of latest samples to keep for percentiles
+#define PROFILER_SAMPLES 1024
+
+class Profiler
+{
+	public:
+		Profiler(const char *name);
+
+		void Add(Uint64 time)
+		{
+			samples[position] = time;
+			position = (position+1)%PROFILER_SAMPLES;
+
+			++count;
+			total += time;
+			if (time > max)
+				max = time;
+		}
+
+		Uint64 Total() {return total;}
+
+		//all profilers
+		static void Reset_All();
+		static void Print_All(Uint64 wall_time); //wall_time (ns) for share, or 0
+		static bool enabled; //only time when enabled
+
+	private:
+		const char *name;
+
+		Uint64 samples[PROFILER_SAMPLES];
+		unsigned int position;
+
+		unsigned int count;
+		Uint64 total;
+		Uint64 max;
+
+		static Profiler *head;
+		Profiler *next;
+};
+
+//times from creation until out of scope
+class Profiler_Scope
+{
+	public:
+		Profiler_Scope(Profiler *p)
+		{
+			if (Profiler::enabled)
+			{
+				profiler=p;
+				start=Clock_Get();
+			}
+			else
+				profiler=NULL;
+		}
+		~Profiler_Scope()
+		{
+			if (profiler)
+				profiler->Add(Clock_Get()-start);
+		}
+
+	private:
+		Profiler *profiler;
+		Uint64 start;
+};
+
+#endif
@@ -21,6 +21,9 @@
 
 #include <SDL/SDL.h>
 #include "threads.hpp"
+#include "internal.hpp"
+#include "profiler.hpp"
+#include "interface/render_list.hpp"
 
 //global Thread variables, will be more dynamic in future
 Thread interface_thread = thread_defaults;
@@ -28,6 +31,8 @@ Thread simulation_thread = thread_defaults;
 
 Uint32 starttime = 0;
 Uint32 racetime = 0;
+bool headless = false;
+
 void Threads_Launch(void)
 {
 	//start
@@ -40,8 +45,12 @@ void Threads_Launch(void)
 	simulation_thread.sync_mutex = SDL_CreateMutex();
 	simulation_thread.sync_cond = SDL_CreateCond();
 
-	//prevent (unlikely) update/render collision
-	simulation_thread.render_list_mutex = SDL_CreateMutex();
+	//time stages of simulation (if requested)
+	Profiler::enabled = internal.profiler;
+	Profiler::Reset_All();
+
+	//static geoms will not move, keep them out of the render list
+	Render_List_Build();
 
 	starttime = SDL_GetTicks(); //how long it took for race to start
 
@@ -60,9 +69,15 @@ void Threads_Launch(void)
 	SDL_DestroyMutex(simulation_thread.ode_mutex);
 	SDL_DestroyMutex(simulation_thread.sync_mutex);
 	SDL_DestroyCond(simulation_thread.sync_cond);
-	SDL_DestroyMutex(simulation_thread.render_list_mutex);
+
+	//(now safe to) remove rendering list buffers
+	Render_List_Statistics();
+	Render_List_Clear();
 
 	//done!
 	Log_Add(0, "Threads (and race) Finished");
+
+	if (internal.profiler)
+		Profiler::Print_All((Uint64)racetime*1000000);
 }
 
@@ -46,9 +46,6 @@ struct Thread {
 	bool render_models;
 	bool render_geoms;
 
-	SDL_mutex *render_list_mutex; //prevents switching buffers at same time
-	//(probability is low, but it could occur)
-
 	//for simulation threads
 	SDL_mutex *ode_mutex; //prevent simultaneous access
 	SDL_mutex *sync_mutex; //for signaling a new frame ready to draw
@@ -71,7 +68,6 @@ const Thread thread_defaults = {
 	NULL,
 	NULL,
 	NULL,
-	NULL,
 	0,
 	0,
 	0 };
@@ -81,6 +77,9 @@ const Thread thread_defaults = {
 extern Uint32 starttime;
 extern Uint32 racetime;
 
+//no interface (window, opengl context or input), only simulation
+extern bool headless;
+
 //just these, explicitly, two threads for now:
 extern Thread interface_thread;
 extern Thread simulation_thread;
@@ -90,11 +89,14 @@ void Threads_Launch(void);
 
 bool Interface_Init(bool window, bool fullscreen, int xres, int yres);
 void Interface_Quit(void);
+void Interface_Splash_Progress(float progress); //(0 to 1, while loading)
 bool Simulation_Init(void);
 void Simulation_Quit (void);
 
 int Interface_Loop (void);
 int Simulation_Loop (void *d);
+void Simulation_Benchmark (unsigned int steps);
+Uint32 Simulation_Checksum ();
 
 
 //TMP: used for keeping track for objects creation
@@ -23,6 +23,7 @@
 #include <math.h>
 #include <GL/glew.h>
 #include "geom_render.hpp"
+#include "render_list.hpp"
 #include "simulation/geom.hpp"
 #include "assets/assets.hpp"
 #include "common/threads.hpp"
@@ -243,8 +244,10 @@ void Geom_Render()
 	//lock ode: make sure no geoms change while we build render
 	//(not likely, but just to be sure)
 	SDL_mutexP(simulation_thread.ode_mutex);
-	for (geom=Geom::head; geom; geom=geom->next)
+	size_t count = Geom::pool.size();
+	for (size_t p=0; p<count; ++p)
 	{
+		geom = Geom::pool[p];
 		g = geom->geom_id;
 		new_vertices=0;
 		new_indices=0;
@@ -252,7 +255,7 @@ void Geom_Render()
 		//check if rendering with collision indication
 		if (geom_render_level == 5)
 		{
-			if (geom->colliding)
+			if (Geom::pool_colliding[p])
 			{
 				colour[0]= 1.0;
 				colour[1]= 0.0;
@@ -454,11 +457,8 @@ void Geom_Render()
 					if ( geom_render_level == 5)
 					{
 						//we will be rendering the colliding triangles twice:
-						//count colliding triangles
-						collidingtriangles=0;
-						for (tloop=0; tloop<triangles; ++tloop)
-							if (geom->triangle_colliding[tloop])
-								++collidingtriangles;
+						const std::vector<int> &colliding = geom->Colliding_Triangles();
+						collidingtriangles=colliding.size();
 
 						//make sure got memory
 						Assure_Memory ((triangles+collidingtriangles)*3, (triangles+collidingtriangles)*3);
@@ -468,14 +468,13 @@ void Geom_Render()
 						colour[1]= 0.0;
 						colour[2]= 0.0;
 
-						for (tloop=0; tloop<triangles; ++tloop)
-							if (geom->triangle_colliding[tloop])
-							{
-								dGeomTriMeshGetTriangle(g, tloop, &v0, &v1, &v2);
-								AAVertex(v0[0], v0[1], v0[2]);
-								AAVertex(v1[0], v1[1], v1[2]);
-								AAVertex(v2[0], v2[1], v2[2]);
-							}
+						for (tloop=0; tloop<collidingtriangles; ++tloop)
+						{
+							dGeomTriMeshGetTriangle(g, colliding[tloop], &v0, &v1, &v2);
+							AAVertex(v0[0], v0[1], v0[2]);
+							AAVertex(v1[0], v1[1], v1[2]);
+							AAVertex(v2[0], v2[1], v2[2]);
+						}
 
 						//create indices (for simple triangle array rendering):
 						for (tloop=0; tloop<collidingtriangles; ++tloop)
@@ -569,7 +568,8 @@ void Geom_Render()
 		return;
 	}
 
-	//configure rendering properties:
+	//configure rendering properties (render list must set its own again):
+	Render_List_Reset_State();
 	glShadeModel (GL_FLAT);
 	glDisable (GL_LIGHTING);
 	glDisable (GL_TEXTURE_2D);
@@ -0,0 +1,270 @@
+/*
+ * ReCaged - a Free Software, Futuristic, Racing Game
+ *
+ * Copyright (C) 2015 Mats Wahlberg
+ *
+ * This file is part of ReCaged.
+ *
+ * ReCaged is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ReCaged is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ReCaged.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+#include <GL/glew.h>
+#include "instancing.hpp"
+
+#include "assets/track.hpp"
+#include "common/internal.hpp"
+#include "common/log.hpp"
+
+//for setting up buffers (attribute pointers)
+#define BUFFER_OFFSET(i) ((char *)NULL + (i))
+
+bool instancing = false;
+
+GLuint instancing_program = 0;
+GLuint instancing_vbo = 0;
+size_t instancing_vbo_size = 0; //bytes allocated
+
+GLint uniform_texture_enabled, uniform_fog_mode;
+
+//
+//shaders: the same as fixed pipeline with one light (directional or point),
+//front material, modulated texture and fog (the gl_* state is still set as
+//usual with glLight, glMaterial and glFog)
+//
+
+const char *instancing_vertex_shader =
+"#version 120\n"
+"attribute mat4 instance_matrix; //modelview for this instance\n"
+"uniform bool separate_specular;\n"
+"\n"
+"void main()\n"
+"{\n"
+"	vec4 eye = instance_matrix * gl_Vertex;\n"
+"	gl_Position = gl_ProjectionMatrix * eye;\n"
+"	vec3 normal = normalize(mat3(instance_matrix) * gl_Normal);\n"
+"\n"
+"	//light direction (and attenuation if point)\n"
+"	vec3 light;\n"
+"	float attenuation = 1.0;\n"
+"	if (gl_LightSource[0].position.w == 0.0)\n"
+"		light = normalize(gl_LightSource[0].position.xyz);\n"
+"	else\n"
+"	{\n"
+"		light = gl_LightSource[0].position.xyz - eye.xyz;\n"
+"		float d = length(light);\n"
+"		light /= d;\n"
+"		attenuation = 1.0 / (gl_LightSource[0].constantAttenuation +\n"
+"			gl_LightSource[0].linearAttenuation*d + gl_LightSource[0].quadraticAttenuation*d*d);\n"
+"	}\n"
+"\n"
+"	//diffuse, and specular (viewer at infinity)\n"
+"	float diffuse = max(dot(normal, light), 0.0);\n"
+"	float specular = 0.0;\n"
+"	if (diffuse > 0.0)\n"
+"	{\n"
+"		float h = max(dot(normal, normalize(light + vec3(0.0, 0.0, 1.0))), 0.0);\n"
+"		specular = gl_FrontMaterial.shininess > 0.0? pow(h, gl_FrontMaterial.shininess): 1.0;\n"
+"	}\n"
+"\n"
+"	vec4 primary = gl_FrontLightModelProduct.sceneColor + attenuation *\n"
+"		(gl_FrontLightProduct[0].ambient + diffuse*gl_FrontLightProduct[0].diffuse);\n"
+"	vec3 secondary = attenuation*specular*gl_FrontLightProduct[0].specular.rgb;\n"
+"	primary.a = gl_FrontMaterial.diffuse.a;\n"
+"\n"
+"	//specular added after texturing, or before\n"
+"	if (separate_specular)\n"
+"		gl_FrontSecondaryColor = vec4(clamp(secondary, 0.0, 1.0), 0.0);\n"
+"	else\n"
+"	{\n"
+"		primary.rgb += secondary;\n"
+"		gl_FrontSecondaryColor = vec4(0.0);\n"
+"	}\n"
+"\n"
+"	gl_FrontColor = clamp(primary, 0.0, 1.0);\n"
+"	gl_TexCoord[0] = gl_TextureMatrix[0] * gl_MultiTexCoord0;\n"
+"	gl_FogFragCoord = abs(eye.z);\n"
+"}\n";
+
+const char *instancing_fragment_shader =
+"#version 120\n"
+"uniform sampler2D diffuse_texture;\n"
+"uniform bool texture_enabled;\n"
+"uniform int fog_mode; //0=none, 1=linear, 2=exp, 3=exp2\n"
+"\n"
+"void main()\n"
+"{\n"
+"	vec4 color = gl_Color;\n"
+"	if (texture_enabled)\n"
+"		color *= texture2D(diffuse_texture, gl_TexCoord[0].st);\n"
+"	color.rgb += gl_SecondaryColor.rgb;\n"
+"\n"
+"	if (fog_mode != 0)\n"
+"	{\n"
+"		float z = gl_FogFragCoord;\n"
+"		float f;\n"
+"		if (fog_mode == 1)\n"
+"			f = (gl_Fog.end-z)*gl_Fog.scale;\n"
+"		else if (fog_mode == 2)\n"
+"			f = exp(-gl_Fog.density*z);\n"
+"		else\n"
+"			f = exp(-(gl_Fog.density*z)*(gl_Fog.density*z));\n"
+"\n"
+"		color.rgb = mix(gl_Fog.color.rgb, color.rgb, clamp(f, 0.0, 1.0));\n"
+"	}\n"
+"\n"
+"	gl_FragColor = color;\n"
+"}\n";
+
+//compile shader, 0 if failed
+static GLuint Compile_Shader(GLenum type, const char *source)
+{
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+
+	GLint status;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (!status)
+	{
+		char log[1024];
+		glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+		Log_Add(0, "WARNING: could not compile shader for instancing: %s", log);
+		glDeleteShader(shader);
+		return 0;
+	}
+
+	return shader;
+}
+
+void Instancing_Init()
+{
+	instancing = false;
+
+	if (!internal.instancing)
+		return;
+
+	if (!GLEW_VERSION_2_0 || !GLEW_ARB_instanced_arrays || !GLEW_ARB_draw_instanced)
+	{
+		Log_Add(1, "Instancing not supported by graphics, drawing each model separately");
+		return;
+	}
+
+	GLuint vertex = Compile_Shader(GL_VERTEX_SHADER, instancing_vertex_shader);
+	GLuint fragment = Compile_Shader(GL_FRAGMENT_SHADER, instancing_fragment_shader);
+	if (!vertex || !fragment)
+	{
+		glDeleteShader(vertex); //(0 is ignored)
+		glDeleteShader(fragment);
+		return;
+	}
+
+	instancing_program = glCreateProgram();
+	glAttachShader(instancing_program, vertex);
+	glAttachShader(instancing_program, fragment);
+	glBindAttribLocation(instancing_program, INSTANCING_ATTRIBUTE, "instance_matrix");
+	glLinkProgram(instancing_program);
+
+	//(deleted with program)
+	glDeleteShader(vertex);
+	glDeleteShader(fragment);
+
+	GLint status;
+	glGetProgramiv(instancing_program, GL_LINK_STATUS, &status);
+	if (!status)
+	{
+		char log[1024];
+		glGetProgramInfoLog(instancing_program, sizeof(log), NULL, log);
+		Log_Add(0, "WARNING: could not link shader for instancing: %s", log);
+		glDeleteProgram(instancing_program);
+		instancing_program = 0;
+		return;
+	}
+
+	//constant uniforms
+	glUseProgram(instancing_program);
+	glUniform1i(glGetUniformLocation(instancing_program, "diffuse_texture"), 0);
+	glUniform1i(glGetUniformLocation(instancing_program, "separate_specular"), internal.separate_specular);
+	uniform_texture_enabled = glGetUniformLocation(instancing_program, "texture_enabled");
+	uniform_fog_mode = glGetUniformLocation(instancing_program, "fog_mode");
+	glUseProgram(0);
+
+	//buffer for matrices (allocated when used)
+	glGenBuffers(1, &instancing_vbo);
+	instancing_vbo_size = 0;
+
+	instancing = true;
+	Log_Add(1, "Using instancing for drawing copies of models");
+}
+
+void Instancing_Quit()
+{
+	if (!instancing)
+		return;
+
+	glDeleteProgram(instancing_program);
+	glDeleteBuffers(1, &instancing_vbo);
+	instancing_program = 0;
+	instancing_vbo = 0;
+	instancing = false;
+}
+
+void Instancing_Begin(const float *matrices, size_t count)
+{
+	size_t size = sizeof(float)*16*count;
+
+	//stream: new storage each frame (no waiting for last frame to finish)
+	glBindBuffer(GL_ARRAY_BUFFER, instancing_vbo);
+	if (size > instancing_vbo_size)
+	{
+		instancing_vbo_size = size;
+		glBufferData(GL_ARRAY_BUFFER, size, matrices, GL_STREAM_DRAW);
+	}
+	else if (size)
+	{
+		glBufferData(GL_ARRAY_BUFFER, instancing_vbo_size, NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, size, matrices);
+	}
+
+	glUseProgram(instancing_program);
+	glUniform1i(uniform_fog_mode, track.fog_mode);
+
+	for (int i=0; i<4; ++i)
+	{
+		glEnableVertexAttribArray(INSTANCING_ATTRIBUTE+i);
+		glVertexAttribDivisorARB(INSTANCING_ATTRIBUTE+i, 1);
+	}
+}
+
+void Instancing_Matrices(size_t first)
+{
+	//(array buffer binding only matters when setting pointers)
+	glBindBuffer(GL_ARRAY_BUFFER, instancing_vbo);
+
+	for (int i=0; i<4; ++i)
+		glVertexAttribPointer(INSTANCING_ATTRIBUTE+i, 4, GL_FLOAT, GL_FALSE, sizeof(float)*16,
+				BUFFER_OFFSET(sizeof(float)*(16*first + 4*i)));
+}
+
+void Instancing_Texture(bool enabled)
+{
+	glUniform1i(uniform_texture_enabled, enabled);
+}
+
+void Instancing_End()
+{
+	for (int i=0; i<4; ++i)
+		glDisableVertexAttribArray(INSTANCING_ATTRIBUTE+i);
+
+	glUseProgram(0);
+}
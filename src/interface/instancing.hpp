@@ -0,0 +1,47 @@
+/*
+ * ReCaged - a Free Software, Futuristic, Racing Game
+ *
+ * Copyright (C) 2015 Mats Wahlberg
+ *
+ * This file is part of ReCaged.
+ *
+ * ReCaged is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ReCaged is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ReCaged.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+#ifndef _ReCaged_INSTANCING_H
+#define _ReCaged_INSTANCING_H
+
+#include <stddef.h>
+
+//drawing all copies of a model (material) with one call: the matrices of the
+//copies are streamed as vertex attributes (advancing once per instance), and
+//a shader does the same lighting, texturing and fog as the fixed pipeline.
+//Only used when supported (GLSL, ARB_instanced_arrays, ARB_draw_instanced),
+//otherwise models are drawn one at a time without shaders.
+
+//first of four attributes (matrix columns). Not overlapping the conventional
+//attributes in use (vertex, normal and texture coordinates 0)
+#define INSTANCING_ATTRIBUTE 10
+
+extern bool instancing; //supported and enabled
+
+void Instancing_Init(); //(with opengl context, not fatal if fails)
+void Instancing_Quit();
+
+void Instancing_Begin(const float *matrices, size_t count); //upload, start shader
+void Instancing_Matrices(size_t first); //next draw uses matrices from first
+void Instancing_Texture(bool enabled); //(replaces GL_TEXTURE_2D toggling)
+void Instancing_End(); //back to fixed pipeline
+
+#endif
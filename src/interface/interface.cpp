@@ -34,6 +34,9 @@
 
 #include "render_list.hpp"
 #include "geom_render.hpp"
+#include "instancing.hpp"
+#include "simulation/input_log.hpp"
+#include "simulation/snapshot.hpp"
 
 #include "assets/image.hpp"
 
@@ -74,6 +77,9 @@ void Resize (int new_w, int new_h)
 	int w=screen->w;
 	int h=screen->h;
 
+	//might have a new opengl context
+	Render_List_Reset_State();
+
 	glViewport (0,0,w,h);
 	glMatrixMode (GL_PROJECTION);
 	glLoadIdentity();
@@ -125,6 +131,101 @@ void Resize (int new_w, int new_h)
 }
 
 
+//splash screen (kept while loading, for showing progress)
+Image_Texture *splash_texture = NULL;
+GLuint splash_vbo = 0;
+int splash_size[2];
+
+//render splash screen, and progress bar (unless negative)
+void Splash_Draw(float progress)
+{
+	int screenx = splash_size[0];
+	int screeny = splash_size[1];
+
+	glBindTexture(GL_TEXTURE_2D, splash_texture->GetID());
+	glBindBuffer(GL_ARRAY_BUFFER, splash_vbo);
+
+	//progress bar (background and filled part) after image quad
+	if (progress >= 0.0)
+	{
+		if (progress > 1.0)
+			progress = 1.0;
+
+		GLfloat x0=(GLfloat)screenx*0.25; //centered, half width
+		GLfloat x1=(GLfloat)screenx*0.75;
+		GLfloat xp=x0+(x1-x0)*progress;
+		GLfloat y0=(GLfloat)screeny-32.0; //near bottom
+		GLfloat y1=(GLfloat)screeny-24.0;
+
+		GLfloat bar[]=
+		{
+			x1,	y0,	-1.0,	0.0,	0.0,
+			x0,	y0,	-1.0,	0.0,	0.0,
+			x0,	y1,	-1.0,	0.0,	0.0,
+			x1,	y1,	-1.0,	0.0,	0.0,
+
+			xp,	y0,	-1.0,	0.0,	0.0,
+			x0,	y0,	-1.0,	0.0,	0.0,
+			x0,	y1,	-1.0,	0.0,	0.0,
+			xp,	y1,	-1.0,	0.0,	0.0,
+		};
+
+		glBufferSubData(GL_ARRAY_BUFFER, sizeof(GLfloat)*4*5, sizeof(bar), bar);
+	}
+
+	glVertexPointer(3, GL_FLOAT, sizeof(GLfloat)*5, BUFFER_OFFSET(0));
+	glTexCoordPointer(2, GL_FLOAT, sizeof(GLfloat)*5, BUFFER_OFFSET(sizeof(GLfloat)*3));
+
+	//change projection matrix to ortho mode, store old matrix
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(0, screenx, screeny, 0, 0, 10);
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity(); //clear, just in case
+
+	//arbitrary clear colour, but black background works for most people
+	glClearColor (0.0, 0.0, 0.0, 1.0);
+	glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	//enable lots of stuff:
+	glEnableClientState(GL_VERTEX_ARRAY); //coordinates
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY); //UVs
+
+	glEnable(GL_TEXTURE_2D); //texture
+	glEnable(GL_BLEND); //alpha blending (looks even better without a single background colour...)
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); //a common function, looks good
+
+	//
+	//and everything done, just to be able to run the following, once.
+	glColor4f(1.0, 1.0, 1.0, 1.0);
+	glDrawArrays(GL_QUADS, 0, 4); //ZOMG!
+
+	//bar without texture
+	if (progress >= 0.0)
+	{
+		glDisable(GL_TEXTURE_2D);
+		glColor4f(1.0, 1.0, 1.0, 0.25);
+		glDrawArrays(GL_QUADS, 4, 4);
+		glColor4f(1.0, 1.0, 1.0, 1.0);
+		glDrawArrays(GL_QUADS, 8, 4);
+	}
+
+	SDL_GL_SwapBuffers(); //and show it to the user! :)
+	//
+
+	//and now start the clean up:
+	glDisable(GL_TEXTURE_2D);
+	glDisable(GL_BLEND);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+
+	//restore good old perspective matrix
+	glMatrixMode (GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode (GL_MODELVIEW);
+}
+
 //simple rendering of image (splash screen) when loading
 bool Interface_Splash(const char *file, int screenx, int screeny)
 {
@@ -136,14 +237,10 @@ bool Interface_Splash(const char *file, int screenx, int screeny)
 	if (!image.Load(file))
 		return false;
 
-	//create texture and bind it
-	Image_Texture *texture=image.Create_Texture();
-
-	if (!texture)
+	//create texture
+	if (!(splash_texture=image.Create_Texture()))
 		return false;
 
-	glBindTexture(GL_TEXTURE_2D, texture->GetID());
-
 	//create quad for rendering it
 	GLfloat imageratio= (GLfloat)image.Width() / (GLfloat)image.Height();
 	GLfloat screenratio = (GLfloat)screenx / (GLfloat)screeny;
@@ -176,56 +273,36 @@ bool Interface_Splash(const char *file, int screenx, int screeny)
 		x0+x,	y0+y,	-1.0,	1.0,	1.0,
 	};
 
-	//create vbo and upload above quad to it
-	GLuint vbo;
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*4*5, quad, GL_STATIC_DRAW);
-	glVertexPointer(3, GL_FLOAT, sizeof(GLfloat)*5, BUFFER_OFFSET(0));
-	glTexCoordPointer(2, GL_FLOAT, sizeof(GLfloat)*5, BUFFER_OFFSET(sizeof(GLfloat)*3));
-
-	//change projection matrix to ortho mode, store old matrix
-	glMatrixMode(GL_PROJECTION);
-	glPushMatrix();
-	glLoadIdentity();
-	glOrtho(0, screenx, screeny, 0, 0, 10);
-	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity(); //clear, just in case
+	//create vbo and upload above quad to it (room for two more quads for
+	//progress bar)
+	glGenBuffers(1, &splash_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, splash_vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*3*4*5, NULL, GL_STATIC_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(GLfloat)*4*5, quad);
 
-	//arbitrary clear colour, but black background works for most people
-	glClearColor (0.0, 0.0, 0.0, 1.0);
-	glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	//enable lots of stuff:
-	glEnableClientState(GL_VERTEX_ARRAY); //coordinates
-	glEnableClientState(GL_TEXTURE_COORD_ARRAY); //UVs
-
-	glEnable(GL_TEXTURE_2D); //texture
-	glEnable(GL_BLEND); //alpha blending (looks even better without a single background colour...)
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); //a common function, looks good
-
-	//
-	//and everything done, just to be able to run the following, once.
-	glDrawArrays(GL_QUADS, 0, 4); //ZOMG!
-	SDL_GL_SwapBuffers(); //and show it to the user! :)
-	//
+	splash_size[0]=screenx;
+	splash_size[1]=screeny;
 
-	//and now start the clean up:
-	glDisable(GL_TEXTURE_2D);
-	glDisable(GL_BLEND);
-	glDisableClientState(GL_VERTEX_ARRAY);
-	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	Splash_Draw(-1.0);
+	return true;
+}
 
-	//delete vbo and texture
-	glDeleteBuffers(1, &vbo);
-	delete texture;
+//redraw splash screen with progress bar
+void Interface_Splash_Progress(float progress)
+{
+	if (splash_texture)
+		Splash_Draw(progress);
+}
 
-	//restore good old perspective matrix
-	glMatrixMode (GL_PROJECTION);
-	glPopMatrix();
-	glMatrixMode (GL_MODELVIEW);
+//loading done, delete vbo and texture
+void Interface_Splash_Quit()
+{
+	if (!splash_texture)
+		return;
 
-	return true;
+	glDeleteBuffers(1, &splash_vbo);
+	delete splash_texture;
+	splash_texture = NULL;
 }
 
 bool Interface_Init(bool window, bool fullscreen, int xres, int yres)
@@ -366,6 +443,9 @@ bool Interface_Init(bool window, bool fullscreen, int xres, int yres)
 	else
 		glLightModeli(GL_LIGHT_MODEL_COLOR_CONTROL, GL_SINGLE_COLOR);
 
+	//draw copies of models at once, if possible
+	Instancing_Init();
+
 	//and render splash screen, if found (not fatal if fails)
 	Interface_Splash("recaged.png", screen->w, screen->h);
 
@@ -387,6 +467,9 @@ int Interface_Loop ()
 {
 	Log_Add(1, "Starting interface loop");
 
+	//done loading
+	Interface_Splash_Quit();
+
 	//just make sure not rendering geoms yet
 	geom_render_level = 0;
 	interface_thread.count=0;
@@ -510,6 +593,13 @@ int Interface_Loop ()
 								simulation_thread.runlevel = paused;
 						break;
 
+						//rewind to last snapshot (if any, done by simulation thread)
+						case SDLK_BACKSPACE:
+							SDL_mutexP(simulation_thread.ode_mutex);
+							Snapshot::Ring_Request_Rewind();
+							SDL_mutexV(simulation_thread.ode_mutex);
+						break;
+
 						//switch what to render
 						case SDLK_F12:
 							//increase geom rendering level, and reset if at last
@@ -557,9 +647,14 @@ int Interface_Loop ()
 			default_camera.Move(0, 0, -0.03*delta);
 		//
 
-		//car control
-		if (simulation_thread.runlevel == running)
+		//car control (locked, so controls never change during a step,
+		//and not when replaying recorded controls)
+		if (simulation_thread.runlevel == running && !Input_Log_Replaying())
+		{
+			SDL_mutexP(simulation_thread.ode_mutex);
 			Profile_Input_Step(delta);
+			SDL_mutexV(simulation_thread.ode_mutex);
+		}
 
 
 		//start rendering
@@ -606,7 +701,6 @@ int Interface_Loop ()
 	//during rendering, memory might be allocated
 	//(will quickly be reallocated in each race and can be removed)
 	Geom_Render_Clear();
-	Render_List_Clear_Interface();
 
 	return 0;
 }
@@ -615,6 +709,9 @@ void Interface_Quit(void)
 {
 	Log_Add(1, "Quit interface");
 
+	Interface_Splash_Quit();
+	Instancing_Quit();
+
 	//close all joysticks
 	for (int i=0; i<joysticks; ++i)
 		if (joystick[i])
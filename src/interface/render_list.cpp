@@ -21,29 +21,37 @@
 
 #include <GL/glew.h>
 #include "render_list.hpp"
+#include "instancing.hpp"
 
 #include "assets/model.hpp"
 #include "assets/track.hpp"
 #include "common/threads.hpp"
 #include "common/internal.hpp"
 #include "common/log.hpp"
+#include "common/clock.hpp"
 #include "simulation/geom.hpp"
 #include "simulation/body.hpp"
 #include "simulation/camera.hpp"
 
 #include <stdlib.h>
+#include <math.h>
+#include <limits.h>
+#include <vector>
+#include <algorithm>
 #include <ode/ode.h>
 
 
 //just normal (component) list for now:
 
-//consists of two buffers:
+//consists of four buffers (see below):
 //each element in buffer:
 struct list_element
 {
-	GLfloat matrix[16]; //4x4
+	GLfloat pos[3];
+	GLfloat rot[4]; //quaternion (w, x, y, z)
 	Model_Draw *model; //model to render
 	Object *object; //object to which this component belongs
+	Component *component; //for matching with element in previous list
 };
 
 //keeps track of a buffer of elements:
@@ -51,7 +59,8 @@ struct list_element
 //(but never decreased. but since not so big)
 struct list_buffer
 {
-	bool updated;
+	unsigned int frame; //increased for each generated list
+	Uint64 time; //when generated
 	size_t count;
 	size_t size;
 	list_element *list;
@@ -61,431 +70,1246 @@ struct list_buffer
 };
 
 //buffers
-list_buffer buffer1 = {false, 0, 0, NULL, {0,0,0}, {0,0,0, 0,0,0, 0,0,0}, NULL};
-list_buffer buffer2 = {false, 0, 0, NULL, {0,0,0}, {0,0,0, 0,0,0, 0,0,0}, NULL};
-list_buffer buffer3 = {false, 0, 0, NULL, {0,0,0}, {0,0,0, 0,0,0, 0,0,0}, NULL};
+list_buffer buffers[4] = {
+	{0, 0, 0, 0, NULL, {0,0,0}, {0,0,0, 0,0,0, 0,0,0}, NULL},
+	{0, 0, 0, 0, NULL, {0,0,0}, {0,0,0, 0,0,0, 0,0,0}, NULL},
+	{0, 0, 0, 0, NULL, {0,0,0}, {0,0,0, 0,0,0, 0,0,0}, NULL},
+	{0, 0, 0, 0, NULL, {0,0,0}, {0,0,0, 0,0,0, 0,0,0}, NULL}};
+
+//"triple buffering" without locks: the simulation owns one buffer (generate),
+//the interface owns one (render) and the third (switch) is passed between
+//them. Only the index of the switch buffer is shared, and it's only changed
+//by atomic exchange (so each thread always gets a buffer nobody else uses).
+//The UPDATED bit is set when the simulation places a new list as switch, and
+//cleared when the interface grabs it.
+//
+//The interface also keeps the list before the render list (previous), for
+//interpolating between them. This is the one given back to the simulation
+//when grabbing a new list (then the old render list becomes previous).
+#define BUFFER_INDEX 3
+#define BUFFER_UPDATED 4
+
+unsigned int buffer_generate = 0; //only used by simulation
+unsigned int buffer_render = 1; //only used by interface
+unsigned int buffer_previous = 2; //-''-
+unsigned int buffer_switch = 3; //shared (atomic access only!)
+
+//number of generated lists. Like render_static of geoms, only used with
+//ode_mutex locked (by simulation, or interface when destroying objects)
+unsigned int frame_count = 0;
+
+
+//static geoms (no body) are not added to the lists, they are placed in a
+//tree of bounding spheres (built once) which is only traversed as far as
+//needed by the interface. If a static geom later moves or is removed, it is
+//marked with the last list not including it (and is added to lists again)
+struct static_element
+{
+	float matrix[16];
+	float radius; //(around position in matrix)
+	Model_Draw *model;
+	Object *object;
+	unsigned int last_frame; //set when moved or removed (atomic access!)
+};
+
+//nodes (depth first): first child right after node, second child indexed
+struct static_node
+{
+	float center[3];
+	float radius;
+	unsigned int first, count; //elements in this node
+	unsigned int second; //0 if leaf
+};
 
-//pointers at buffers
-list_buffer *buffer_render = &buffer1;
-list_buffer *buffer_switch = &buffer2;
-list_buffer *buffer_generate = &buffer3;
+static_element *static_elements = NULL;
+size_t static_count = 0;
+static_node *static_nodes = NULL;
+size_t static_node_count = 0;
 
 //remove allocated data in buffers
-void Render_List_Clear_Interface()
+//(only when neither simulation nor interface is running)
+void Render_List_Clear()
 {
-	if (buffer_render->size)
+	for (int i=0; i<4; ++i)
 	{
-		buffer_render->updated=false;
-		buffer_render->size=0;
-		buffer_render->count=0;
-		delete[] buffer_render->list;
-		buffer_render->list=NULL;
+		if (buffers[i].size)
+		{
+			buffers[i].size=0;
+			buffers[i].count=0;
+			buffers[i].time=0;
+			delete[] buffers[i].list;
+			buffers[i].list=NULL;
+		}
 	}
 
-	//don't know which thread will clear
-	SDL_mutexP(interface_thread.render_list_mutex);
-	if (buffer_switch->size)
-	{
-		buffer_switch->updated=false;
-		buffer_switch->size=0;
-		buffer_switch->count=0;
-		delete[] buffer_switch->list;
-		buffer_switch->list=NULL;
-	}
-	SDL_mutexV(interface_thread.render_list_mutex);
+	//make sure next race starts with no update waiting
+	buffer_switch &= BUFFER_INDEX;
+
+	//(next track might use other rendering options)
+	Render_List_Reset_State();
+
+	//static geoms (no longer in any tree)
+	size_t count = Geom::pool.size();
+	for (size_t i=0; i<count; ++i)
+		Geom::pool[i]->render_static = -1;
+
+	delete[] static_elements;
+	delete[] static_nodes;
+	static_elements = NULL;
+	static_nodes = NULL;
+	static_count = 0;
+	static_node_count = 0;
 }
 
-//remove allocated data in buffers
-void Render_List_Clear_Simulation()
+
+//simulation: publish generated list as switch buffer, and take the old one
+//for generating next time (release makes sure the list is written before)
+static void Publish_List()
 {
-	if (buffer_generate->size)
-	{
-		buffer_generate->updated=false;
-		buffer_generate->size=0;
-		buffer_generate->count=0;
-		delete[] buffer_generate->list;
-		buffer_generate->list=NULL;
-	}
+	buffer_generate = BUFFER_INDEX &
+		__atomic_exchange_n(&buffer_switch, buffer_generate | BUFFER_UPDATED, __ATOMIC_ACQ_REL);
+}
+
+//interface: grab the new list and leave the previous one for the simulation
+//(acquire makes sure the new list is seen completely written)
+static void Grab_List()
+{
+	unsigned int old_previous = buffer_previous;
+	buffer_previous = buffer_render;
+	buffer_render = BUFFER_INDEX &
+		__atomic_exchange_n(&buffer_switch, old_previous, __ATOMIC_ACQ_REL);
+}
 
-	//don't know which thread will clear
-	SDL_mutexP(interface_thread.render_list_mutex);
-	if (buffer_switch->size)
+//add element to list
+static void Add_Element(list_buffer *generate, Model_Draw *model, Component *component, Object *object,
+		const dReal *pos, const dReal *rot)
+{
+	//if buffer full...
+	if (generate->count == generate->size)
 	{
-		buffer_switch->updated=false;
-		buffer_switch->size=0;
-		buffer_switch->count=0;
-		delete[] buffer_switch->list;
-		buffer_switch->list=NULL;
+		Log_Add(2, "Render list was too small, resizing");
+
+		//copy to new memory
+		list_element *oldlist = generate->list;
+		generate->size+=INITIAL_RENDER_LIST_SIZE;
+		generate->list = new list_element[generate->size];
+		memcpy(generate->list, oldlist, sizeof(list_element)*generate->count);
+		delete[] oldlist;
 	}
-	SDL_mutexV(interface_thread.render_list_mutex);
-}
 
+	list_element *element = &generate->list[generate->count];
+
+	//position and rotation
+	element->pos[0]=pos[0];
+	element->pos[1]=pos[1];
+	element->pos[2]=pos[2];
+	element->rot[0]=rot[0];
+	element->rot[1]=rot[1];
+	element->rot[2]=rot[2];
+	element->rot[3]=rot[3];
+
+	//set what to render
+	element->model = model;
+
+	//set object and component:
+	element->object = object;
+	element->component = component;
+
+	//increase counter
+	++(generate->count);
+}
 
 //update
 void Render_List_Update()
 {
+	list_buffer *generate = &buffers[buffer_generate];
+
 	//TMP: store "camera" in rendering list
-	memcpy(buffer_generate->camera_pos, default_camera.pos, sizeof(float)*3);
-	memcpy(buffer_generate->camera_rot, default_camera.rotation, sizeof(float)*9);
-	buffer_generate->camera_hide = default_camera.hide;
+	memcpy(generate->camera_pos, default_camera.pos, sizeof(float)*3);
+	memcpy(generate->camera_rot, default_camera.rotation, sizeof(float)*9);
+	generate->camera_hide = default_camera.hide;
 
 	//add data as usual:
 
 	//pointers:
-	buffer_generate->count=0; //set to zero (empty)
+	generate->count=0; //set to zero (empty)
 
-	//variables
-	const dReal *pos, *rot;
-	GLfloat *matrix;
-
-	for (Geom *g=Geom::head; g; g=g->next)
+	dQuaternion rot;
+	Geom *g;
+	size_t count = Geom::pool.size();
+	for (size_t i=0; i<count; ++i)
 	{
-		if (g->model)
+		g = Geom::pool[i];
+		if (g->model && g->render_static == -1) //(static are in tree)
 		{
-			//if buffer full...
-			if (buffer_generate->count == buffer_generate->size)
-			{
-				Log_Add(2, "Render list was too small, resizing");
-
-				//copy to new memory
-				list_element *oldlist = buffer_generate->list;
-				buffer_generate->size+=INITIAL_RENDER_LIST_SIZE;
-				buffer_generate->list = new list_element[buffer_generate->size];
-				memcpy(buffer_generate->list, oldlist, sizeof(list_element)*buffer_generate->count);
-				delete[] oldlist;
-			}
-
-			pos = dGeomGetPosition(g->geom_id);
-			rot = dGeomGetRotation(g->geom_id);
-			matrix = buffer_generate->list[buffer_generate->count].matrix;
-
-			//set matrix
-			matrix[0]=rot[0];
-			matrix[1]=rot[4];
-			matrix[2]=rot[8];
-			matrix[3]=0;
-			matrix[4]=rot[1];
-			matrix[5]=rot[5];
-			matrix[6]=rot[9];
-			matrix[7]=0;
-			matrix[8]=rot[2];
-			matrix[9]=rot[6];
-			matrix[10]=rot[10];
-			matrix[11]=0;
-			matrix[12]=pos[0];
-			matrix[13]=pos[1];
-			matrix[14]=pos[2];
-			matrix[15]=1;
-
-			//set what to render
-			buffer_generate->list[buffer_generate->count].model = g->model;
-
-			//set object owning this component:
-			buffer_generate->list[buffer_generate->count].object = g->object_parent;
-
-			//increase counter
-			++(buffer_generate->count);
+			dGeomGetQuaternion(g->geom_id, rot);
+			Add_Element(generate, g->model, g, g->object_parent,
+					dGeomGetPosition(g->geom_id), rot);
 		}
 	}
 
 	//same as above, but for bodies
-	for (Body *b=Body::head; b; b=b->next)
+	Body *b;
+	count = Body::pool.size();
+	for (size_t i=0; i<count; ++i)
 	{
+		b = Body::pool[i];
 		if (b->model)
-		{
-			//if buffer full...
-			if (buffer_generate->count == buffer_generate->size)
-			{
-				Log_Add(2, "Render list was too small, resizing");
-
-				//copy to new memory
-				list_element *oldlist = buffer_generate->list;
-				buffer_generate->size+=INITIAL_RENDER_LIST_SIZE;
-				buffer_generate->list = new list_element[buffer_generate->size];
-				memcpy(buffer_generate->list, oldlist, sizeof(list_element)*buffer_generate->count);
-				delete[] oldlist;
-			}
-
-			pos = dBodyGetPosition(b->body_id);
-			rot = dBodyGetRotation(b->body_id);
-			matrix = buffer_generate->list[buffer_generate->count].matrix;
-
-			//set matrix
-			matrix[0]=rot[0];
-			matrix[1]=rot[4];
-			matrix[2]=rot[8];
-			matrix[3]=0;
-			matrix[4]=rot[1];
-			matrix[5]=rot[5];
-			matrix[6]=rot[9];
-			matrix[7]=0;
-			matrix[8]=rot[2];
-			matrix[9]=rot[6];
-			matrix[10]=rot[10];
-			matrix[11]=0;
-			matrix[12]=pos[0];
-			matrix[13]=pos[1];
-			matrix[14]=pos[2];
-			matrix[15]=1;
-
-			//set what to render
-			buffer_generate->list[buffer_generate->count].model = b->model;
-
-			//set object owning this component:
-			buffer_generate->list[buffer_generate->count].object = b->object_parent;
-
-			//increase counter
-			++(buffer_generate->count);
-		}
+			Add_Element(generate, b->model, b, b->object_parent,
+					dBodyGetPosition(b->body_id), dBodyGetQuaternion(b->body_id));
 	}
 
-	//mark as updated
-	buffer_generate->updated=true;
+	//number this list (newer than the last one)
+	generate->frame = ++frame_count;
+	generate->time = Clock_Get();
 
-	//move...
-	SDL_mutexP(interface_thread.render_list_mutex);
-	list_buffer *p=buffer_switch;
-	buffer_switch=buffer_generate;
-	buffer_generate=p;
-	SDL_mutexV(interface_thread.render_list_mutex);
+	Publish_List();
 }
  
 //just to make it possible to check from outside
 bool Render_List_Updated()
 {
+	//just a hint (acquire is done when switching)
+	return __atomic_load_n(&buffer_switch, __ATOMIC_RELAXED) & BUFFER_UPDATED;
+}
+
+//self-check of the buffer switching: a thread publishes lists as fast as it
+//can (like the simulation), while they are grabbed here (like the interface).
+//All elements of a list got its frame number, so a list grabbed while still
+//being written, or older than the last one, is detected
+static unsigned int check_lists;
+
+static int Check_Publish(void *d)
+{
+	for (unsigned int frame=1; frame<=check_lists; ++frame)
+	{
+		list_buffer *generate = &buffers[buffer_generate];
+		dReal pos[3] = {(dReal)frame, (dReal)frame, (dReal)frame};
+		dReal rot[4] = {(dReal)frame, (dReal)frame, (dReal)frame, (dReal)frame};
+
+		//(varying length, so buffers also gets resized sometimes)
+		generate->count=0;
+		size_t count = frame%(INITIAL_RENDER_LIST_SIZE*2);
+		for (size_t i=0; i<count; ++i)
+			Add_Element(generate, NULL, NULL, NULL, pos, rot);
+
+		generate->frame = frame;
+		Publish_List();
+	}
+
+	return 0;
+}
+
+static bool Check_List(list_buffer *buffer, unsigned int frame)
+{
+	if (buffer->frame != frame || buffer->count != frame%(INITIAL_RENDER_LIST_SIZE*2))
+		return false;
+
+	for (size_t i=0; i<buffer->count; ++i)
+	{
+		list_element *e = &buffer->list[i];
+		if (	e->pos[0] != frame || e->pos[2] != frame ||
+			e->rot[0] != frame || e->rot[3] != frame)
+			return false;
+	}
+
+	return true;
+}
+
+//(only when neither simulation nor interface is running)
+bool Render_List_Self_Check(unsigned int lists)
+{
+	Log_Add(1, "Checking render list buffering with %u lists", lists);
+
+	check_lists = lists;
+	SDL_Thread *thread = SDL_CreateThread(Check_Publish, NULL);
+	if (!thread)
+	{
+		Log_Add(-1, "Could not create thread for checking render list");
+		return false;
+	}
+
+	unsigned int last = 0, before_last = 0, grabbed = 0, errors = 0;
+	while (last < lists)
+	{
+		//(busy-waiting, to grab as often as possible)
+		if (!Render_List_Updated())
+			continue;
+
+		//lists kept by interface must not have been touched since grabbed
+		bool ok =	(!last || Check_List(&buffers[buffer_render], last)) &&
+				(!before_last || Check_List(&buffers[buffer_previous], before_last));
+
+		Grab_List();
+		++grabbed;
+
+		//and the new list must be newer, and complete
+		list_buffer *render = &buffers[buffer_render];
+		ok = ok && render->frame > last && Check_List(render, render->frame);
+
+		if (!ok)
+		{
+			//(only details of first)
+			if (!errors)
+				Log_Add(-1, "Render list check got broken list (frame %u after %u, %u elements)",
+						render->frame, last, (unsigned int)render->count);
+			++errors;
+		}
+
+		before_last = last;
+		last = render->frame;
+	}
 
-	if (buffer_switch->updated)
-		return true;
-	return false;
+	SDL_WaitThread(thread, NULL);
+	Render_List_Clear();
+
+	if (errors)
+	{
+		Log_Add(-1, "Render list check failed: %u of %u grabbed lists broken", errors, grabbed);
+		return false;
+	}
+
+	Log_Add(1, "Render list check passed (grabbed %u of %u lists)", grabbed, lists);
+	return true;
 }
 
 
+//
+//interpolation:
+//
+
+//how far from previous to render list to draw (1.0=only render list)
+float interpolation = 1.0;
+
+//camera (possibly interpolated)
+float camera_pos[3];
+float camera_rot[9];
+Object *camera_hide;
+float camera_matrix[16]; //for opengl
+
+//normalize vector (3 floats, with given stride in array)
+static void Normalize(float *v, int stride)
+{
+	float l = sqrtf(v[0]*v[0]+v[stride]*v[stride]+v[2*stride]*v[2*stride]);
+	if (l > 0.0)
+	{
+		v[0]/=l;
+		v[stride]/=l;
+		v[2*stride]/=l;
+	}
+}
+
+//spherical linear interpolation of quaternions
+static void Slerp(float *result, const float *q0, const float *q1, float t)
+{
+	float dot = q0[0]*q1[0]+q0[1]*q1[1]+q0[2]*q1[2]+q0[3]*q1[3];
+
+	//q and -q is the same rotation, take the shortest way
+	float sign = 1.0;
+	if (dot < 0.0)
+	{
+		dot = -dot;
+		sign = -1.0;
+	}
+
+	float k0, k1;
+	if (dot > 0.9995) //almost the same, linear is good enough (and avoids 0/0)
+	{
+		k0 = 1.0-t;
+		k1 = t;
+	}
+	else
+	{
+		float angle = acosf(dot);
+		float s = sinf(angle);
+		k0 = sinf((1.0-t)*angle)/s;
+		k1 = sinf(t*angle)/s;
+	}
+
+	k1*=sign;
+	for (int i=0; i<4; ++i)
+		result[i] = k0*q0[i]+k1*q1[i];
+
+	//(only needed for linear case, but cheap)
+	float l = sqrtf(result[0]*result[0]+result[1]*result[1]+result[2]*result[2]+result[3]*result[3]);
+	for (int i=0; i<4; ++i)
+		result[i]/=l;
+}
+
+//build opengl matrix from position and quaternion (w,x,y,z)
+static void Build_Matrix(float *matrix, const float *pos, const float *q)
+{
+	float w=q[0], x=q[1], y=q[2], z=q[3];
+
+	matrix[0]=1.0-2.0*(y*y+z*z);
+	matrix[1]=2.0*(x*y+w*z);
+	matrix[2]=2.0*(x*z-w*y);
+	matrix[3]=0;
+	matrix[4]=2.0*(x*y-w*z);
+	matrix[5]=1.0-2.0*(x*x+z*z);
+	matrix[6]=2.0*(y*z+w*x);
+	matrix[7]=0;
+	matrix[8]=2.0*(x*z+w*y);
+	matrix[9]=2.0*(y*z-w*x);
+	matrix[10]=1.0-2.0*(x*x+y*y);
+	matrix[11]=0;
+	matrix[12]=pos[0];
+	matrix[13]=pos[1];
+	matrix[14]=pos[2];
+	matrix[15]=1;
+}
+
+//for splitting tree nodes: compares element positions along axis
+struct Static_Compare
+{
+	const static_element *elements;
+	int axis;
+
+	bool operator()(unsigned int a, unsigned int b) const
+	{
+		return elements[a].matrix[12+axis] < elements[b].matrix[12+axis];
+	}
+};
+
+//create node for elements, and split into children until small enough
+static void Build_Node(std::vector<static_node> *nodes, const static_element *elements,
+		unsigned int *index, unsigned int first, unsigned int count)
+{
+	//bounding box of spheres and of positions
+	float min[3], max[3], pmin[3], pmax[3];
+	for (int a=0; a<3; ++a)
+	{
+		min[a] = pmin[a] = HUGE_VALF;
+		max[a] = pmax[a] = -HUGE_VALF;
+	}
+
+	for (unsigned int i=first; i<first+count; ++i)
+	{
+		const static_element *e = &elements[index[i]];
+		for (int a=0; a<3; ++a)
+		{
+			float p = e->matrix[12+a];
+			if (p-e->radius < min[a]) min[a] = p-e->radius;
+			if (p+e->radius > max[a]) max[a] = p+e->radius;
+			if (p < pmin[a]) pmin[a] = p;
+			if (p > pmax[a]) pmax[a] = p;
+		}
+	}
+
+	//sphere around box (contains all spheres)
+	static_node node;
+	float d[3];
+	for (int a=0; a<3; ++a)
+	{
+		node.center[a] = (min[a]+max[a])/2.0;
+		d[a] = max[a]-min[a];
+	}
+	node.radius = sqrtf(d[0]*d[0]+d[1]*d[1]+d[2]*d[2])/2.0;
+	node.first = first;
+	node.count = count;
+	node.second = 0;
+
+	size_t n = nodes->size();
+	nodes->push_back(node);
+
+	if (count <= RENDER_TREE_LEAF_SIZE)
+		return;
+
+	//split in middle along longest side
+	Static_Compare compare;
+	compare.elements = elements;
+	compare.axis = 0;
+	for (int a=1; a<3; ++a)
+		if (pmax[a]-pmin[a] > pmax[compare.axis]-pmin[compare.axis])
+			compare.axis = a;
+
+	unsigned int half = count/2;
+	std::nth_element(index+first, index+first+half, index+first+count, compare);
+
+	Build_Node(nodes, elements, index, first, half);
+	(*nodes)[n].second = nodes->size();
+	Build_Node(nodes, elements, index, first+half, count-half);
+}
+
+void Render_List_Build()
+{
+	//find all static geoms to render
+	std::vector<static_element> elements;
+	std::vector<Geom*> geoms;
+
+	dQuaternion quat;
+	float pos[3], rot[4];
+	Geom *g;
+	size_t count = Geom::pool.size();
+	for (size_t i=0; i<count; ++i)
+	{
+		g = Geom::pool[i];
+		if (g->model && !dGeomGetBody(g->geom_id))
+		{
+			const dReal *p = dGeomGetPosition(g->geom_id);
+			dGeomGetQuaternion(g->geom_id, quat);
+			for (int j=0; j<3; ++j)
+				pos[j] = p[j];
+			for (int j=0; j<4; ++j)
+				rot[j] = quat[j];
+
+			static_element element;
+			Build_Matrix(element.matrix, pos, rot);
+			element.radius = g->model->radius;
+			element.model = g->model;
+			element.object = g->object_parent;
+			element.last_frame = UINT_MAX;
+
+			elements.push_back(element);
+			geoms.push_back(g);
+		}
+	}
+
+	if (elements.empty())
+		return;
+
+	//build tree (sorts indices of elements)
+	static_count = elements.size();
+	unsigned int *index = new unsigned int[static_count];
+	for (size_t i=0; i<static_count; ++i)
+		index[i] = i;
+
+	std::vector<static_node> nodes;
+	Build_Node(&nodes, &elements[0], index, 0, static_count);
+
+	//store elements in order of tree
+	static_elements = new static_element[static_count];
+	for (size_t i=0; i<static_count; ++i)
+	{
+		static_elements[i] = elements[index[i]];
+		geoms[index[i]]->render_static = i;
+	}
+
+	static_node_count = nodes.size();
+	static_nodes = new static_node[static_node_count];
+	memcpy(static_nodes, &nodes[0], sizeof(static_node)*static_node_count);
+
+	delete[] index;
+
+	Log_Add(2, "Static render tree: %u geoms in %u nodes",
+			(unsigned int)static_count, (unsigned int)static_node_count);
+}
+
+//(ode_mutex locked: changes geom and reads frame_count)
+void Render_List_Remove_Static(Geom *geom)
+{
+	if (geom->render_static == -1)
+		return;
+
+	//lists after this one will render it (if not removed)
+	__atomic_store_n(&static_elements[geom->render_static].last_frame, frame_count, __ATOMIC_RELAXED);
+	geom->render_static = -1;
+}
+
 //check if new data+matrix
 void Render_List_Prepare()
 {
 	//only if anything to do
 	if (Render_List_Updated())
 	{
-		SDL_mutexP(interface_thread.render_list_mutex);
-		list_buffer *p=buffer_switch;
-		buffer_switch=buffer_render; //old buffer, not needed
-		buffer_render= p;
-		SDL_mutexV(interface_thread.render_list_mutex);
-
-		//build matrix for camera projection:
-		//rotation (right, up, forward)
-		float *pos = buffer_render->camera_pos;
-		float *rot = buffer_render->camera_rot;
-		float matrix[16];
-		//m0-m3
-		matrix[0]=rot[0]; matrix[1]=rot[2]; matrix[2]=-rot[1]; matrix[3]=0.0;
-		//m4-m7
-		matrix[4]=rot[3]; matrix[5]=rot[5]; matrix[6]=-rot[4]; matrix[7]=0.0;
-		//m4-m7
-		matrix[8]=rot[6]; matrix[9]=rot[8]; matrix[10]=-rot[7]; matrix[11]=0.0;
-
-		//m12-m14, translation
-		matrix[12]=-matrix[0]*pos[0]-matrix[4]*pos[1]-matrix[8]*pos[2];
-		matrix[13]=-matrix[1]*pos[0]-matrix[5]*pos[1]-matrix[9]*pos[2];
-		matrix[14]=-matrix[2]*pos[0]-matrix[6]*pos[1]-matrix[10]*pos[2];
-
-		//m15
-		matrix[15]=1.0;
-
-		//overwrite current matrix
-		glLoadMatrixf(matrix);
+		unsigned int old_frame = buffers[buffer_render].frame;
+		Grab_List();
+
+		//should never happen (unless something is very wrong)
+		if (buffers[buffer_render].frame < old_frame)
+			Log_Add(-1, "Render list went back in time (frame %u to %u)!",
+					old_frame, buffers[buffer_render].frame);
 	}
+
+	list_buffer *render = &buffers[buffer_render];
+	list_buffer *previous = &buffers[buffer_previous];
+
+	//lists are rendered one step late: when the newest list was generated,
+	//the previous list is rendered, and moving towards the newest one
+	interpolation = 1.0;
+	if (internal.interpolation && previous->time && render->time > previous->time)
+	{
+		Uint64 now = Clock_Get();
+
+		if (now <= render->time)
+			interpolation = 0.0;
+		else
+		{
+			interpolation = (float)(now-render->time) / (float)(render->time-previous->time);
+			if (interpolation > 1.0) //(new list should arrive any moment now)
+				interpolation = 1.0;
+		}
+	}
+
+	//camera
+	camera_hide = render->camera_hide;
+	if (interpolation == 1.0)
+	{
+		memcpy(camera_pos, render->camera_pos, sizeof(float)*3);
+		memcpy(camera_rot, render->camera_rot, sizeof(float)*9);
+	}
+	else
+	{
+		float a = 1.0-interpolation, b = interpolation;
+		for (int i=0; i<3; ++i)
+			camera_pos[i] = a*previous->camera_pos[i] + b*render->camera_pos[i];
+		for (int i=0; i<9; ++i)
+			camera_rot[i] = a*previous->camera_rot[i] + b*render->camera_rot[i];
+
+		//make orthonormal again (columns: right, dir, up):
+		//normalize dir
+		float *right=camera_rot, *dir=camera_rot+1, *up=camera_rot+2;
+		Normalize(dir, 3);
+
+		//remove dir from right, normalize
+		float d = right[0]*dir[0]+right[3]*dir[3]+right[6]*dir[6];
+		right[0]-=d*dir[0]; right[3]-=d*dir[3]; right[6]-=d*dir[6];
+		Normalize(right, 3);
+
+		//remove dir and right from up, normalize
+		d = up[0]*dir[0]+up[3]*dir[3]+up[6]*dir[6];
+		up[0]-=d*dir[0]; up[3]-=d*dir[3]; up[6]-=d*dir[6];
+		d = up[0]*right[0]+up[3]*right[3]+up[6]*right[6];
+		up[0]-=d*right[0]; up[3]-=d*right[3]; up[6]-=d*right[6];
+		Normalize(up, 3);
+	}
+
+	//build matrix for camera projection:
+	//rotation (right, up, forward)
+	float *pos = camera_pos;
+	float *rot = camera_rot;
+	float *matrix = camera_matrix;
+	//m0-m3
+	matrix[0]=rot[0]; matrix[1]=rot[2]; matrix[2]=-rot[1]; matrix[3]=0.0;
+	//m4-m7
+	matrix[4]=rot[3]; matrix[5]=rot[5]; matrix[6]=-rot[4]; matrix[7]=0.0;
+	//m4-m7
+	matrix[8]=rot[6]; matrix[9]=rot[8]; matrix[10]=-rot[7]; matrix[11]=0.0;
+
+	//m12-m14, translation
+	matrix[12]=-matrix[0]*pos[0]-matrix[4]*pos[1]-matrix[8]*pos[2];
+	matrix[13]=-matrix[1]*pos[0]-matrix[5]*pos[1]-matrix[9]*pos[2];
+	matrix[14]=-matrix[2]*pos[0]-matrix[6]*pos[1]-matrix[10]*pos[2];
+
+	//m15
+	matrix[15]=1.0;
+
+	//overwrite current matrix
+	glLoadMatrixf(matrix);
 }
 
 //updated on resizing, needed here:
 extern float view_angle_rate_x, view_angle_rate_y;
 
+//check if sphere might be visible from current camera:
+//0=not visible, 1=partly visible, 2=completely inside view
+static int Visible(const float *center, float radius)
+{
+	//model pos relative to camera
+	float pos[3] = {center[0]-camera_pos[0], center[1]-camera_pos[1], center[2]-camera_pos[2]};
+
+	//position of camera relative to camera/screen
+	//this is really just a matrix multiplication, but we separate each line into a variable
+	float right_proj = pos[0]*camera_rot[0]+pos[1]*camera_rot[3]+pos[2]*camera_rot[6];
+	float dir_proj = pos[0]*camera_rot[1]+pos[1]*camera_rot[4]+pos[2]*camera_rot[7];
+	float up_proj = pos[0]*camera_rot[2]+pos[1]*camera_rot[5]+pos[2]*camera_rot[8];
+
+	//behind close clipping or beyound far clipping (compensates for radius)
+	if (dir_proj < track.clipping[0]-radius || dir_proj > track.clipping[1]+radius)
+		return 0;
+
+	//right/left, above/below
+	right_proj = fabsf(right_proj);
+	up_proj = fabsf(up_proj);
+	if (	right_proj > view_angle_rate_x*(dir_proj+radius) + radius	||
+		up_proj > view_angle_rate_y*(dir_proj+radius) + radius		)
+		return 0;
+
+	//completely inside? (sides are checked a bit too strictly, which is fine)
+	if (	dir_proj-radius >= track.clipping[0] && dir_proj+radius <= track.clipping[1]	&&
+		right_proj + radius*(1.0+view_angle_rate_x) <= view_angle_rate_x*dir_proj	&&
+		up_proj + radius*(1.0+view_angle_rate_y) <= view_angle_rate_y*dir_proj		)
+		return 2;
+
+	return 1;
+}
+
+//models to draw this frame (kept between frames to avoid allocations)
+struct visible_element
+{
+	float matrix[16]; //modelview (camera*model)
+	Model_Draw *model;
+};
+
+std::vector<visible_element> visible_list;
+
+//add model to list of visible
+static void Add_Visible(const float *matrix, Model_Draw *model)
+{
+	visible_list.resize(visible_list.size()+1);
+	visible_element *visible = &visible_list.back();
+
+	//(column-major, like opengl)
+	const float *c = camera_matrix;
+	for (int col=0; col<16; col+=4)
+		for (int row=0; row<4; ++row)
+			visible->matrix[col+row] =	c[row]*matrix[col]	+ c[4+row]*matrix[col+1] +
+							c[8+row]*matrix[col+2]	+ c[12+row]*matrix[col+3];
+
+	visible->model = model;
+}
+
+//culling statistics (for race)
+unsigned int cull_frames = 0;
+unsigned long cull_visible = 0;
+unsigned long cull_culled = 0;
+unsigned long cull_tests = 0;
+Uint64 cull_time = 0;
+Uint64 cull_time_max = 0;
+
+//find visible models in tree (unless moved to render list at this frame)
+static void Cull_Static(unsigned int frame, unsigned long *culled, unsigned long *tests)
+{
+	if (!static_node_count)
+		return;
+
+	//nodes left to check (enough for any depth possible)
+	unsigned int stack[64];
+	int depth = 0;
+	stack[depth++] = 0;
+
+	while (depth)
+	{
+		static_node *node = &static_nodes[stack[--depth]];
+
+		++*tests;
+		int visible = Visible(node->center, node->radius);
+
+		if (!visible)
+		{
+			*culled+=node->count;
+			continue;
+		}
+
+		//partly visible, check children (first is right after this)
+		if (visible == 1 && node->second)
+		{
+			stack[depth++] = node->second;
+			stack[depth++] = node-static_nodes+1;
+			continue;
+		}
+
+		//leaf, or everything visible
+		static_element *element = static_elements+node->first;
+		static_element *end = element+node->count;
+		for (; element != end; ++element)
+		{
+			//moved or removed since this list
+			if (frame > __atomic_load_n(&element->last_frame, __ATOMIC_RELAXED))
+				continue;
+
+			if (element->object == camera_hide)
+			{
+				++*culled;
+				continue;
+			}
+
+			if (visible == 1)
+			{
+				++*tests;
+				if (!Visible(element->matrix+12, element->radius))
+				{
+					++*culled;
+					continue;
+				}
+			}
+
+			Add_Visible(element->matrix, element->model);
+		}
+	}
+}
+
 //for setting up buffers (attribute pointers)
 #define BUFFER_OFFSET(i) ((char *)NULL + (i))
 
+//one draw call: material of visible model
+struct draw_element
+{
+	GLuint vbo, ibo; //(index buffer always the same for same vbo)
+	bool compact; //(always the same for same vbo)
+	const GLfloat *texture_matrix; //(NULL if not compact)
+	GLuint texture;
+	const Material_Float *material;
+	unsigned int visible; //index in visible list
+	unsigned int start, size; //range in index buffer
+};
+
+std::vector<draw_element> draw_list;
+std::vector<float> draw_matrices; //(in draw order, for instancing)
+
+//draw calls are sorted by key: (most expensive) state changes first, then
+//index in draw list. The state bits are only used for grouping (and it is
+//fine if different buffers/textures/materials share the same bits)
+#define DRAW_KEY_INDEX 24 //bits for index
+std::vector<Uint64> draw_keys, draw_keys_tmp;
+
+static Uint64 Draw_Key(const draw_element *draw, size_t index)
+{
+	return	((Uint64)(draw->vbo&0xfff) << 52) | ((Uint64)(draw->texture&0x3fff) << 38) |
+		((Uint64)(((size_t)draw->material/sizeof(Material_Float))&0x3fff) << DRAW_KEY_INDEX) |
+		index;
+}
+
+//radix sort of keys, only by state bits (a byte at a time, keeping the order
+//of keys with the same byte, so index order is kept within same state)
+static void Sort_Keys(std::vector<Uint64> *keys, std::vector<Uint64> *tmp)
+{
+	size_t n = keys->size();
+	if (!n)
+		return;
+
+	tmp->resize(n);
+	Uint64 *src = &(*keys)[0], *dst = &(*tmp)[0], *swap;
+	size_t count[256], offset;
+
+	for (int shift=DRAW_KEY_INDEX; shift<64; shift+=8)
+	{
+		memset(count, 0, sizeof(count));
+		for (size_t i=0; i<n; ++i)
+			++count[(src[i]>>shift)&0xff];
+
+		//all the same, nothing to sort
+		if (count[(src[0]>>shift)&0xff] == n)
+			continue;
+
+		offset = 0;
+		for (int b=0; b<256; ++b)
+		{
+			size_t c = count[b];
+			count[b] = offset;
+			offset += c;
+		}
+
+		for (size_t i=0; i<n; ++i)
+			dst[count[(src[i]>>shift)&0xff]++] = src[i];
+
+		swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	if (src != &(*keys)[0])
+		memcpy(&(*keys)[0], src, sizeof(Uint64)*n);
+}
+
+//opengl state set by render list, to skip redundant changes (also between
+//frames, unless reset when someone else changed the state)
+struct gl_state
+{
+	bool valid; //rendering options configured
+	bool texture_enabled;
+	bool material_valid;
+	Material_Float material;
+	GLuint vbo, texture; //bound
+	const GLfloat *texture_matrix; //loaded (NULL if identity)
+};
+
+gl_state state = {false, false, false, {{0,0,0,0}, {0,0,0,0}, {0,0,0,0}, {0,0,0,0}, 0}, 0, 0, NULL};
+
+void Render_List_Reset_State()
+{
+	state.valid = false;
+	state.material_valid = false;
+}
+
+//drawing statistics (for race)
+unsigned long draw_calls = 0;
+unsigned long draw_instanced = 0;
+unsigned long draw_matrix_changes = 0;
+unsigned long draw_vbos = 0;
+unsigned long draw_textures = 0;
+unsigned long draw_materials = 0;
+
+//set material property (if not already)
+static void Set_Material(GLenum pname, GLfloat *cached, const GLfloat *value, int size)
+{
+	if (state.material_valid && !memcmp(cached, value, sizeof(GLfloat)*size))
+		return;
+
+	memcpy(cached, value, sizeof(GLfloat)*size);
+	if (size == 1)
+		glMaterialf(GL_FRONT, pname, *value);
+	else
+		glMaterialfv(GL_FRONT, pname, value);
+	++draw_materials;
+}
+
 void Render_List_Render()
 {
 	//pointers to data
-	size_t *count=&(buffer_render->count);
-	list_element *list=buffer_render->list;
-	float *camera_pos=buffer_render->camera_pos;
-	float *camera_rot=buffer_render->camera_rot;
-	Object *camera_hide=buffer_render->camera_hide;
+	list_buffer *render=&buffers[buffer_render];
+	size_t *count=&(render->count);
+	list_element *list=render->list;
+
+	//for interpolation
+	list_element *previous=buffers[buffer_previous].list;
+	size_t previous_count=buffers[buffer_previous].count;
+	float pos_interpolated[3], rot_interpolated[4];
 
 	//variables/pointers
 	unsigned int m_loop;
 	Model_Draw *model;
-	Material_Float *material;
-	float *matrix;
+	float matrix[16];
 	Model_Draw::Material *materials;
 	unsigned int material_count;
-	float radius;
 
-	GLuint bound_vbo = 0; //keep track of which vbo is bound
-	GLuint texture; //which texture to use
-	GLuint bound_texture = 0; //keep track of which texture is bound
-	bool texture_enabled = true; //keep track of if textures enabled or not
+	//configure rendering options (if not already):
+	if (!state.valid)
+	{
+		//enable lighting
+		glEnable (GL_LIGHT0);
+		glEnable (GL_LIGHTING);
+
+		glShadeModel (GL_SMOOTH); //by default, can be changed
+
+		//glClearDepth (1.0); pointless to define this?
+
+		//depth testing (proper overlapping)
+		glDepthFunc (GL_LESS);
+		glEnable (GL_DEPTH_TEST);
+
+		//texture
+		glEnable (GL_TEXTURE_2D);
+		state.texture_enabled = true;
+
+		//enable anti aliasing?
+		if (internal.msaa)
+			glEnable(GL_MULTISAMPLE);
+
+		//
+		//options:
+		//
+
+		//culling of back faces
+		if (internal.culling)
+			glEnable(GL_CULL_FACE);
 
-	//data needed to eliminate models not visible by camera:
-	float dir_proj, up_proj, right_proj; //model position relative to camera
-	float dir_min, dir_max, up_max, right_max; //limit for what camera can render
-	float pos[3]; //relative pos
+		//enable fog?
+		if (track.fog_mode)
+		{
+			glEnable(GL_FOG);
 
-	//configure rendering options:
+			if (track.fog_mode == 1)
+			{
+				glFogi(GL_FOG_MODE, GL_LINEAR);
+				glFogf(GL_FOG_START, track.fog_range[0]);
+				glFogf(GL_FOG_END, track.fog_range[1]);
+			}
+			else
+			{
+				glFogi(GL_FOG_MODE, track.fog_mode==2? GL_EXP: GL_EXP2);
+				glFogf(GL_FOG_DENSITY, track.fog_density);
+			}
+		}
 
-	//enable lighting
-	glEnable (GL_LIGHT0);
-	glEnable (GL_LIGHTING);
 
-	glShadeModel (GL_SMOOTH); //by default, can be changed
+		//enable rendering of vertices and normals
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glEnableClientState(GL_NORMAL_ARRAY);
+		glDisableClientState(GL_COLOR_ARRAY);
 
-	//glClearDepth (1.0); pointless to define this?
+		//(compact vertices got scaled positions and not quite unit normals)
+		glEnable(GL_NORMALIZE);
 
-	//depth testing (proper overlapping)
-	glDepthFunc (GL_LESS);
-	glEnable (GL_DEPTH_TEST);
+		//NOTE: new opengl vbo rendering commands (2.0 I think). For compatibility lets stick to 1.5 instead
+		//glEnableVertexAttribArray(0);
+		//glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Model_Draw::Vertex), (BUFFER_OFFSET(0)));
+		//glEnableVertexAttribArray(1);
+		//glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Model_Draw::Vertex), BUFFER_OFFSET(sizeof(float)*3));
 
-	//texture
-	glEnable (GL_TEXTURE_2D);
+		state.valid = true;
+	}
 
-	//enable anti aliasing?
-	if (internal.msaa)
-		glEnable(GL_MULTISAMPLE);
+	//(buffers and textures are also bound when loading, so never trust these)
+	state.vbo = 0;
+	state.texture = 0;
 
 	//
-	//options:
+	//find what is visible from camera:
 	//
+	Uint64 cull_start = Clock_Get();
+	unsigned long culled = 0, tests = 0;
+	visible_list.clear();
 
-	//culling of back faces
-	if (internal.culling)
-		glEnable(GL_CULL_FACE);
+	//static geoms
+	Cull_Static(render->frame, &culled, &tests);
 
-	//enable fog?
-	if (track.fog_mode)
+	//and everything in render list
+	for (size_t i=0; i<(*count); ++i)
 	{
-		glEnable(GL_FOG);
+		model = list[i].model;
 
-		if (track.fog_mode == 1)
+		//hidden for this camera
+		if (list[i].object == camera_hide)
 		{
-			glFogi(GL_FOG_MODE, GL_LINEAR);
-			glFogf(GL_FOG_START, track.fog_range[0]);
-			glFogf(GL_FOG_END, track.fog_range[1]);
+			++culled;
+			continue;
 		}
-		else
+
+		//interpolate from same component in previous list (if any)
+		if (	interpolation < 1.0 && i < previous_count		&&
+			previous[i].component == list[i].component		&&
+			previous[i].model == model				)
 		{
-			glFogi(GL_FOG_MODE, track.fog_mode==2? GL_EXP: GL_EXP2);
-			glFogf(GL_FOG_DENSITY, track.fog_density);
+			float a = 1.0-interpolation, b = interpolation;
+			pos_interpolated[0] = a*previous[i].pos[0] + b*list[i].pos[0];
+			pos_interpolated[1] = a*previous[i].pos[1] + b*list[i].pos[1];
+			pos_interpolated[2] = a*previous[i].pos[2] + b*list[i].pos[2];
+			Slerp(rot_interpolated, previous[i].rot, list[i].rot, b);
+			Build_Matrix(matrix, pos_interpolated, rot_interpolated);
 		}
-	}
+		else
+			Build_Matrix(matrix, list[i].pos, list[i].rot);
 
+		++tests;
+		if (!Visible(matrix+12, model->radius))
+		{
+			++culled;
+			continue;
+		}
 
-	//enable rendering of vertices and normals
-	glEnableClientState(GL_VERTEX_ARRAY);
-	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-	glEnableClientState(GL_NORMAL_ARRAY);
-	glDisableClientState(GL_COLOR_ARRAY);
+		Add_Visible(matrix, model);
+	}
 
-	//NOTE: new opengl vbo rendering commands (2.0 I think). For compatibility lets stick to 1.5 instead
-	//glEnableVertexAttribArray(0);
-	//glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Model_Draw::Vertex), (BUFFER_OFFSET(0)));
-	//glEnableVertexAttribArray(1);
-	//glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Model_Draw::Vertex), BUFFER_OFFSET(sizeof(float)*3));
+	//statistics
+	Uint64 time = Clock_Get()-cull_start;
+	++cull_frames;
+	cull_visible += visible_list.size();
+	cull_culled += culled;
+	cull_tests += tests;
+	cull_time += time;
+	if (time > cull_time_max)
+		cull_time_max = time;
 
-	for (size_t i=0; i<(*count); ++i)
+	//
+	//sort draw calls by state (unless disabled):
+	//
+	draw_list.clear();
+	draw_keys.clear();
+	for (size_t i=0; i<visible_list.size(); ++i)
 	{
-		//for cleaner code, set pointers:
-		model = list[i].model;
-		matrix = list[i].matrix;
+		model = visible_list[i].model;
 		materials = model->materials;
 		material_count = model->material_count;
-		radius = model->radius;
-
-		//check if object is not visible from current camera:
-		//model pos relative to camera
-		pos[0] = matrix[12]-camera_pos[0];
-		pos[1] = matrix[13]-camera_pos[1];
-		pos[2] = matrix[14]-camera_pos[2];
-
-		//position of camera relative to camera/screen
-		//this is really just a matrix multiplication, but we separate each line into a variable
-		right_proj = pos[0]*camera_rot[0]+pos[1]*camera_rot[3]+pos[2]*camera_rot[6];
-		dir_proj = pos[0]*camera_rot[1]+pos[1]*camera_rot[4]+pos[2]*camera_rot[7];
-		up_proj = pos[0]*camera_rot[2]+pos[1]*camera_rot[5]+pos[2]*camera_rot[8];
-
-		//limit of what range is rendered (compensates for "radius" of model that might still be seen)
-		dir_min = track.clipping[0] - radius; //behind close clipping
-		dir_max = track.clipping[1] + radius; //beyound far clipping
-		right_max = view_angle_rate_x*(dir_proj+radius) + radius; //right/left
-		up_max = view_angle_rate_y*(dir_proj+radius) + radius; //above/below
-
-		//check if visible (or hidden for this camera):
-		if (	(list[i].object == camera_hide)				||
-			(dir_proj > dir_max)	|| (dir_proj < dir_min)		||
-			(right_proj > right_max)|| (-right_proj > right_max)	||
-			(up_proj > up_max)	|| (-up_proj > up_max)		)
-			continue;
-		//
-		
-		glPushMatrix();
-
-			glMultMatrixf (matrix);
 
-			if (model->vbo_id != bound_vbo)
+		//compact vertices: scale and offset position
+		if (model->compact)
+		{
+			float *m = visible_list[i].matrix;
+			const float *p = model->compact_position;
+			for (int row=0; row<4; ++row)
 			{
-				//bind and configure the new vbo
-				glBindBuffer(GL_ARRAY_BUFFER, model->vbo_id);
+				m[12+row] += m[row]*p[0] + m[4+row]*p[1] + m[8+row]*p[2];
+				m[row] *= p[3];
+				m[4+row] *= p[3];
+				m[8+row] *= p[3];
+			}
+		}
 
-				//configure attributes
+		for (m_loop=0; m_loop<material_count; ++m_loop)
+		{
+			draw_element draw;
+			draw.vbo = model->vbo_id;
+			draw.ibo = model->ibo_id;
+			draw.compact = model->compact;
+			draw.texture_matrix = model->compact? model->texture_matrix: NULL;
+			draw.texture = materials[m_loop].diffusetex;
+			draw.material = &materials[m_loop].material;
+			draw.visible = i;
+			draw.start = materials[m_loop].start;
+			draw.size = materials[m_loop].size;
+			draw_list.push_back(draw);
+			draw_keys.push_back(Draw_Key(&draw, draw_list.size()-1));
+		}
+	}
+
+	//(then only keep index, or just draw unsorted if disabled or too many to index)
+	size_t draw_count = draw_list.size();
+	if (internal.sort_draws && draw_count <= (1<<DRAW_KEY_INDEX))
+	{
+		Sort_Keys(&draw_keys, &draw_keys_tmp);
+		for (size_t i=0; i<draw_count; ++i)
+			draw_keys[i] &= (1<<DRAW_KEY_INDEX)-1;
+	}
+	else
+		for (size_t i=0; i<draw_count; ++i)
+			draw_keys[i] = i;
+
+	//with instancing, all matrices are sent at once
+	if (instancing)
+	{
+		draw_matrices.resize(16*draw_count);
+		for (size_t i=0; i<draw_count; ++i)
+			memcpy(&draw_matrices[16*i], visible_list[draw_list[draw_keys[i]].visible].matrix,
+					sizeof(float)*16);
+
+		Instancing_Begin(draw_count? &draw_matrices[0]: NULL, draw_count);
+		Instancing_Texture(state.texture_enabled);
+	}
+
+	//
+	//draw:
+	//
+	unsigned int matrix_visible = UINT_MAX; //which matrix is loaded
+	const Material_Float *last_material = NULL; //(might be modified between frames)
+	draw_element *draw;
+	size_t group;
+	for (size_t i=0; i<draw_count; i+=group)
+	{
+		draw = &draw_list[draw_keys[i]];
+
+		//with instancing: all following copies of this model material
+		group = 1;
+		if (instancing)
+			while (i+group < draw_count && draw_list[draw_keys[i+group]].material == draw->material)
+				++group;
+		if (draw->vbo != state.vbo)
+		{
+			//bind and configure the new vbo (and its indices)
+			glBindBuffer(GL_ARRAY_BUFFER, draw->vbo);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, draw->ibo);
+
+			//configure attributes
+			if (draw->compact)
+			{
+				glVertexPointer(3, GL_SHORT, sizeof(Model_Draw::Compact_Vertex), BUFFER_OFFSET(0));
+				glTexCoordPointer(2, GL_SHORT, sizeof(Model_Draw::Compact_Vertex), BUFFER_OFFSET(sizeof(GLshort)*4));
+				glNormalPointer(GL_BYTE, sizeof(Model_Draw::Compact_Vertex), BUFFER_OFFSET(sizeof(GLshort)*6));
+			}
+			else
+			{
 				glVertexPointer(3, GL_FLOAT, sizeof(Model_Draw::Vertex), BUFFER_OFFSET(0));
 				glTexCoordPointer(2, GL_FLOAT, sizeof(Model_Draw::Vertex), BUFFER_OFFSET(sizeof(float)*3));
 				glNormalPointer(GL_FLOAT, sizeof(Model_Draw::Vertex), BUFFER_OFFSET(sizeof(float)*5));
-
-				//indicate this is used now
-				bound_vbo = model->vbo_id;
 			}
 
-			//loop through materials, and draw section(s) of model with this material
-			for (m_loop=0; m_loop< (material_count); ++m_loop)
+			//indicate this is used now
+			state.vbo = draw->vbo;
+			++draw_vbos;
+		}
+
+		//texture enable/disable
+		if (draw->texture)
+		{
+			if (!state.texture_enabled)
+			{
+				glEnable(GL_TEXTURE_2D);
+				if (instancing)
+					Instancing_Texture(true);
+				state.texture_enabled=true;
+				++draw_textures;
+			}
+			if (draw->texture != state.texture)
 			{
-				//pointer for less clutter
-				material = &materials[m_loop].material;
+				glBindTexture(GL_TEXTURE_2D, draw->texture);
+				state.texture=draw->texture;
+				++draw_textures;
+			}
 
-				//texture enable/disable
-				texture = materials[m_loop].diffusetex;
-				if (texture)
-				{
-					if (!texture_enabled)
-					{
-						glEnable(GL_TEXTURE_2D);
-						texture_enabled=true;
-					}
-					if (texture != bound_texture)
-					{
-						glBindTexture(GL_TEXTURE_2D, texture);
-						bound_texture=texture;
-					}
-				}
-				else if (texture_enabled)
-				{
-					glDisable(GL_TEXTURE_2D);
-					texture_enabled=false;
-				}
+			//compact texcoords are scaled by texture matrix
+			if (draw->texture_matrix != state.texture_matrix)
+			{
+				glMatrixMode(GL_TEXTURE);
+				if (draw->texture_matrix)
+					glLoadMatrixf(draw->texture_matrix);
+				else
+					glLoadIdentity();
+				glMatrixMode(GL_MODELVIEW);
+				state.texture_matrix=draw->texture_matrix;
+			}
+		}
+		else if (state.texture_enabled)
+		{
+			glDisable(GL_TEXTURE_2D);
+			if (instancing)
+				Instancing_Texture(false);
+			state.texture_enabled=false;
+			++draw_textures;
+		}
 
-				//set
-				glMaterialfv(GL_FRONT, GL_AMBIENT, material->ambient);
-				glMaterialfv(GL_FRONT, GL_DIFFUSE, material->diffuse);
-				glMaterialfv(GL_FRONT, GL_SPECULAR, material->specular);
-				glMaterialfv(GL_FRONT, GL_EMISSION, material->emission);
-				glMaterialf (GL_FRONT, GL_SHININESS, material->shininess);
+		//set (only what changed, if not the same material as last)
+		const Material_Float *material = draw->material;
+		if (material != last_material)
+		{
+			Set_Material(GL_AMBIENT, state.material.ambient, material->ambient, 4);
+			Set_Material(GL_DIFFUSE, state.material.diffuse, material->diffuse, 4);
+			Set_Material(GL_SPECULAR, state.material.specular, material->specular, 4);
+			Set_Material(GL_EMISSION, state.material.emission, material->emission, 4);
+			Set_Material(GL_SHININESS, &state.material.shininess, &material->shininess, 1);
+			state.material_valid = true;
+			last_material = material;
+		}
 
-				//draw
-				glDrawArrays(GL_TRIANGLES, materials[m_loop].start, materials[m_loop].size);
+		//draw all copies at once
+		if (instancing)
+		{
+			Instancing_Matrices(i);
+			glDrawElementsInstancedARB(GL_TRIANGLES, draw->size, GL_UNSIGNED_INT,
+					BUFFER_OFFSET(sizeof(GLuint)*draw->start), group);
+			draw_instanced += group;
+			++draw_matrix_changes;
+		}
+		else
+		{
+			//position (if other model than last)
+			if (draw->visible != matrix_visible)
+			{
+				glLoadMatrixf(visible_list[draw->visible].matrix);
+				matrix_visible = draw->visible;
+				++draw_matrix_changes;
 			}
 
-		glPopMatrix();
+			glDrawElements(GL_TRIANGLES, draw->size, GL_UNSIGNED_INT,
+					BUFFER_OFFSET(sizeof(GLuint)*draw->start));
+		}
+		++draw_calls;
 	}
 
-	//mark as old
-	buffer_render->updated=false;
+	//back to fixed pipeline/camera
+	if (instancing)
+		Instancing_End();
+	else if (matrix_visible != UINT_MAX)
+		glLoadMatrixf(camera_matrix);
+
+	if (state.texture_matrix)
+	{
+		glMatrixMode(GL_TEXTURE);
+		glLoadIdentity();
+		glMatrixMode(GL_MODELVIEW);
+		state.texture_matrix = NULL;
+	}
+}
+
+void Render_List_Statistics()
+{
+	if (!cull_frames)
+		return;
+
+	Log_Add(1, "Culling per frame: %.1f visible, %.1f culled, %.1f tests, %fms (slowest %fms)",
+			(float)cull_visible/cull_frames, (float)cull_culled/cull_frames,
+			(float)cull_tests/cull_frames, cull_time/1000000.0/cull_frames,
+			cull_time_max/1000000.0);
+	Log_Add(1, "Drawing per frame: %.1f draw calls (%.1f instanced), %.1f matrix, %.1f vbo, %.1f texture and %.1f material changes",
+			(float)draw_calls/cull_frames, (float)draw_instanced/cull_frames,
+			(float)draw_matrix_changes/cull_frames,
+			(float)draw_vbos/cull_frames, (float)draw_textures/cull_frames,
+			(float)draw_materials/cull_frames);
+
+	//next race
+	cull_frames = 0;
+	cull_visible = cull_culled = cull_tests = 0;
+	cull_time = cull_time_max = 0;
+	draw_calls = draw_instanced = draw_matrix_changes = draw_vbos = draw_textures = draw_materials = 0;
 }
 
@@ -25,14 +25,25 @@
 //currently just list for components (geoms+bodies)
 #define INITIAL_RENDER_LIST_SIZE 150
 
-#include <SDL/SDL_mutex.h>
+//static geoms (no body) are kept in a bounding volume tree instead, built
+//when the race starts (elements per leaf in tree)
+#define RENDER_TREE_LEAF_SIZE 4
+
+//lists published and grabbed when checking (--check)
+#define RENDER_LIST_CHECK_LISTS 1000000
+
+class Geom;
 
 //functions
+void Render_List_Build(); //tree of static geoms (before race)
+void Render_List_Remove_Static(Geom *geom); //static geom moved/removed (ode_mutex locked)
 void Render_List_Update(); //create pos/rot list
 bool Render_List_Updated(); //check if new frame
 void Render_List_Prepare(); //switch rendering buffer+set camera matrix
 void Render_List_Render(); //render latest list
-void Render_List_Clear_Interface(); //free buffers ("render" and maybe "switch")
-void Render_List_Clear_Simulation(); //free buffers ("generate" and maybe "switch")
+void Render_List_Reset_State(); //opengl state changed by someone else
+void Render_List_Clear(); //free buffers (when both threads are done)
+void Render_List_Statistics(); //print culling statistics
+bool Render_List_Self_Check(unsigned int lists); //buffer switching (two threads)
 
 #endif
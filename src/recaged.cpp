@@ -34,6 +34,10 @@
 #include "assets/track.hpp"
 #include "assets/model.hpp"
 #include "assets/car.hpp"
+#include "assets/loader.hpp"
+#include "simulation/input_log.hpp"
+#include "simulation/snapshot.hpp"
+#include "interface/render_list.hpp"
 
 
 
@@ -42,6 +46,16 @@
 //
 #include "assets/text_file.hpp"
 
+//number of steps to simulate when headless
+unsigned int headless_steps = 1000;
+bool headless_steps_set = false;
+
+//files for recording or replaying car controls (NULL if not)
+char *record_file = NULL, *replay_file = NULL;
+
+//files for saving or loading simulation snapshot (NULL if not)
+char *save_file = NULL, *load_file = NULL;
+
 //instead of menus...
 //try to load "tmp menu selections" for menu simulation
 //what we do is try to open this file, and then try to find menu selections in it
@@ -66,11 +80,22 @@ bool tmp_menus()
 		return false; //GOTO: profile menu
 
 
+	//ode reorders constraints randomly, using one shared seed: islands stepped
+	//in parallel draw from it in whatever order the threads happen to run
+	if ((record_file || replay_file) && internal.threads > 1)
+	{
+		Log_Add(-1, "Recording or replaying car controls requires \"threads 1\" (parallel stepping is not deterministic)");
+		if (!headless)
+			Interface_Quit();
+		return false;
+	}
+
 	//initiate simulation
 	if (!Simulation_Init())
 	{
 		//menu: warn and quit!
-		Interface_Quit();
+		if (!headless)
+			Interface_Quit();
 		return false;
 	}
 
@@ -214,8 +239,43 @@ bool tmp_menus()
 	prof->car = car;
 	default_camera.Set_Car(car);
 
+	//record or replay controls?
+	unsigned int replay_steps;
+	if (record_file && !Input_Log_Record(record_file))
+		return false;
+	if (replay_file)
+	{
+		if (!Input_Log_Replay(replay_file, &replay_steps))
+			return false;
+
+		//simulate the same number of steps, unless specified
+		if (!headless_steps_set)
+			headless_steps = replay_steps;
+	}
+
+	//start from saved state?
+	if (load_file)
+	{
+		Snapshot snapshot;
+		if (!snapshot.Read(load_file) || !snapshot.Restore())
+			return false;
+	}
+
 	//MENU: race configured, start? yes!
-	Threads_Launch();
+	if (headless)
+		Simulation_Benchmark(headless_steps);
+	else
+		Threads_Launch();
+
+	//save end state?
+	if (save_file)
+	{
+		Snapshot snapshot;
+		snapshot.Save();
+		snapshot.Write(save_file);
+	}
+
+	Input_Log_Close();
 
 	//race done, remove all objects...
 	Object::Destroy_All();
@@ -233,7 +293,8 @@ bool tmp_menus()
 
 	//MENU: select profile
 	// - assumes player wants to quit -
-	Interface_Quit();
+	if (!headless)
+		Interface_Quit();
 
 	return true;
 }
@@ -257,6 +318,13 @@ static const struct option options[] =
 	{ "portable", optional_argument, NULL, 'p' },
 	{ "user", optional_argument, NULL, 'u' },
 	{ "installed", optional_argument, NULL, 'i' },
+	{ "headless", no_argument, NULL, 'H' },
+	{ "steps", required_argument, NULL, 's' },
+	{ "record", required_argument, NULL, 'r' },
+	{ "replay", required_argument, NULL, 'R' },
+	{ "save", required_argument, NULL, 'S' },
+	{ "load", required_argument, NULL, 'L' },
+	{ "check", no_argument, NULL, 'C' },
 	//
 	//TODO (for lua)
 	//run script.lua instead
@@ -276,13 +344,13 @@ int main (int argc, char *argv[])
 
 	//use getopt_long to parse options to override defaults:
 	char c;
-	bool window=false, fullscreen=false;
+	bool window=false, fullscreen=false, check=false;
 	int xres=0, yres=0;
 	char *port_overr=NULL, *inst_overr=NULL, *user_overr=NULL, *conf_overr=NULL;
 	bool inst_force=false, port_force=false;
 
 	//TODO: might want to compare optind and argc afterwards to detect missing or extra arguments (like file)
-	while ( (c = getopt_long(argc, argv, "hVc:vqwfx:y:p::u::i::", options, NULL)) != -1 )
+	while ( (c = getopt_long(argc, argv, "hVc:vqwfx:y:p::u::i::Hs:r:R:S:L:C", options, NULL)) != -1 )
 	{
 		switch(c)
 		{
@@ -355,6 +423,42 @@ int main (int argc, char *argv[])
 				inst_overr=optarg;
 				break;
 
+			case 'H':
+				headless=true;
+				break;
+
+			case 's':
+				if (atoi(optarg) <= 0)
+				{
+					Log_Add(-1, "Number of steps requires a positive integer");
+					exit(-1);
+				}
+				headless_steps=atoi(optarg);
+				headless_steps_set=true;
+				break;
+
+			case 'r':
+				record_file=optarg;
+				replay_file=NULL;
+				break;
+
+			case 'R':
+				replay_file=optarg;
+				record_file=NULL;
+				break;
+
+			case 'S':
+				save_file=optarg;
+				break;
+
+			case 'L':
+				load_file=optarg;
+				break;
+
+			case 'C':
+				check=true;
+				break;
+
 			default: //print help output
 				//TODO: "Usage: %s [OPTION]... -- [SCHEME OPTIONS]\n"
 				Log_puts(0, "\
@@ -380,7 +484,23 @@ Options for overriding normal (automatic) directory detection:\n\
 			overrides the user directory. Overrides any earlier -p\n\n\
   -i[DIR], --installed[=DIR] Force \"installed\" mode: just like -u above, but\n\
   			optionally overrides the installed (global) directory.\n\
-			Both can be combined in order to specify both paths\n");
+			Both can be combined in order to specify both paths\n\
+\n\
+Options for benchmarking:\n\
+  -H, --headless	no window, just simulate as fast as possible and print\n\
+			timing statistics (simulation can not be controlled)\n\
+  -s, --steps STEPS	simulate STEPS steps when headless (default 1000, or as\n\
+			many as recorded when replaying)\n\
+  -r, --record FILE	record car controls of race to FILE\n\
+  -R, --replay FILE	replay car controls from FILE (compares end result if\n\
+			simulating as many steps as recorded)\n\
+  -S, --save FILE	save state of simulation to FILE when race is done\n\
+  -L, --load FILE	load state of simulation from FILE before starting\n\
+			(must be same track, cars and objects)\n\
+  -C, --check		run checks and benchmarks and quit: switching of render\n\
+			lists between threads (a million lists), generation of\n\
+			a long road, parsing of numbers in obj files and of\n\
+			words in text files (files in \"checks\" in data)\n");
 
 				exit(0); //stop execution
 				break;
@@ -467,21 +587,40 @@ TODO: SAVANNAH, hosting\n\n\n\
 
 
 
+	//only checks and benchmarks (no window or race)?
+	if (check)
+	{
+		//(road generation uses loader threads)
+		Loader_Init(internal.loading_threads);
+
+		bool ok = Render_List_Self_Check(RENDER_LIST_CHECK_LISTS);
+		ok = Model::Check_Road() && ok;
+		ok = Model::Check_OBJ() && ok;
+		ok = Text_File::Check() && ok;
+
+		Loader_Quit();
+		return ok? 0: -1;
+	}
+
 	//ok, start loading
 	Log_Add(1, "Loading...");
 
-	//initiate interface
-	if (!Interface_Init(window, fullscreen, xres, yres))
+	//initiate interface (unless running headless)
+	if (!headless && !Interface_Init(window, fullscreen, xres, yres))
 		return -1;
 
 	//
 	//TODO: there should be menus here, but menu/osd system is not implemented yet... also:
 	//on failure, recaged should not just terminate but instead abort the race and warn the user
+	Loader_Init(internal.loading_threads);
+
 	if (!tmp_menus())
 	{
 		Log_Add(-1, "One or more errors, can not start!");
 		return -1; //just quit if failure
 	}
+
+	Loader_Quit();
 	//
 
 	//might be interesting
@@ -489,17 +628,21 @@ TODO: SAVANNAH, hosting\n\n\n\
 	Log_Add(1, "Startup time:		%ums", starttime);
 	Log_Add(1, "Race time:			%ums", racetime);
 
-	Log_Add(1, "Average simulations/second:	%u steps/second (%u total steps)",
-						(1000*simulation_thread.count)/racetime,
-						simulation_thread.count);
+	//(headless benchmark prints more detailed info by itself)
+	if (!headless && racetime && simulation_thread.count)
+	{
+		Log_Add(1, "Average simulations/second:	%u steps/second (%u total steps)",
+							(1000*simulation_thread.count)/racetime,
+							simulation_thread.count);
 
-	Log_Add(1, "Simulation lag:		%ums, %u steps (%u%% of total steps)",
-						simulation_thread.lag_time, simulation_thread.lag_count,
-						(100*simulation_thread.lag_count)/simulation_thread.count);
+		Log_Add(1, "Simulation lag:		%ums, %u steps (%u%% of total steps)",
+							simulation_thread.lag_time, simulation_thread.lag_count,
+							(100*simulation_thread.lag_count)/simulation_thread.count);
 
-	Log_Add(1, "Average frames/second:	%u FPS (%u%% of simulation steps)",
-						(1000*interface_thread.count)/racetime,
-						(100*interface_thread.count)/simulation_thread.count);
+		Log_Add(1, "Average frames/second:	%u FPS (%u%% of simulation steps)",
+							(1000*interface_thread.count)/racetime,
+							(100*interface_thread.count)/simulation_thread.count);
+	}
 
 	Log_puts(1, "\n Bye!\n\n");
 
@@ -28,24 +28,24 @@
 #include "event_buffers.hpp"
 
 //for creation:
-Body *Body::head = NULL;
+std::vector<Body*> Body::pool;
+std::vector<Body_Drag> Body::pool_drag;
 
 Body::Body (dBodyID body, Object *obj): Component(obj)
 {
 	//increase object activity counter
 	object_parent->Increase_Activity();
 
-	//ad it to the list
-	next = head;
-	head = this;
-	prev = NULL;
-
-	if (next) next->prev = this;
-
 	//add it to the body
 	dBodySetData (body, (void*)(this));
 	body_id = body;
 
+	//add it to the end of the pool
+	pool_index = pool.size();
+	pool.push_back(this);
+	Body_Drag drag = {body};
+	pool_drag.push_back(drag);
+
 	//default values
 	model = NULL; //don't render
 	Update_Mass(); //get current mass...
@@ -60,14 +60,14 @@ Body::~Body()
 	//remove all events
 	Event_Buffer_Remove_All(this);
 
-	//1: remove it from the list
-	if (!prev) //head in list, change head pointer
-		head = next;
-	else //not head in list, got a previous link to update
-		prev->next = next;
+	//1: remove it from the pool, by moving the last body here
+	Body *last = pool.back();
+	last->pool_index = pool_index;
+	pool[pool_index] = last;
+	pool_drag[pool_index] = pool_drag.back();
 
-	if (next) //not last link in list
-		next->prev = prev;
+	pool.pop_back();
+	pool_drag.pop_back();
 
 	//2: remove it from memory
 
@@ -88,54 +88,59 @@ void Body::Update_Mass()
 	//TODO: use the body's inertia tensor instead...?
 	dBodyGetMass (body_id, &dmass);
 
-	mass = dmass.mass;
+	pool_drag[pool_index].mass = dmass.mass;
 }
 
 //NOTE: modifying specified drag to the current mass (rice-burning optimization, or actually good idea?)
 //(this way the body mass doesn't need to be requested and used in every calculation)
 void Body::Set_Linear_Drag (dReal drag)
 {
-	linear_drag[0] = drag;
-	use_axis_linear_drag = false;
+	Body_Drag *d = &pool_drag[pool_index];
+	d->linear_drag[0] = drag;
+	d->use_axis_linear_drag = false;
 }
 
 void Body::Set_Axis_Linear_Drag (dReal drag_x, dReal drag_y, dReal drag_z)
 {
-	linear_drag[0] = drag_x;
-	linear_drag[1] = drag_y;
-	linear_drag[2] = drag_z;
+	Body_Drag *d = &pool_drag[pool_index];
+	d->linear_drag[0] = drag_x;
+	d->linear_drag[1] = drag_y;
+	d->linear_drag[2] = drag_z;
 
-	use_axis_linear_drag = true;
+	d->use_axis_linear_drag = true;
 }
 
 void Body::Set_Angular_Drag (dReal drag)
 {
-	angular_drag[0] = drag;
-	use_axis_angular_drag = false;
+	Body_Drag *d = &pool_drag[pool_index];
+	d->angular_drag[0] = drag;
+	d->use_axis_angular_drag = false;
 }
 
 void Body::Set_Axis_Angular_Drag (dReal drag_x, dReal drag_y, dReal drag_z)
 {
-	angular_drag[0] = drag_x;
-	angular_drag[1] = drag_y;
-	angular_drag[2] = drag_z;
+	Body_Drag *d = &pool_drag[pool_index];
+	d->angular_drag[0] = drag_x;
+	d->angular_drag[1] = drag_y;
+	d->angular_drag[2] = drag_z;
 
-	use_axis_angular_drag = true;
+	d->use_axis_angular_drag = true;
 }
 
 
 //simulation of drag
 //
 //not to self: if implementing different density areas, this is where density should be chosen
-void Body::Linear_Drag (dReal step)
+static void Linear_Drag (Body_Drag *d, dReal step)
 {
+	dBodyID body_id = d->body_id;
 	const dReal *abs_vel; //absolute vel
 	abs_vel = dBodyGetLinearVel (body_id);
 	dReal vel[3] = {abs_vel[0]-track.wind[0], abs_vel[1]-track.wind[1], abs_vel[2]-track.wind[2]}; //relative to wind
 	dReal total_vel = v_length(vel[0], vel[1], vel[2]);
 
 	//how much of original velocity is left after braking by air/liquid drag
-	dReal scale=1.0/(1.0+total_vel*(track.density)*(linear_drag[0]/mass)*(step));
+	dReal scale=1.0/(1.0+total_vel*(track.density)*(d->linear_drag[0]/d->mass)*(step));
 
 	//change velocity
 	vel[0]*=scale;
@@ -152,8 +157,9 @@ void Body::Linear_Drag (dReal step)
 }
 
 //similar to linear_drag, but different drag for different (local) directions
-void Body::Axis_Linear_Drag (dReal step)
+static void Axis_Linear_Drag (Body_Drag *d, dReal step)
 {
+	dBodyID body_id = d->body_id;
 	//absolute velocity
 	const dReal *abs_vel;
 	abs_vel = dBodyGetLinearVel (body_id);
@@ -164,9 +170,9 @@ void Body::Axis_Linear_Drag (dReal step)
 	dReal total_vel = v_length(vel[0], vel[1], vel[2]);
 
 	//how much of original velocities is left after braking by air/liquid drag
-	vel[0]/=1.0+(total_vel*(track.density)*(linear_drag[0]/mass)*(step));
-	vel[1]/=1.0+(total_vel*(track.density)*(linear_drag[1]/mass)*(step));
-	vel[2]/=1.0+(total_vel*(track.density)*(linear_drag[2]/mass)*(step));
+	vel[0]/=1.0+(total_vel*(track.density)*(d->linear_drag[0]/d->mass)*(step));
+	vel[1]/=1.0+(total_vel*(track.density)*(d->linear_drag[1]/d->mass)*(step));
+	vel[2]/=1.0+(total_vel*(track.density)*(d->linear_drag[2]/d->mass)*(step));
 
 	//make absolute
 	dVector3 vel_result;
@@ -181,21 +187,23 @@ void Body::Axis_Linear_Drag (dReal step)
 	dBodySetLinearVel(body_id, vel_result[0], vel_result[1], vel_result[2]);
 }
 
-void Body::Angular_Drag (dReal step)
+static void Angular_Drag (Body_Drag *d, dReal step)
 {
+	dBodyID body_id = d->body_id;
 	const dReal *vel; //rotation velocity
 	vel = dBodyGetAngularVel (body_id);
 	dReal total_vel = v_length(vel[0], vel[1], vel[2]);
 
 	//how much of original velocity is left after braking by air/liquid drag
-	dReal scale=1.0/(1.0+total_vel*(track.density)*(angular_drag[0]/mass)*(step));
+	dReal scale=1.0/(1.0+total_vel*(track.density)*(d->angular_drag[0]/d->mass)*(step));
 
 	//set velocity with change
 	dBodySetAngularVel(body_id, vel[0]*scale, vel[1]*scale, vel[2]*scale);
 }
 
-void Body::Axis_Angular_Drag (dReal step)
+static void Axis_Angular_Drag (Body_Drag *d, dReal step)
 {
+	dBodyID body_id = d->body_id;
 	//rotation velocity
 	const dReal *vel = dBodyGetAngularVel (body_id);
 
@@ -212,9 +220,9 @@ void Body::Axis_Angular_Drag (dReal step)
 	dReal total_vel = v_length(rel[0], rel[1], rel[2]);
 
 	//how much of original velocity is left after braking by air/liquid drag
-	rel[0]/=(1.0+total_vel*(track.density)*(angular_drag[0]/mass)*(step));
-	rel[1]/=(1.0+total_vel*(track.density)*(angular_drag[1]/mass)*(step));
-	rel[2]/=(1.0+total_vel*(track.density)*(angular_drag[2]/mass)*(step));
+	rel[0]/=(1.0+total_vel*(track.density)*(d->angular_drag[0]/d->mass)*(step));
+	rel[1]/=(1.0+total_vel*(track.density)*(d->angular_drag[1]/d->mass)*(step));
+	rel[2]/=(1.0+total_vel*(track.density)*(d->angular_drag[2]/d->mass)*(step));
 
 	//set velocity with change (transformed back to world coordinates)
 	dBodySetAngularVel(body_id,
@@ -265,19 +273,23 @@ void Body::Damage_Buffer(dReal force, dReal step)
 
 void Body::Physics_Step (dReal step)
 {
-	for (Body *body=Body::head; body; body=body->next)
+	Body_Drag *d;
+	size_t count = pool_drag.size();
+	for (size_t i=0; i<count; ++i)
 	{
+		d = &pool_drag[i];
+
 		//drag
-		if (body->use_axis_linear_drag)
-			body->Axis_Linear_Drag(step);
+		if (d->use_axis_linear_drag)
+			Axis_Linear_Drag(d, step);
 		else //simple drag instead
-			body->Linear_Drag(step);
+			Linear_Drag(d, step);
 
 		//angular
-		if (body->use_axis_angular_drag)
-			body->Axis_Angular_Drag(step);
+		if (d->use_axis_angular_drag)
+			Axis_Angular_Drag(d, step);
 		else
-			body->Angular_Drag(step);
+			Angular_Drag(d, step);
 	}
 }
 
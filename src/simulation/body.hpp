@@ -27,6 +27,23 @@
 #include "assets/script.hpp"
 #include "assets/object.hpp"
 #include "assets/script.hpp"
+#include <vector>
+
+//data for drag (air+water friction), looped through each step
+struct Body_Drag
+{
+	dBodyID body_id;
+
+	//instead of the simple spherical drag model, use a
+	//"squeezed/stretched" sphere?
+	bool use_axis_linear_drag;
+	bool use_axis_angular_drag;
+
+	//drag values (must be adjusted to the body mass)
+	dReal mass; //used for drag
+	dReal linear_drag[3];
+	dReal angular_drag[3];
+};
 
 //body_data: data for body (describes mass and mass positioning), used for:
 //currently only for triggering event script (force threshold and event variables)
@@ -66,35 +83,22 @@ class Body: public Component
 		bool Buffer_Event_Configured(); //check if configured (by geom)
 
 	private:
-		//used to find next/prev link in dynamically allocated chain
-		//set next to null in last link in chain (prev = NULL in first)
-		Body *prev, *next;
-		static Body *head;
+		//all bodies are kept densely packed in a pool (removing moves the
+		//last body into the free slot), with drag data in separate array
+		static std::vector<Body*> pool;
+		static std::vector<Body_Drag> pool_drag;
+		size_t pool_index;
 		friend void Render_List_Update(); //to allow loop through bodies
 		friend void Track_Physics_Step();
-
-		//data for drag (air+water friction)
-		//instead of the simple spherical drag model, use a
-		//"squeezed/stretched" sphere?
-		bool use_axis_linear_drag;
-		bool use_axis_angular_drag;
-
-		//drag values (must be adjusted to the body mass)
-		dReal mass; //used for drag
-		dReal linear_drag[3];
-		dReal angular_drag[3];
+		friend Uint32 Simulation_Checksum(); //loops through bodies
+		friend class Snapshot; //saves/restores state
+		friend void Simulation_Benchmark(unsigned int steps); //statistics
 
 		//event processing
 		bool buffer_event; //buffer has just been depleted
 		dReal threshold; //if allocated forces exceeds, eat buffer
 		dReal buffer; //if buffer reaches zero, trigger event
 		Script *buffer_script; //execute on event
-
-		//private methods for drag
-		void Linear_Drag(dReal step);
-		void Angular_Drag(dReal step);
-		void Axis_Linear_Drag(dReal step);
-		void Axis_Angular_Drag(dReal step);
 };
 
 #endif
@@ -687,7 +687,7 @@ void Camera::Physics_Step(dReal step)
 		//and if in air
 		if (settings.in_air) //in air enabled
 		{
-			if (!(car->sensor1->colliding) && !(car->sensor2->colliding)) //in air
+			if (!(car->sensor1->Colliding()) && !(car->sensor2->Colliding())) //in air
 			{
 				if (in_air) //in ground mode
 				{
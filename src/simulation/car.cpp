@@ -31,16 +31,16 @@ void Car::Physics_Step(dReal step)
 	for (carp=head; carp; carp=carp->next)
 	{
 		//both sensors are triggered, not flipping, only downforce
-		if (carp->sensor1->colliding && carp->sensor2->colliding)
+		if (carp->sensor1->Colliding() && carp->sensor2->Colliding())
 			ground = true;
 		//only one sensor, flipping+downforce
-		else if (carp->sensor1->colliding)
+		else if (carp->sensor1->Colliding())
 		{
 			ground = true;
 			carp->dir = 1.0;
 		}
 		//same
-		else if (carp->sensor2->colliding)
+		else if (carp->sensor2->Colliding())
 		{
 			ground = true;
 			carp->dir = -1.0;
@@ -437,7 +437,7 @@ void Car::Physics_Step(dReal step)
 
 				//motor torque
 				//if a wheel is in air, lets limit the torques
-				if (!carp->wheel_geom_data[i]->colliding)
+				if (!carp->wheel_geom_data[i]->Colliding())
 				{
 					//above limit...
 					if (torque[i] > carp->airtorque)
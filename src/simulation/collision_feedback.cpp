@@ -21,56 +21,114 @@
 
 #include "collision_feedback.hpp"
 
-Collision_Feedback *Collision_Feedback::head = NULL;
+//feedbacks are only needed during one step, so they are stored in blocks that
+//are reused every step (only allocating when needing more than ever before)
+#define FEEDBACK_BLOCK_SIZE 256
 
-Collision_Feedback::Collision_Feedback(dJointID joint, Geom *g1, Geom *g2)
+struct Feedback_Block
 {
-	geom1 = g1;
-	geom2 = g2;
+	Collision_Feedback feedbacks[FEEDBACK_BLOCK_SIZE];
+	Feedback_Block *next;
+};
+
+static Feedback_Block *blocks = NULL; //first block
+static Feedback_Block *current = NULL; //block being filled (NULL if none yet)
+static int used = 0; //feedbacks in current block
+
+unsigned long Collision_Feedback::allocations = 0;
+unsigned long Collision_Feedback::count = 0;
+
+void Collision_Feedback::Add(dJointID joint, Geom *g1, Geom *g2)
+{
+	//need next block?
+	if (!current || used == FEEDBACK_BLOCK_SIZE)
+	{
+		Feedback_Block **next = current? &current->next: &blocks;
+
+		if (!*next)
+		{
+			*next = new Feedback_Block;
+			(*next)->next = NULL;
+			++allocations;
+		}
+
+		current = *next;
+		used = 0;
+	}
+
+	Collision_Feedback *f = &current->feedbacks[used++];
+	++count;
+
+	f->geom1 = g1;
+	f->geom2 = g2;
 
 	//make sure initialized to 0 (in case joint doesn't return any data...)
-	feedback.f1[0]=0;
-	feedback.f1[1]=0;
-	feedback.f1[2]=0;
-	feedback.f2[0]=0;
-	feedback.f2[1]=0;
-	feedback.f2[2]=0;
+	f->feedback.f1[0]=0;
+	f->feedback.f1[1]=0;
+	f->feedback.f1[2]=0;
+	f->feedback.f2[0]=0;
+	f->feedback.f2[1]=0;
+	f->feedback.f2[2]=0;
 
 	//set
-	dJointSetFeedback(joint, &feedback);
-
-	//add to list
-	next = head;
-	head = this;
+	dJointSetFeedback(joint, &f->feedback);
 }
 
 void Collision_Feedback::Physics_Step(dReal step)
 {
-	Collision_Feedback *prev;
+	//nothing added this step
+	if (!current)
+		return;
+
+	Collision_Feedback *f;
 	dReal force1, force2;
+	int i, last;
 
-	while (head)
+	for (Feedback_Block *block=blocks; ; block=block->next)
 	{
-		//calculate length (absolute value) of each force
-		force1 = dLENGTH(head->feedback.f1);
-		force2 = dLENGTH(head->feedback.f2);
+		//all blocks before current are full
+		last = (block == current)? used: FEEDBACK_BLOCK_SIZE;
 
-		//pass biggest force to both geoms
-		if (force1 > force2)
-		{
-			head->geom1->Damage_Buffer(force1, step);
-			head->geom2->Damage_Buffer(force1, step);
-		}
-		else //f2>f1
+		for (i=0; i<last; ++i)
 		{
-			head->geom1->Damage_Buffer(force2, step);
-			head->geom2->Damage_Buffer(force2, step);
+			f = &block->feedbacks[i];
+
+			//calculate length (absolute value) of each force
+			force1 = dLENGTH(f->feedback.f1);
+			force2 = dLENGTH(f->feedback.f2);
+
+			//pass biggest force to both geoms
+			if (force1 > force2)
+			{
+				f->geom1->Damage_Buffer(force1, step);
+				f->geom2->Damage_Buffer(force1, step);
+			}
+			else //f2>f1
+			{
+				f->geom1->Damage_Buffer(force2, step);
+				f->geom2->Damage_Buffer(force2, step);
+			}
 		}
 
-		//remove
-		prev = head;
-		head = head->next;
-		delete prev;
+		if (block == current)
+			break;
 	}
+
+	//reuse all blocks next step
+	current = NULL;
+	used = 0;
 }
 
+void Collision_Feedback::Free_All()
+{
+	Feedback_Block *next;
+	while (blocks)
+	{
+		next = blocks->next;
+		delete blocks;
+		blocks = next;
+	}
+
+	current = NULL;
+	used = 0;
+}
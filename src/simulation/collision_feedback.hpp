@@ -30,16 +30,16 @@
 class Collision_Feedback
 {
 	public:
-		Collision_Feedback(dJointID joint, Geom *g1, Geom *g2);
-		static void Physics_Step(dReal step); //processes and clears list
+		static void Add(dJointID joint, Geom *g1, Geom *g2);
+		static void Physics_Step(dReal step); //processes and clears all
+		static void Free_All(); //release memory (when quitting)
+
+		//statistics: heap allocations and added feedbacks since start
+		static unsigned long allocations, count;
 
 	private:
 		//data for simulation
 		Geom *geom1, *geom2;
 		dJointFeedback feedback;
-
-		//data for keeping track of link members
-		Collision_Feedback *next;
-		static Collision_Feedback *head;
 };
 #endif
@@ -23,8 +23,12 @@
 #include "assets/object.hpp"
 #include "common/log.hpp"
 
+unsigned int Component::serial_next = 0;
+
 Component::Component(Object *obj)
 {
+	serial = serial_next++;
+
 	//rather simple: just add it to the top of obj list of components
 	next = obj->components;
 	prev = NULL;
@@ -40,5 +40,9 @@ class Component
 		//keep track of the "owning" object
 		Object * object_parent;
 
+		//unique, in order of creation (snapshots can tell if same component)
+		unsigned int serial;
+		static unsigned int serial_next;
+
 };
 #endif
@@ -23,6 +23,7 @@
 #include "common/threads.hpp"
 #include "event_buffers.hpp"
 #include "timers.hpp"
+#include "interface/render_list.hpp"
 
 
 //
@@ -235,8 +236,9 @@ void Event_Buffers_Process(dReal step)
 				const dReal *pos = dGeomGetPosition(geom->geom_id);
 				dBodySetPosition(body, pos[0], pos[1], pos[2]);
 
-				//attach
+				//attach (and render as moving)
 				dGeomSetBody(geom->geom_id, body);
+				Render_List_Remove_Static(geom);
 
 
 				//reset buffer
@@ -265,16 +267,16 @@ void Event_Buffers_Process(dReal step)
 	}
 
 	//body buffer:
-	Geom *next;
 	while ((body = (Body*)Pop(&body_depleted)))
 	{
 		//first of all, remove all connected (to this body) geoms:
 		//ok, this is _really_ uggly...
 		//ode lacks a "dBodyGetGeom" routine (why?! it's easy to implement!)...
 		//solution: loop through all geoms remove all with "force_to_body"==this body
-		for (geom=Geom::head; geom; geom=next)
+		//(backwards: removing moves last geom into its place)
+		for (size_t i=Geom::pool.size(); i>0; --i)
 		{
-			next=geom->next; //needs this after possibly destroying the geom (avoid segfault)
+			geom=Geom::pool[i-1];
 			if (geom->force_to_body == body)
 				delete geom;
 		}
@@ -29,14 +29,25 @@
 
 #include "assets/track.hpp"
 #include "assets/conf.hpp"
+#include "interface/render_list.hpp"
 
 #include <ode/ode.h>
 #include <string.h>
+#include <vector>
+#include <algorithm>
+#include <SDL/SDL_thread.h>
+#include <SDL/SDL_mutex.h>
 
 //
 //for creation/destruction:
 //
-Geom *Geom::head = NULL;
+std::vector<Geom*> Geom::pool;
+std::vector<bool> Geom::pool_colliding;
+std::vector<bool> Geom::pool_sensor;
+std::vector<Geom*> Geom::touched_geoms;
+unsigned long Geom::triangles_reset = 0;
+unsigned long Geom::triangles_full_clear = 0;
+size_t Geom::triangles_total = 0;
 
 //allocates a new geom data, returns its pointer (and uppdate its object's count),
 //ads it to the component list, and ads the data to specified geom (assumed)
@@ -50,13 +61,11 @@ Geom::Geom (dGeomID geom, Object *obj): Component(obj) //pass object argument to
 	else //add geom to global space
 		dSpaceAdd (simulation_thread.space, geom);
 
-	//add it to the geom list
-	next = Geom::head;
-	Geom::head = this;
-	prev = NULL;
-
-	//one more geom after this
-	if (next) next->prev = this;
+	//add it to the end of the pool
+	pool_index = pool.size();
+	pool.push_back(this);
+	pool_colliding.push_back(false); //no collision event yet
+	pool_sensor.push_back(false);
 
 	//add it to the geom
 	dGeomSetData (geom, (void*)(Geom*)(this));
@@ -64,8 +73,8 @@ Geom::Geom (dGeomID geom, Object *obj): Component(obj) //pass object argument to
 
 	//now lets set some default values...
 	//event processing (triggering):
-	colliding = false; //no collision event yet
 	model = NULL; //default: don't render
+	render_static = -1; //not in static render tree (until race starts)
 
 	//special geom indicators
 	wheel = NULL; //not a wheel (for now)
@@ -73,12 +82,12 @@ Geom::Geom (dGeomID geom, Object *obj): Component(obj) //pass object argument to
 	material_count = 0; //no "materials"
 	triangle_colliding = NULL;
 	material_surfaces = NULL;
+	triangle_material = NULL;
 
 	//events:
 	//for force handling (disable)
 	buffer_event=false;
 	force_to_body=NULL; //when true, points at wanted body
-	sensor_event=false;
 
 	//debug variables
 	flipper_geom = 0;
@@ -90,14 +99,19 @@ Geom::~Geom ()
 	//remove all events
 	Event_Buffer_Remove_All(this);
 
-	//1: remove it from the list
-	if (!prev) //head in list, change head pointer
-		Geom::head = next;
-	else //not head in list, got a previous link to update
-		prev->next = next;
+	//stop rendering (if static)
+	Render_List_Remove_Static(this);
+
+	//1: remove it from the pool, by moving the last geom here
+	Geom *last = pool.back();
+	last->pool_index = pool_index;
+	pool[pool_index] = last;
+	pool_colliding[pool_index] = pool_colliding.back();
+	pool_sensor[pool_index] = pool_sensor.back();
 
-	if (next) //not last link in list
-		next->prev = prev;
+	pool.pop_back();
+	pool_colliding.pop_back();
+	pool_sensor.pop_back();
 
 	//remove actual geom from ode
 	dGeomDestroy(geom_id);
@@ -109,8 +123,12 @@ Geom::~Geom ()
 	object_parent->Decrease_Activity();
 
 	//clear possible collision checking and material-based-surfaces
+	if (!triangle_touched.empty())
+		touched_geoms.erase(std::find(touched_geoms.begin(), touched_geoms.end(), this));
+	triangles_total -= triangle_count;
 	delete[] triangle_colliding;
 	delete[] material_surfaces;
+	delete[] triangle_material;
 }
 
 //set defaults:
@@ -148,6 +166,23 @@ Surface *Geom::Find_Material_Surface(const char *name)
 		//set default (set to out global surface)
 		for (int i=0; i<material_count; ++i)
 			material_surfaces[i] = surface;
+
+		//lookup table for finding material of triangle directly
+		if (material_count > 0xFFFF)
+			Log_Add(0, "WARNING: too many materials (%i) for triangle lookup table, will be slow", material_count);
+		else
+		{
+			triangle_material = new Uint16[triangle_count];
+
+			int t=0;
+			for (int m=0; m<material_count; ++m)
+				for (; t<parent_materials[m].end && t<triangle_count; ++t)
+					triangle_material[t] = m;
+
+			//(should not happen, but in case triangles after last material)
+			for (; t<triangle_count; ++t)
+				triangle_material[t] = material_count-1;
+		}
 	}
 
 	//ok 
@@ -166,16 +201,88 @@ Surface *Geom::Find_Material_Surface(const char *name)
 //clears geom collision flags
 void Geom::Clear_Collisions()
 {
-	for (Geom *geom=head; geom; geom=geom->next)
+	std::fill(pool_colliding.begin(), pool_colliding.end(), false);
+
+	//clear triangle collision bools (for trimeshes), but only those set
+	Geom *geom;
+	std::vector<int>::iterator t;
+	for (size_t i=0; i<touched_geoms.size(); ++i)
 	{
-		geom->colliding = false;
+		geom = touched_geoms[i];
+		for (t=geom->triangle_touched.begin(); t!=geom->triangle_touched.end(); ++t)
+			geom->triangle_colliding[*t] = false;
 
-		//clear all triangle collision bools (for trimeshes)
-		if (geom->triangle_count)
-			memset(geom->triangle_colliding, false, sizeof(bool)*geom->triangle_count);
+		triangles_reset += geom->triangle_touched.size();
+		geom->triangle_touched.clear();
 	}
+
+	touched_geoms.clear();
+	triangles_full_clear += triangles_total;
 }
 
+//marks triangle as colliding (and remember to clear it)
+void Geom::Mark_Triangle(int t)
+{
+	if (triangle_colliding[t])
+		return;
+
+	if (triangle_touched.empty())
+		touched_geoms.push_back(this);
+
+	triangle_colliding[t] = true;
+	triangle_touched.push_back(t);
+}
+
+//
+//collision detection is performed in three stages:
+//1) find all pairs of geoms that might collide (ode space)
+//2) collide each pair and calculate surface settings for all contacts. This
+//   only reads geoms and bodies, so can be done in parallel (each thread got
+//   its own buffer for contacts)
+//3) go through all pairs (in the same order as found), update collision
+//   flags and create contact joints (or send to wheels)
+//
+//since the last stage is always done in the order pairs were found, the
+//result does not depend on the number of threads used
+//
+
+//pair of geoms found by space
+struct Collision_Pair
+{
+	dGeomID o1, o2;
+
+	//contacts (if any) in buffer of thread
+	int thread, first, count;
+};
+
+//contact point and surfaces of both geoms at contact
+struct Collision_Contact
+{
+	dContact contact;
+	Surface *surf1, *surf2;
+};
+
+//each thread collides pairs into own buffer
+struct Collision_Thread
+{
+	int id;
+	SDL_Thread *thread;
+	std::vector<Collision_Contact> contacts;
+	std::vector<dContactGeom> scratch; //(collided into, before knowing how many)
+};
+
+static std::vector<Collision_Pair> collision_pairs;
+static Collision_Thread *collision_threads = NULL;
+static int collision_thread_count = 1; //including the simulation thread
+
+static dReal collision_stepsize;
+static size_t collision_next_pair; //next pair to collide (atomic)
+static bool collision_quit = false;
+static SDL_sem *collision_start = NULL, *collision_done = NULL;
+
+//how many pairs each thread takes at a time
+#define COLLISION_PAIRS_CHUNK 16
+
 //when two geoms might intersect
 void Geom::Collision_Callback (void *data, dGeomID o1, dGeomID o2)
 {
@@ -186,121 +293,104 @@ void Geom::Collision_Callback (void *data, dGeomID o1, dGeomID o2)
 		return;
 	}
 
-	//get attached bodies
-	dBodyID b1, b2;
-	b1 = dGeomGetBody(o1);
-	b2 = dGeomGetBody(o2);
-
 	//the same body, and if both are NULL (no bodies at all)
 	//(should probably add a gotgeom/gotnogeom bitfield to also skip hashing)
 	//TODO: bitfield indication for static geoms (without body)!"
-	if (b1 == b2)
+	if (dGeomGetBody(o1) == dGeomGetBody(o2))
 		return; //stop
 
-	//both geoms are geoms, get Geom (metadatas) for/from geoms
-	Geom *geom1, *geom2;
-	geom1 = (Geom*) dGeomGetData (o1);
-	geom2 = (Geom*) dGeomGetData (o2);
+	//just store for now
+	Collision_Pair pair = {o1, o2, 0, 0, 0};
+	collision_pairs.push_back(pair);
+}
 
-	//pointer to the surface settings of both geoms
-	Surface *surf1, *surf2;
+//finds surface of contact on geom (per-material for trimeshes)
+inline Surface *Geom::Contact_Surface(int side)
+{
+	//might have index value of -1. shouldn't really hapen, but check anyway
+	if (!material_surfaces || side < 0 || side >= triangle_count)
+		return &surface;
 
-	//the stepsize (supplied as the "collision data")
-	dReal stepsize = *((dReal*)data);
+	//normally looked up directly
+	if (triangle_material)
+		return &material_surfaces[triangle_material[side]];
 
-	dContact contact[internal.contact_points];
-	int count = dCollide (o1,o2,internal.contact_points, &contact[0].geom, sizeof(dContact));
+	//loop through all materials until finding the one for this triangle
+	int mcount;
+	for (mcount=0; mcount<material_count && !(side < parent_materials[mcount].end); ++mcount);
 
-	//if returned 0 collisions (did not collide), stop
-	if (count == 0)
-		return;
+	return &material_surfaces[mcount];
+}
 
-	//might be needed
-	int mcount;
+//stage 2: collide all pairs until none left
+void Geom::Collide_Pairs(Collision_Thread *thread)
+{
+	std::vector<Collision_Contact> &contacts = thread->contacts;
+	contacts.clear();
 
-	//OR: do this for all geoms? this is cheapest and most important
-	bool wheel1=false, wheel2=false;
-	if (geom1->wheel)
-	{
-		if (!geom2->wheel && b1)
-			wheel1=true;
-	}
-	else if (geom2->wheel && b2)
-		wheel2=true;
+	//(only grows if contact_points changed)
+	if (thread->scratch.size() < (size_t)internal.contact_points)
+		thread->scratch.resize(internal.contact_points);
 
-	//store wheel axle direction right once (instead of querying again)
-	dReal wheelaxle[3];
-	if (wheel1)
+	size_t total = collision_pairs.size();
+	size_t start, end;
+	while ((start = __atomic_fetch_add(&collision_next_pair, COLLISION_PAIRS_CHUNK, __ATOMIC_RELAXED)) < total)
 	{
-		const dReal *rot = dBodyGetRotation(b1);
-		wheelaxle[0] = rot[2];
-		wheelaxle[1] = rot[6];
-		wheelaxle[2] = rot[10];
+		end = start+COLLISION_PAIRS_CHUNK;
+		if (end > total)
+			end = total;
+
+		for (size_t p=start; p<end; ++p)
+			Collide_Pair(&collision_pairs[p], thread);
 	}
-	else if (wheel2)
+}
+
+//collide one pair, store contacts and surface settings
+void Geom::Collide_Pair(Collision_Pair *pair, Collision_Thread *thread)
+{
+	std::vector<Collision_Contact> &contacts = thread->contacts;
+	int first = contacts.size();
+
+	int count = dCollide (pair->o1, pair->o2, internal.contact_points,
+			&thread->scratch[0], sizeof(dContactGeom));
+
+	//only store the contacts actually found
+	if (count)
 	{
-		const dReal *rot = dBodyGetRotation(b2);
-		wheelaxle[0] = rot[2];
-		wheelaxle[1] = rot[6];
-		wheelaxle[2] = rot[10];
+		contacts.resize(first+count);
+		for (int i=0; i<count; ++i)
+			contacts[first+i].contact.geom = thread->scratch[i];
 	}
 
-	//loop through all collision points and configure surface settings for each
-	for (int i=0; i<count; ++i)
-	{
-		//use the geom's global surface values for now...
-		surf1 = &geom1->surface;
-		surf2 = &geom2->surface;
+	pair->thread = thread->id;
+	pair->first = first;
+	pair->count = count;
 
-		//check if trimeshes
-		//using the side{1,2} values: are the triangle indices (not documented feature in ode...)
-		if (geom1->triangle_count) //is trimesh with per-triangle enabled
-		{
-			//might have index value of -1. shouldn't really hapen, but check anyway
-			if (contact[i].geom.side1 != -1)
-			{
-				//set collision flag for this triangle
-				geom1->triangle_colliding[contact[i].geom.side1] = true;
-
-				//surface based on material?
-				if (geom1->material_surfaces)
-				{
-					//loop through all materials until finding the one for this triangle
-					for (mcount=0; mcount<geom1->material_count &&
-							!(contact[i].geom.side1 < geom1->parent_materials[mcount].end);
-							++mcount);
-
-					//set surface
-					surf1 = &geom1->material_surfaces[mcount];
-				}
-			}
-		}
-		if (geom2->triangle_count) //the same for the other
-		{
-			//might have index value of -1. shouldn't really hapen, but check anyway
-			if (contact[i].geom.side2 != -1)
-			{
-				//set collision flag for this triangle
-				geom2->triangle_colliding[contact[i].geom.side2] = true;
+	//if returned 0 collisions (did not collide), stop
+	if (count == 0)
+		return;
 
-				if (geom2->material_surfaces)
-				{
-					for (mcount=0; mcount<geom2->material_count &&
-							!(contact[i].geom.side2 < geom2->parent_materials[mcount].end);
-							++mcount);
+	//both geoms are geoms, get Geom (metadatas) for/from geoms
+	Geom *geom1, *geom2;
+	geom1 = (Geom*) dGeomGetData (pair->o1);
+	geom2 = (Geom*) dGeomGetData (pair->o2);
 
-					surf2 = &geom2->material_surfaces[mcount];
-				}
-			}
-		}
+	//pointer to the surface settings of both geoms
+	Surface *surf1, *surf2;
+	dContact *contact;
 
-		//as long as one geom got a spring of not 0, it should trigger the other
-		if (surf1->spring) //geom1 would have generated collision
-			geom2->colliding = true; //thus geom2 is colliding
+	//loop through all collision points and configure surface settings for each
+	for (int i=first; i<first+count; ++i)
+	{
+		contact = &contacts[i].contact;
 
-		if (surf2->spring) //geom2 would have generated collision
-			geom1->colliding = true; //thus geom2 is colliding
+		//check if trimeshes, use the geom's global surface values if not
+		//using the side{1,2} values: are the triangle indices (not documented feature in ode...)
+		surf1 = geom1->Contact_Surface(contact->geom.side1);
+		surf2 = geom2->Contact_Surface(contact->geom.side2);
 
+		contacts[i].surf1 = surf1;
+		contacts[i].surf2 = surf2;
 
 		//does both components want to collide for real? (not "ghosts"/"sensors")
 		//if any geom got a spring of 0, it doesn't want/need to collide:
@@ -311,19 +401,19 @@ void Geom::Collision_Callback (void *data, dGeomID o1, dGeomID o2)
 
 		//sett surface options:
 		//enable mu overriding and good friction approximation
-		contact[i].surface.mode = dContactApprox1;
+		contact->surface.mode = dContactApprox1;
 
-		contact[i].surface.mu = (surf1->mu)*(surf2->mu); //friction
+		contact->surface.mu = (surf1->mu)*(surf2->mu); //friction
 
 		//optional or not even/rarely used by recaged, set to 0 to prevent compiler warnings:
-		contact[i].surface.mu2 = 0.0; //only for tyre
-		contact[i].surface.bounce = 0.0;
-		contact[i].surface.bounce_vel = 0.0;
-		contact[i].surface.motion1 = 0.0; //for conveyor belt?
-		contact[i].surface.motion2 = 0.0; //for conveyor belt?
-		contact[i].surface.motionN = 0.0; //what _is_ this for?
-		contact[i].surface.slip1 = 0.0; //not used
-		contact[i].surface.slip2 = 0.0; //not used
+		contact->surface.mu2 = 0.0; //only for tyre
+		contact->surface.bounce = 0.0;
+		contact->surface.bounce_vel = 0.0;
+		contact->surface.motion1 = 0.0; //for conveyor belt?
+		contact->surface.motion2 = 0.0; //for conveyor belt?
+		contact->surface.motionN = 0.0; //what _is_ this for?
+		contact->surface.slip1 = 0.0; //not used
+		contact->surface.slip2 = 0.0; //not used
 
 		//
 		//optional features:
@@ -332,11 +422,11 @@ void Geom::Collision_Callback (void *data, dGeomID o1, dGeomID o2)
 		if (surf1->bounce != 0.0 || surf2->bounce != 0.0)
 		{
 			//enable bouncyness
-			contact[i].surface.mode |= dContactBounce;
+			contact->surface.mode |= dContactBounce;
 
 			//use sum
-			contact[i].surface.bounce = (surf1->bounce)+(surf2->bounce);
-			contact[i].surface.bounce_vel = 0.0; //not used by recaged right now, perhaps for future tweaking?
+			contact->surface.bounce = (surf1->bounce)+(surf2->bounce);
+			contact->surface.bounce_vel = 0.0; //not used by recaged right now, perhaps for future tweaking?
 		}
 
 		//optional spring+damping erp+cfm override
@@ -348,11 +438,82 @@ void Geom::Collision_Callback (void *data, dGeomID o1, dGeomID o2)
 			dReal damping = 1/( 1/(surf1->damping) + 1/surf2->damping );
 
 			//recalculate erp+cfm from stepsize, spring and damping values:
-			contact[i].surface.mode |= dContactSoftERP | dContactSoftCFM; //enable local erp/cfm settings
-			contact[i].surface.soft_erp = (stepsize*spring)/(stepsize*spring +damping);
-			contact[i].surface.soft_cfm = 1.0/(stepsize*spring +damping);
+			contact->surface.mode |= dContactSoftERP | dContactSoftCFM; //enable local erp/cfm settings
+			contact->surface.soft_erp = (collision_stepsize*spring)/(collision_stepsize*spring +damping);
+			contact->surface.soft_cfm = 1.0/(collision_stepsize*spring +damping);
 		}
 		//end of optional features
+	}
+}
+
+//stage 3: set flags and create contacts of one pair
+void Geom::Commit_Pair(Collision_Pair *pair)
+{
+	if (pair->count == 0)
+		return;
+
+	Collision_Contact *contacts = &collision_threads[pair->thread].contacts[pair->first];
+
+	//get attached bodies
+	dBodyID b1, b2;
+	b1 = dGeomGetBody(pair->o1);
+	b2 = dGeomGetBody(pair->o2);
+
+	Geom *geom1, *geom2;
+	geom1 = (Geom*) dGeomGetData (pair->o1);
+	geom2 = (Geom*) dGeomGetData (pair->o2);
+
+	//OR: do this for all geoms? this is cheapest and most important
+	bool wheel1=false, wheel2=false;
+	if (geom1->wheel)
+	{
+		if (!geom2->wheel && b1)
+			wheel1=true;
+	}
+	else if (geom2->wheel && b2)
+		wheel2=true;
+
+	//store wheel axle direction right once (instead of querying again)
+	dReal wheelaxle[3];
+	if (wheel1)
+	{
+		const dReal *rot = dBodyGetRotation(b1);
+		wheelaxle[0] = rot[2];
+		wheelaxle[1] = rot[6];
+		wheelaxle[2] = rot[10];
+	}
+	else if (wheel2)
+	{
+		const dReal *rot = dBodyGetRotation(b2);
+		wheelaxle[0] = rot[2];
+		wheelaxle[1] = rot[6];
+		wheelaxle[2] = rot[10];
+	}
+
+	Surface *surf1, *surf2;
+	dContact *contact;
+	for (int i=0; i<pair->count; ++i)
+	{
+		contact = &contacts[i].contact;
+		surf1 = contacts[i].surf1;
+		surf2 = contacts[i].surf2;
+
+		//set collision flag for triangles (if trimesh with per-triangle enabled)
+		if (geom1->triangle_count && contact->geom.side1 != -1)
+			geom1->Mark_Triangle(contact->geom.side1);
+		if (geom2->triangle_count && contact->geom.side2 != -1)
+			geom2->Mark_Triangle(contact->geom.side2);
+
+		//as long as one geom got a spring of not 0, it should trigger the other
+		if (surf1->spring) //geom1 would have generated collision
+			pool_colliding[geom2->pool_index] = true; //thus geom2 is colliding
+
+		if (surf2->spring) //geom2 would have generated collision
+			pool_colliding[geom1->pool_index] = true; //thus geom2 is colliding
+
+		//sensor, no contact
+		if (surf1->spring==0 || surf2->spring==0)
+			continue;
 
 		//
 		//simulation of wheel or normal geom?
@@ -360,25 +521,147 @@ void Geom::Collision_Callback (void *data, dGeomID o1, dGeomID o2)
 		//
 		//determine if _one_ of the geoms is a wheel
 		if (wheel1)
-			geom1->wheel->Add_Contact(b1, b2, geom1, geom2, true, wheelaxle, surf2, &contact[i], stepsize); //configures friction values based on slip and similar
+			geom1->wheel->Add_Contact(b1, b2, geom1, geom2, true, wheelaxle, surf2, contact, collision_stepsize); //configures friction values based on slip and similar
 		else if (wheel2)
-			geom2->wheel->Add_Contact(b1, b2, geom1, geom2, false, wheelaxle, surf1, &contact[i], stepsize);
+			geom2->wheel->Add_Contact(b1, b2, geom1, geom2, false, wheelaxle, surf1, contact, collision_stepsize);
 		//TODO: haven't looked at wheel*wheel collision simulation! (will be rim_mu*rim_mu for tyre right now)
 		//if (geom1->wheel&&geom2->wheel)
 		//	?...
 		else
 		{
 			//create the contactjoints for normal collisions (not wheels)
-			dJointID c = dJointCreateContact (simulation_thread.world,simulation_thread.contactgroup,&contact[i]);
+			dJointID c = dJointCreateContact (simulation_thread.world,simulation_thread.contactgroup,contact);
 			dJointAttach (c,b1,b2);
 
 			//if any of the geoms responds to forces or got a body that responds to force, enable force feedback
 			if (geom1->buffer_event || geom2->buffer_event || geom1->force_to_body || geom2->force_to_body)
-				new Collision_Feedback(c, geom1, geom2);
+				Collision_Feedback::Add(c, geom1, geom2);
 		}
 	}
 }
 
+//perform all stages of collision detection
+void Geom::Collide(dReal stepsize)
+{
+	collision_stepsize = stepsize;
+
+	//1: find pairs
+	collision_pairs.clear();
+	dSpaceCollide (simulation_thread.space, NULL, &Collision_Callback);
+
+	//2: collide (wake up other threads, and help out)
+	collision_next_pair = 0;
+
+	int i;
+	for (i=1; i<collision_thread_count; ++i)
+		SDL_SemPost(collision_start);
+
+	Collide_Pairs(&collision_threads[0]);
+
+	for (i=1; i<collision_thread_count; ++i)
+		SDL_SemWait(collision_done);
+
+	//3: commit in order
+	size_t count = collision_pairs.size();
+	for (size_t p=0; p<count; ++p)
+		Commit_Pair(&collision_pairs[p]);
+}
+
+//loop for extra threads colliding pairs
+int Geom::Collision_Thread_Loop(void *data)
+{
+	Collision_Thread *thread = (Collision_Thread*)data;
+
+	//needed for trimesh collisions
+	if (!dAllocateODEDataForThread(dAllocateFlagCollisionData))
+		Log_Add(-1, "Could not allocate collision data for ODE thread %i!", thread->id);
+
+	while (true)
+	{
+		SDL_SemWait(collision_start);
+
+		if (collision_quit)
+			break;
+
+		Collide_Pairs(thread);
+		SDL_SemPost(collision_done);
+	}
+
+	dCleanupODEAllDataForThread();
+	return 0;
+}
+
+void Geom::Collision_Threads_Init(int threads)
+{
+	//(unlike loading_threads, there is no automatic choice)
+	if (threads < 1)
+	{
+		Log_Add(0, "WARNING: threads must be at least 1");
+		threads = 1;
+	}
+
+	//simulation thread is always used
+	collision_threads = new Collision_Thread[threads];
+	collision_threads[0].id = 0;
+	collision_threads[0].thread = NULL;
+	collision_thread_count = 1;
+
+	if (threads < 2)
+		return;
+
+	//trimesh collisions uses data that can't be shared between threads
+	//unless ode was built with thread local storage
+	if (!dCheckConfiguration("ODE_EXT_mt_collisions"))
+	{
+		Log_Add(0, "WARNING: ode built without support for threaded collisions, colliding in one thread");
+		return;
+	}
+
+	Log_Add(1, "Using %i threads for collision detection", threads);
+
+	collision_quit = false;
+	collision_start = SDL_CreateSemaphore(0);
+	collision_done = SDL_CreateSemaphore(0);
+
+	for (int i=1; i<threads; ++i)
+	{
+		collision_threads[i].id = i;
+		collision_threads[i].thread = SDL_CreateThread(Collision_Thread_Loop, &collision_threads[i]);
+
+		if (!collision_threads[i].thread)
+		{
+			Log_Add(0, "WARNING: could only create %i threads for collision detection", i);
+			break;
+		}
+
+		++collision_thread_count;
+	}
+}
+
+void Geom::Collision_Threads_Quit()
+{
+	collision_quit = true;
+
+	int i;
+	for (i=1; i<collision_thread_count; ++i)
+		SDL_SemPost(collision_start);
+	for (i=1; i<collision_thread_count; ++i)
+		SDL_WaitThread(collision_threads[i].thread, NULL);
+
+	if (collision_start)
+	{
+		SDL_DestroySemaphore(collision_start);
+		SDL_DestroySemaphore(collision_done);
+		collision_start = NULL;
+		collision_done = NULL;
+	}
+
+	delete[] collision_threads;
+	collision_threads = NULL;
+	collision_thread_count = 1;
+	collision_pairs.clear();
+}
+
 //
 //set events:
 //
@@ -450,24 +733,26 @@ void Geom::Set_Sensor_Event(Script *s1, Script *s2)
 		sensor_triggered_script=s1;
 		sensor_untriggered_script=s2;
 		sensor_last_state=false;
-		sensor_event=true;
+		pool_sensor[pool_index]=true;
 	}
 	else //disable
-		sensor_event=false;
+		pool_sensor[pool_index]=false;
 }
 
 //physics step
 void Geom::Physics_Step()
 {
 	Geom *geom;
-	for (geom=head; geom; geom=geom->next)
+	size_t count = pool.size();
+	for (size_t i=0; i<count; ++i)
 	{
-		if (geom->sensor_event)
+		if (pool_sensor[i])
 		{
 			//triggered/untriggered
-			if (geom->colliding != geom->sensor_last_state)
+			geom = pool[i];
+			if (pool_colliding[i] != geom->sensor_last_state)
 			{
-				geom->sensor_last_state=geom->colliding;
+				geom->sensor_last_state=pool_colliding[i];
 				Event_Buffer_Add_Triggered(geom);
 			}
 		}
@@ -29,6 +29,7 @@
 #include "assets/model.hpp"
 #include "assets/script.hpp"
 #include <SDL/SDL_stdinc.h> //definition for Uint32
+#include <vector>
 
 //Geom: (meta)data for geometrical shape (for collision detection), for: 
 //contactpoint generation (friction and softness/hardness). Also contains
@@ -59,6 +60,10 @@ class Geom: public Component
 		static void Clear_Collisions();
 		static void Physics_Step();
 
+		//collision detection: finding pairs, colliding and creating contacts
+		static void Collision_Threads_Init(int threads);
+		static void Collision_Threads_Quit();
+		static void Collide(dReal stepsize);
 		static void Collision_Callback(void *, dGeomID, dGeomID);
 
 		//end of methods, variables:
@@ -70,8 +75,12 @@ class Geom: public Component
 
 		//placeholder for more physics data
 
-		//register if geom is colliding
-		bool colliding; //set after each collision
+		//register if geom is colliding (set after each collision)
+		bool Colliding() {return pool_colliding[pool_index];}
+
+		//trimesh: if triangle is colliding, or list of all colliding triangles
+		bool Triangle_Colliding(int t) {return triangle_colliding[t];}
+		const std::vector<int> &Colliding_Triangles() {return triangle_touched;}
 
 
 		//special kind of geoms:
@@ -87,6 +96,7 @@ class Geom: public Component
 		//End of physics data
 		
 		Model_Draw *model; //points at model
+		int render_static; //index in static render tree, or -1 (see render_list)
 
 		//debug variables
 		dGeomID flipper_geom;
@@ -106,7 +116,6 @@ class Geom: public Component
 	private:
 		//events:
 		bool buffer_event;
-		bool sensor_event;
 		//bool radar_event; - TODO
 
 		//sensor events:
@@ -125,23 +134,46 @@ class Geom: public Component
 		//trimesh: how many triangles (0 if not trimesh/disabled) and which colliding:
 		int triangle_count, material_count;
 		bool *triangle_colliding;
+		std::vector<int> triangle_touched; //only these are set in above
 		Model_Mesh::Material *parent_materials;
 		Surface *material_surfaces;
+		Uint16 *triangle_material; //material index of each triangle (when surfaces)
 		//end
 
-		//used to find next/prev geom in list of all geoms
-		//set next to null in last link in chain (prev = NULL in first)
-		static Geom *head; // = NULL;
-		Geom *prev;
-		Geom *next;
+		//collision detection stages (in geom.cpp)
+		static void Collide_Pairs(struct Collision_Thread *thread);
+		static void Collide_Pair(struct Collision_Pair *pair, struct Collision_Thread *thread);
+		static void Commit_Pair(struct Collision_Pair *pair);
+		static int Collision_Thread_Loop(void *data);
+		Surface *Contact_Surface(int side);
+		void Mark_Triangle(int t);
+
+		//trimeshes with colliding triangles (only these needs clearing)
+		static std::vector<Geom*> touched_geoms;
+		//statistics: triangle flags reset, and how many a full clear would reset
+		static unsigned long triangles_reset, triangles_full_clear;
+		static size_t triangles_total;
+
+		//all geoms are kept densely packed in a pool (removing moves the
+		//last geom into the free slot), data checked for all geoms in each
+		//step is kept in separate arrays (indexed the same way) to avoid
+		//touching every geom
+		static std::vector<Geom*> pool;
+		static std::vector<bool> pool_colliding;
+		static std::vector<bool> pool_sensor; //sensor event enabled (sensor_event)
+		size_t pool_index;
 
 		friend class Model_Mesh; //will be required to modify triangle_* stuff above
 		friend void Render_List_Update(); //to allow loop through geoms
+		friend void Render_List_Build(); //dito
+		friend void Render_List_Clear(); //dito
 		friend void Event_Buffers_Process(dReal); //to allow looping
 		friend void Body::Physics_Step (dReal step); //dito
 		friend void Track_Physics_Step();
 		friend void Geom_Render(); //same as above, for debug collision render
 		friend class Wheel; //to set collision feedbacks
+		friend void Simulation_Benchmark(unsigned int steps); //statistics
+		friend class Snapshot; //saves/restores state
 };
 
 #endif
@@ -0,0 +1,249 @@
+/*
+ * ReCaged - a Free Software, Futuristic, Racing Game
+ *
+ * Copyright (C) 2015 Mats Wahlberg
+ *
+ * This file is part of ReCaged.
+ *
+ * ReCaged is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ReCaged is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ReCaged.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+#include "input_log.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <ode/ode.h>
+#include <SDL/SDL_stdinc.h>
+
+#include "common/log.hpp"
+#include "common/threads.hpp"
+#include "assets/car.hpp"
+
+//file starts with header, followed by records (only when controls changed)
+#define INPUT_LOG_VERSION 2
+
+struct Input_Log_Header
+{
+	char magic[4]; //"RCIL"
+	Uint8 version;
+	Uint8 real_size; //sizeof(dReal), must match
+	Uint16 cars; //when started (must match when replaying)
+	Uint32 steps; //number of steps recorded
+	Uint32 checksum; //world at end (Simulation_Checksum)
+};
+
+struct Input_Log_Entry
+{
+	Uint32 step;
+	Uint32 car; //serial (creation order, not position in list)
+	Uint8 drift_brakes;
+	Uint8 unused[3];
+	dReal throttle, steering;
+};
+
+static FILE *record_fp = NULL;
+static bool replaying = false;
+
+static Input_Log_Header header;
+static std::vector<Input_Log_Entry> records; //last recorded (each car), or all to replay
+static size_t next_record; //when replaying
+static Uint32 step; //current step
+
+bool Input_Log_Record(const char *file)
+{
+	Log_Add(1, "Recording car controls to \"%s\"", file);
+
+	if (!(record_fp = fopen(file, "wb")))
+	{
+		Log_Add(-1, "Could not open \"%s\" for recording", file);
+		return false;
+	}
+
+	//header written again when done (with steps and checksum)
+	memcpy(header.magic, "RCIL", 4);
+	header.version = INPUT_LOG_VERSION;
+	header.real_size = sizeof(dReal);
+	header.cars = 0;
+	for (Car *car=Car::head; car; car=car->next)
+		++header.cars;
+	header.steps = 0;
+	header.checksum = 0;
+	fwrite(&header, sizeof(Input_Log_Header), 1, record_fp);
+
+	records.clear();
+	step = 0;
+	return true;
+}
+
+bool Input_Log_Replay(const char *file, unsigned int *steps)
+{
+	Log_Add(1, "Replaying car controls from \"%s\"", file);
+
+	FILE *fp = fopen(file, "rb");
+	if (!fp)
+	{
+		Log_Add(-1, "Could not open \"%s\" for replaying", file);
+		return false;
+	}
+
+	if (	fread(&header, sizeof(Input_Log_Header), 1, fp) != 1 ||
+		memcmp(header.magic, "RCIL", 4) ||
+		header.version != INPUT_LOG_VERSION)
+	{
+		Log_Add(-1, "\"%s\" is not a (supported) input log", file);
+		fclose(fp);
+		return false;
+	}
+
+	if (header.real_size != sizeof(dReal))
+	{
+		Log_Add(-1, "\"%s\" was recorded with different ode precision", file);
+		fclose(fp);
+		return false;
+	}
+
+	records.clear();
+	Input_Log_Entry record;
+	while (fread(&record, sizeof(Input_Log_Entry), 1, fp) == 1)
+		records.push_back(record);
+
+	fclose(fp);
+
+	Log_Add(2, "Input log got %u steps (%u changes) for %u cars",
+			header.steps, (unsigned int)records.size(), header.cars);
+
+	Uint16 cars = 0;
+	for (Car *car=Car::head; car; car=car->next)
+		++cars;
+
+	if (header.cars != cars)
+	{
+		Log_Add(-1, "\"%s\" was recorded with %u cars, not %u (not the same race?)",
+				file, header.cars, cars);
+		records.clear();
+		return false;
+	}
+
+	next_record = 0;
+	step = 0;
+	replaying = true;
+	*steps = header.steps;
+	return true;
+}
+
+bool Input_Log_Recording()
+{
+	return (record_fp != NULL);
+}
+
+bool Input_Log_Replaying()
+{
+	return replaying;
+}
+
+void Input_Log_Step()
+{
+	Car *car;
+	size_t i;
+
+	if (record_fp)
+	{
+		//store controls of all cars that changed (last recorded of each car
+		//found by serial, since position in list changes when creating cars)
+		for (car=Car::head; car; car=car->next)
+		{
+			for (i=0; i<records.size() && records[i].car != car->serial; ++i);
+
+			//new car, make sure stored below
+			if (i == records.size())
+			{
+				Input_Log_Entry record = {0, car->serial, !car->drift_brakes, {0,0,0}, 0.0, 0.0};
+				records.push_back(record);
+			}
+
+			Input_Log_Entry *record = &records[i];
+			if (	record->drift_brakes != car->drift_brakes ||
+				record->throttle != car->throttle ||
+				record->steering != car->steering)
+			{
+				record->step = step;
+				record->drift_brakes = car->drift_brakes;
+				record->throttle = car->throttle;
+				record->steering = car->steering;
+				fwrite(record, sizeof(Input_Log_Entry), 1, record_fp);
+			}
+		}
+	}
+	else if (replaying)
+	{
+		//apply all changes for this step
+		Input_Log_Entry *record;
+		for (; next_record < records.size() && records[next_record].step == step; ++next_record)
+		{
+			record = &records[next_record];
+
+			for (car=Car::head; car && car->serial != record->car; car=car->next);
+
+			if (!car)
+			{
+				Log_Add(-1, "Input log got controls for missing car %u (not the same race?)", record->car);
+				continue;
+			}
+
+			car->drift_brakes = record->drift_brakes;
+			car->throttle = record->throttle;
+			car->steering = record->steering;
+		}
+	}
+
+	++step;
+}
+
+void Input_Log_Close()
+{
+	if (record_fp)
+	{
+		//finish header
+		header.steps = step;
+		header.checksum = Simulation_Checksum();
+		fseek(record_fp, 0, SEEK_SET);
+		fwrite(&header, sizeof(Input_Log_Header), 1, record_fp);
+
+		fclose(record_fp);
+		record_fp = NULL;
+
+		Log_Add(1, "Recorded %u steps of car controls (world checksum %08x)", step, header.checksum);
+	}
+	else if (replaying)
+	{
+		//only comparable if simulated exactly as many steps as recorded
+		if (step != header.steps)
+			Log_Add(1, "Replayed %u of %u recorded steps (can not compare result)", step, header.steps);
+		else
+		{
+			Uint32 checksum = Simulation_Checksum();
+
+			if (checksum == header.checksum)
+				Log_Add(1, "Replay gave identical result (world checksum %08x)", checksum);
+			else
+				Log_Add(0, "WARNING: replay did not give identical result (world checksum %08x, recorded %08x)",
+						checksum, header.checksum);
+		}
+
+		replaying = false;
+	}
+
+	records.clear();
+}
@@ -0,0 +1,43 @@
+/*
+ * ReCaged - a Free Software, Futuristic, Racing Game
+ *
+ * Copyright (C) 2015 Mats Wahlberg
+ *
+ * This file is part of ReCaged.
+ *
+ * ReCaged is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ReCaged is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ReCaged.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+#ifndef _ReCaged_INPUT_LOG_H
+#define _ReCaged_INPUT_LOG_H
+
+//Recording of car controls (throttle, steering, drift brakes) at each
+//simulation step, to a binary file. Replaying it (also when headless) gives
+//exactly the same simulation, as long as the race is set up the same way and
+//nothing else (like creating objects with debug keys) interferes. Requires
+//islands to be stepped in one thread ("threads 1").
+
+//start recording or replaying (replay also tells how many steps recorded)
+bool Input_Log_Record(const char *file);
+bool Input_Log_Replay(const char *file, unsigned int *steps);
+bool Input_Log_Recording();
+bool Input_Log_Replaying();
+
+//store or apply controls, before each step
+void Input_Log_Step();
+
+//stop (and compare end result with recording, if replay)
+void Input_Log_Close();
+
+#endif
@@ -69,6 +69,7 @@ class Joint: public Component
 		friend class Car_Module;
 		friend class Car;
 		friend void Event_Buffers_Process(dReal); //to allow looping
+		friend class Snapshot; //saves/restores state
 };
 
 #endif
@@ -25,6 +25,7 @@
 
 #include "common/threads.hpp"
 #include "common/internal.hpp"
+#include "common/profiler.hpp"
 #include "common/log.hpp"
 #include "common/threads.hpp"
 #include "assets/track.hpp"
@@ -37,10 +38,72 @@
 #include "collision_feedback.hpp"
 #include "event_buffers.hpp"
 #include "timers.hpp"
+#include "snapshot.hpp"
+#include "input_log.hpp"
 
 #include "interface/render_list.hpp"
 
 
+//ode can step independent groups of bodies connected by joints ("islands")
+//on separate threads. Each island is solved separately, but quickstep
+//reorders constraints randomly using one shared seed (dRandInt), so which
+//island gets which numbers depends on thread timing. Results are thus not
+//reproducible between runs (not usable with input logs, see recaged.cpp)
+#ifdef HAVE_DTHREADINGALLOCATEMULTITHREADEDIMPLEMENTATION
+static dThreadingImplementationID threading = NULL;
+static dThreadingThreadPoolID thread_pool = NULL;
+#endif
+
+static void Simulation_Threads_Init(int threads)
+{
+#ifdef HAVE_DTHREADINGALLOCATEMULTITHREADEDIMPLEMENTATION
+	Log_Add(1, "Using %i threads for stepping islands", threads);
+
+	threading = dThreadingAllocateMultiThreadedImplementation();
+
+	//NULL if ode was built without threading implementation
+	if (!threading)
+	{
+		Log_Add(0, "WARNING: ode threading not available, stepping islands in one thread");
+		return;
+	}
+
+	thread_pool = dThreadingAllocateThreadPool(threads, 0, dAllocateFlagBasicData, NULL);
+
+	if (!thread_pool)
+	{
+		Log_Add(0, "WARNING: could not create threads for ode, stepping islands in one thread");
+		dThreadingFreeImplementation(threading);
+		threading = NULL;
+		return;
+	}
+
+	dThreadingThreadPoolServeMultiThreadedImplementation(thread_pool, threading);
+	dWorldSetStepIslandsProcessingMaxThreadCount(simulation_thread.world, threads);
+	dWorldSetStepThreadingImplementation(simulation_thread.world,
+			dThreadingImplementationGetFunctions(threading),
+			threading);
+#else
+	Log_Add(0, "WARNING: built with ode lacking threading support, stepping islands in one thread");
+#endif
+}
+
+static void Simulation_Threads_Quit()
+{
+#ifdef HAVE_DTHREADINGALLOCATEMULTITHREADEDIMPLEMENTATION
+	if (!threading)
+		return;
+
+	dThreadingImplementationShutdownProcessing(threading);
+	dThreadingFreeThreadPool(thread_pool);
+	dWorldSetStepThreadingImplementation(simulation_thread.world, NULL, NULL);
+	dThreadingFreeImplementation(threading);
+
+	threading = NULL;
+	thread_pool = NULL;
+#endif
+}
+
 bool Simulation_Init(void)
 {
 	Log_Add(0, "Initiating simulation");
@@ -80,6 +143,17 @@ bool Simulation_Init(void)
 	//surface layer depth
 	dWorldSetContactSurfaceLayer(simulation_thread.world, internal.surface_layer);
 
+	//step islands in parallel?
+	if (internal.threads > 1)
+		Simulation_Threads_Init(internal.threads);
+
+	//and collide in parallel (if more than one)
+	Geom::Collision_Threads_Init(internal.threads);
+
+	//snapshots for rewinding
+	if (internal.rewind_snapshots > 0)
+		Snapshot::Ring_Init(internal.rewind_snapshots);
+
 	//okay, ready:
 	simulation_thread.runlevel = running;
 
@@ -87,6 +161,91 @@ bool Simulation_Init(void)
 }
 
 
+//timing of each stage of step
+static Profiler profile_collision("collision detection");
+static Profiler profile_wheel("wheels");
+static Profiler profile_car("cars");
+static Profiler profile_geom("geoms");
+static Profiler profile_track("track");
+static Profiler profile_world("world step");
+static Profiler profile_feedback("collision feedback");
+static Profiler profile_body("bodies");
+static Profiler profile_joint("joints");
+static Profiler profile_camera("camera");
+static Profiler profile_events("events and timers");
+static Profiler profile_render_list("render list");
+
+//perform one simulation step (all sub-steps)
+static void Simulation_Step(dReal divided_stepsize)
+{
+	//car controls from (or to) input log
+	Input_Log_Step();
+
+	for (int i=0; i<internal.multiplier; ++i)
+	{
+		//perform collision detection
+		{
+			Profiler_Scope scope(&profile_collision);
+			Geom::Clear_Collisions(); //clear all collision flags
+			Geom::Collide(divided_stepsize);
+		}
+
+		//special
+		{
+			Profiler_Scope scope(&profile_wheel);
+			Wheel::Physics_Step(); //create contacts and rolling resistance
+		}
+		{
+			Profiler_Scope scope(&profile_car);
+			Car::Physics_Step(divided_stepsize); //control, antigrav...
+		}
+		{
+			Profiler_Scope scope(&profile_geom);
+			Geom::Physics_Step(); //sensor/radar handling
+		}
+		{
+			Profiler_Scope scope(&profile_track);
+			Track_Physics_Step(); //recreation/destruction of objects outside track
+		}
+
+		//simulate
+		{
+			Profiler_Scope scope(&profile_world);
+			dWorldQuickStep (simulation_thread.world, divided_stepsize);
+			dJointGroupEmpty (simulation_thread.contactgroup); //clean up collision joints
+		}
+
+		//more
+		{
+			Profiler_Scope scope(&profile_feedback);
+			Collision_Feedback::Physics_Step(divided_stepsize); //forces from collisions
+		}
+		{
+			Profiler_Scope scope(&profile_body);
+			Body::Physics_Step(divided_stepsize); //drag (air/liquid "friction") and recreation
+		}
+		{
+			Profiler_Scope scope(&profile_joint);
+			Joint::Physics_Step(divided_stepsize); //joint forces
+		}
+		{
+			Profiler_Scope scope(&profile_camera);
+			default_camera.Physics_Step(divided_stepsize); //calculate velocity and move
+		}
+	}
+
+	Profiler_Scope scope(&profile_events);
+
+	//previous simulations might have caused events (to be processed by scripts)...
+	Event_Buffers_Process(internal.stepsize);
+
+	//process timers:
+	Animation_Timer::Events_Step(internal.stepsize);
+
+	//(might be) time for new rewind snapshot
+	Snapshot::Ring_Step(internal.stepsize);
+}
+
 int Simulation_Loop (void *d)
 {
 	Log_Add(1, "Starting simulation loop");
@@ -103,49 +262,26 @@ int Simulation_Loop (void *d)
 	//keep running until done
 	while (simulation_thread.runlevel != done)
 	{
-		//only if in active mode do we simulate
-		if (simulation_thread.runlevel == running)
-		{
-			//technically, collision detection doesn't need locking, but this is easier
-			SDL_mutexP(simulation_thread.ode_mutex);
+		//technically, collision detection doesn't need locking, but this is easier
+		SDL_mutexP(simulation_thread.ode_mutex);
 
-			for (int i=0; i<internal.multiplier; ++i)
-			{
-				//perform collision detection
-				Geom::Clear_Collisions(); //clear all collision flags
-				dSpaceCollide (simulation_thread.space, (void*)(&divided_stepsize), &Geom::Collision_Callback);
-
-				//special
-				Wheel::Physics_Step(); //create contacts and rolling resistance
-				Car::Physics_Step(divided_stepsize); //control, antigrav...
-				Geom::Physics_Step(); //sensor/radar handling
-				Track_Physics_Step(); //recreation/destruction of objects outside track
-
-				//simulate
-				dWorldQuickStep (simulation_thread.world, divided_stepsize);
-				dJointGroupEmpty (simulation_thread.contactgroup); //clean up collision joints
-
-				//more
-				Collision_Feedback::Physics_Step(divided_stepsize); //forces from collisions
-				Body::Physics_Step(divided_stepsize); //drag (air/liquid "friction") and recreation
-				Joint::Physics_Step(divided_stepsize); //joint forces
-				default_camera.Physics_Step(divided_stepsize); //calculate velocity and move
-			}
-
-			//previous simulations might have caused events (to be processed by scripts)...
-			Event_Buffers_Process(internal.stepsize);
-
-			//process timers:
-			Animation_Timer::Events_Step(internal.stepsize);
+		//rewind requested by interface (even when paused)
+		Snapshot::Ring_Process_Rewind();
 
-			//done with ode
-			SDL_mutexV(simulation_thread.ode_mutex);
+		//only if in active mode do we simulate
+		if (simulation_thread.runlevel == running)
+			Simulation_Step(divided_stepsize);
 
-			//opdate for interface:
-			Render_List_Update(); //make copy of position/rotation for rendering
+		//update for interface: make copy of position/rotation for rendering
+		//(even when paused, in case camera updates or something). Still
+		//locked, since interface might create objects (growing the pools)
+		{
+			Profiler_Scope scope(&profile_render_list);
+			Render_List_Update();
 		}
-		else
-			Render_List_Update(); //still copy (in case camera updates or something)
+
+		//done with ode
+		SDL_mutexV(simulation_thread.ode_mutex);
 
 		//broadcast to wake up sleeping threads
 		if (internal.sync_interface)
@@ -183,15 +319,138 @@ int Simulation_Loop (void *d)
 		++simulation_thread.count;
 	}
 
-	//remove buffers for building rendering list
-	Render_List_Clear_Simulation();
-
 	return 0;
 }
 
+//fingerprint of current state of all bodies (FNV-1a hash), for checking
+//that changes (like threading) still gives exactly the same simulation
+Uint32 Simulation_Checksum()
+{
+	Uint32 checksum = 2166136261u;
+	const dReal *values[4];
+	const unsigned char *bytes;
+	Body *b;
+	for (size_t k=0; k<Body::pool.size(); ++k)
+	{
+		b = Body::pool[k];
+		values[0] = dBodyGetPosition(b->body_id);
+		values[1] = dBodyGetQuaternion(b->body_id);
+		values[2] = dBodyGetLinearVel(b->body_id);
+		values[3] = dBodyGetAngularVel(b->body_id);
+
+		for (int i=0; i<4; ++i)
+		{
+			bytes = (const unsigned char*)values[i];
+			for (size_t j=0; j<sizeof(dReal)*(i==1? 4: 3); ++j)
+				checksum = (checksum^bytes[j])*16777619u;
+		}
+	}
+
+	return checksum;
+}
+
+//run simulation as fast as possible for a fixed number of steps, without any
+//interface (headless), and print how long each part of the simulation took
+void Simulation_Benchmark(unsigned int steps)
+{
+	Log_Add(0, "Starting headless benchmark: %u steps (%u sub-steps each)", steps, internal.multiplier);
+
+	simulation_thread.count=0;
+	simulation_thread.lag_count=0;
+	simulation_thread.lag_time=0;
+
+	dReal divided_stepsize = internal.stepsize/internal.multiplier;
+	Uint64 stepsize_ns = (Uint64) (internal.stepsize*1000000000.0+0.5);
+
+	Uint64 lag_ns = 0; //time spent over realtime budget
+	Uint64 slowest = 0; //longest single step
+	Uint64 step_start, step_time;
+
+	//always time stages when benchmarking
+	bool profiler_enabled = Profiler::enabled;
+	Profiler::enabled = true;
+	Profiler::Reset_All();
+
+	starttime = SDL_GetTicks(); //no threads to start, but keep track anyway
+	Uint64 start = Clock_Get();
+
+	while (simulation_thread.count < steps && simulation_thread.runlevel != done)
+	{
+		step_start = Clock_Get();
+		Simulation_Step(divided_stepsize);
+		step_time = Clock_Get()-step_start;
+
+		//would this step have lagged behind realtime?
+		if (step_time > stepsize_ns)
+		{
+			++simulation_thread.lag_count;
+			lag_ns += step_time-stepsize_ns;
+		}
+
+		if (step_time > slowest)
+			slowest = step_time;
+
+		++simulation_thread.count;
+	}
+
+	Uint64 total = Clock_Get()-start;
+	racetime = SDL_GetTicks()-starttime;
+	simulation_thread.lag_time = (unsigned int)(lag_ns/1000000);
+	Profiler::enabled = profiler_enabled;
+
+	//avoid dividing by zero below
+	if (!simulation_thread.count)
+	{
+		Log_Add(-1, "No steps simulated in benchmark!");
+		return;
+	}
+	if (!total)
+		total=1;
+
+	unsigned int count = simulation_thread.count;
+	Log_puts(0, "\n   <[ Benchmark ]>\n");
+	Log_Add(0, "Steps:			%u (%u sub-steps, %fs simulated)",
+			count, count*internal.multiplier, internal.stepsize*count);
+	Log_Add(0, "Wall time:			%fs (%fx realtime)",
+			total/1000000000.0, (internal.stepsize*count)/(total/1000000000.0));
+	Log_Add(0, "Steps/second:		%f (%f sub-steps/second)",
+			count/(total/1000000000.0), count*internal.multiplier/(total/1000000000.0));
+	Log_Add(0, "Average step:		%fms (slowest %fms)",
+			total/1000000.0/count, slowest/1000000.0);
+	Log_Add(0, "Lag (over stepsize):	%u steps (%u%%), %fms in total",
+			simulation_thread.lag_count, (100*simulation_thread.lag_count)/count, lag_ns/1000000.0);
+
+	Log_Add(0, "World checksum:		%08x", Simulation_Checksum());
+	Log_Add(0, "Geoms and bodies:		%u and %u", (unsigned int)Geom::pool.size(), (unsigned int)Body::pool.size());
+	Log_Add(0, "Collision feedbacks:	%lu (%lu heap allocations)",
+			Collision_Feedback::count, Collision_Feedback::allocations);
+	Log_Add(0, "Dropped wheel contacts:	%lu", Wheel::overflows);
+	Log_Add(0, "Colliding triangle flags:	%lu reset (instead of %lu by full clears)",
+			Geom::triangles_reset, Geom::triangles_full_clear);
+	if (internal.tyre_check)
+		Log_Add(0, "Tyre friction mismatches:	%lu", Wheel::mismatches);
+
+	//time saving and restoring the whole world (restores to same state)
+	Snapshot snapshot;
+	Uint64 save_start = Clock_Get();
+	snapshot.Save();
+	Uint64 save_time = Clock_Get()-save_start;
+	snapshot.Restore();
+	Uint64 restore_time = Clock_Get()-save_start-save_time;
+	Log_Add(0, "Snapshot:			%u bytes, saved in %fms, restored in %fms",
+			(unsigned int)snapshot.Size(), save_time/1000000.0, restore_time/1000000.0);
+
+	//and wall time for each stage
+	Profiler::Print_All(total);
+}
+
 void Simulation_Quit (void)
 {
 	Log_Add(1, "Quit simulation");
+	Simulation_Threads_Quit();
+	Geom::Collision_Threads_Quit();
+	Collision_Feedback::Free_All();
+	Snapshot::Ring_Quit();
 	dJointGroupDestroy (simulation_thread.contactgroup);
 	dSpaceDestroy (simulation_thread.space);
 	dWorldDestroy (simulation_thread.world);
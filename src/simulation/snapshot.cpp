@@ -0,0 +1,470 @@
+/*
+ * ReCaged - a Free Software, Futuristic, Racing Game
+ *
+ * Copyright (C) 2015 Mats Wahlberg
+ *
+ * This file is part of ReCaged.
+ *
+ * ReCaged is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ReCaged is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ReCaged.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+#include "snapshot.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common/log.hpp"
+#include "body.hpp"
+#include "geom.hpp"
+#include "joint.hpp"
+#include "input_log.hpp"
+#include "assets/car.hpp"
+#include "interface/render_list.hpp"
+
+//format: header, followed by state of each body, geom, joint and car
+#define SNAPSHOT_VERSION 3
+
+struct Snapshot_Header
+{
+	char magic[4]; //"RCSS"
+	Uint8 version;
+	Uint8 real_size; //sizeof(dReal), must match
+	Uint16 unused1;
+	Uint32 bodies, geoms, joints, cars;
+	Uint32 unused2; //(keeps states below aligned)
+};
+
+struct Body_State
+{
+	dReal pos[3], rot[4];
+	dReal vel[3], avel[3];
+	dReal buffer;
+	Uint32 serial; //(of component, must match when restoring)
+	Uint8 enabled;
+};
+
+struct Geom_State
+{
+	dReal pos[3], rot[4]; //only if no body
+	dReal buffer;
+	Uint32 serial;
+	Uint8 sensor_last_state, colliding;
+};
+
+struct Joint_State
+{
+	dReal buffer;
+	Uint32 serial;
+};
+
+struct Car_State
+{
+	dReal throttle, steering;
+	dReal velocity, dir, oldsteerlimit;
+	Uint32 serial; //(of car, must match when restoring)
+	Uint8 drift_brakes;
+};
+
+//take count states of size element from what is left of file (bounded by
+//what is left, so never overflows)
+static bool Snapshot_Part(size_t *left, Uint32 count, size_t element)
+{
+	if (count > *left/element)
+		return false;
+
+	*left -= count*element;
+	return true;
+}
+
+//geoms without body might be moved, but only if got position (not planes)
+static bool Snapshot_Placeable(dGeomID g)
+{
+	return !dGeomGetBody(g) && dGeomGetClass(g) != dPlaneClass;
+}
+
+void Snapshot::Save()
+{
+	Snapshot_Header header;
+	memcpy(header.magic, "RCSS", 4);
+	header.version = SNAPSHOT_VERSION;
+	header.real_size = sizeof(dReal);
+	header.unused1 = 0;
+	header.bodies = Body::pool.size();
+	header.geoms = Geom::pool.size();
+	header.joints = 0;
+	header.cars = 0;
+	header.unused2 = 0;
+
+	Joint *joint;
+	Car *car;
+	for (joint=Joint::head; joint; joint=joint->next)
+		++header.joints;
+	for (car=Car::head; car; car=car->next)
+		++header.cars;
+
+	//everything in one allocation (reused if same size as last time)
+	data.resize(	sizeof(Snapshot_Header)+
+			header.bodies*sizeof(Body_State)+
+			header.geoms*sizeof(Geom_State)+
+			header.joints*sizeof(Joint_State)+
+			header.cars*sizeof(Car_State));
+
+	Uint8 *p = &data[0];
+	memcpy(p, &header, sizeof(Snapshot_Header));
+	p += sizeof(Snapshot_Header);
+
+	//bodies
+	Body *body;
+	Body_State *bs = (Body_State*)p;
+	for (size_t i=0; i<header.bodies; ++i, ++bs)
+	{
+		body = Body::pool[i];
+		memcpy(bs->pos, dBodyGetPosition(body->body_id), sizeof(dReal)*3);
+		memcpy(bs->rot, dBodyGetQuaternion(body->body_id), sizeof(dReal)*4);
+		memcpy(bs->vel, dBodyGetLinearVel(body->body_id), sizeof(dReal)*3);
+		memcpy(bs->avel, dBodyGetAngularVel(body->body_id), sizeof(dReal)*3);
+		bs->buffer = body->buffer;
+		bs->serial = body->serial;
+		bs->enabled = dBodyIsEnabled(body->body_id);
+	}
+
+	//geoms
+	Geom *geom;
+	Geom_State *gs = (Geom_State*)bs;
+	for (size_t i=0; i<header.geoms; ++i, ++gs)
+	{
+		geom = Geom::pool[i];
+		if (Snapshot_Placeable(geom->geom_id))
+		{
+			memcpy(gs->pos, dGeomGetPosition(geom->geom_id), sizeof(dReal)*3);
+			dGeomGetQuaternion(geom->geom_id, gs->rot);
+		}
+		gs->buffer = geom->buffer;
+		gs->serial = geom->serial;
+		gs->sensor_last_state = geom->sensor_last_state;
+		gs->colliding = Geom::pool_colliding[i];
+	}
+
+	//joints
+	Joint_State *js = (Joint_State*)gs;
+	for (joint=Joint::head; joint; joint=joint->next, ++js)
+	{
+		js->buffer = joint->buffer;
+		js->serial = joint->serial;
+	}
+
+	//cars
+	Car_State *cs = (Car_State*)js;
+	for (car=Car::head; car; car=car->next, ++cs)
+	{
+		cs->throttle = car->throttle;
+		cs->steering = car->steering;
+		cs->velocity = car->velocity;
+		cs->dir = car->dir;
+		cs->oldsteerlimit = car->oldsteerlimit;
+		cs->serial = car->serial;
+		cs->drift_brakes = car->drift_brakes;
+	}
+}
+
+bool Snapshot::Restore()
+{
+	if (data.empty())
+	{
+		Log_Add(-1, "Tried to restore empty snapshot");
+		return false;
+	}
+
+	Snapshot_Header *header = (Snapshot_Header*)&data[0];
+
+	//make sure the same objects
+	Joint *joint;
+	Car *car;
+	Uint32 joints=0, cars=0;
+	for (joint=Joint::head; joint; joint=joint->next)
+		++joints;
+	for (car=Car::head; car; car=car->next)
+		++cars;
+
+	bool same =	header->bodies == Body::pool.size() && header->geoms == Geom::pool.size() &&
+			header->joints == joints && header->cars == cars;
+
+	//same counts could still be different objects (pools move last into
+	//removed), so check each one before changing anything
+	Body_State *bs = (Body_State*)(header+1);
+	Geom_State *gs = (Geom_State*)(bs+header->bodies);
+	Joint_State *js = (Joint_State*)(gs+header->geoms);
+	Car_State *cs = (Car_State*)(js+header->joints);
+	for (size_t i=0; same && i<header->bodies; ++i)
+		same = (bs[i].serial == Body::pool[i]->serial);
+	for (size_t i=0; same && i<header->geoms; ++i)
+		same = (gs[i].serial == Geom::pool[i]->serial);
+	for (joint=Joint::head; same && joint; joint=joint->next, ++js)
+		same = (js->serial == joint->serial);
+	for (car=Car::head; same && car; car=car->next, ++cs)
+		same = (cs->serial == car->serial);
+
+	if (!same)
+	{
+		Log_Add(-1, "Can not restore snapshot: objects have been created or destroyed since");
+		return false;
+	}
+
+	//bodies
+	Body *body;
+	for (size_t i=0; i<header->bodies; ++i, ++bs)
+	{
+		body = Body::pool[i];
+		dBodySetPosition(body->body_id, bs->pos[0], bs->pos[1], bs->pos[2]);
+		dBodySetQuaternion(body->body_id, bs->rot);
+		dBodySetLinearVel(body->body_id, bs->vel[0], bs->vel[1], bs->vel[2]);
+		dBodySetAngularVel(body->body_id, bs->avel[0], bs->avel[1], bs->avel[2]);
+		body->buffer = bs->buffer;
+
+		if (bs->enabled)
+			dBodyEnable(body->body_id);
+		else
+			dBodyDisable(body->body_id);
+	}
+
+	//geoms
+	Geom *geom;
+	for (size_t i=0; i<header->geoms; ++i, ++gs)
+	{
+		geom = Geom::pool[i];
+		if (Snapshot_Placeable(geom->geom_id))
+		{
+			//static render tree only knows the old position
+			if (geom->render_static != -1)
+			{
+				const dReal *pos = dGeomGetPosition(geom->geom_id);
+				dQuaternion rot;
+				dGeomGetQuaternion(geom->geom_id, rot);
+				if (memcmp(pos, gs->pos, sizeof(dReal)*3) || memcmp(rot, gs->rot, sizeof(dQuaternion)))
+					Render_List_Remove_Static(geom);
+			}
+
+			dGeomSetPosition(geom->geom_id, gs->pos[0], gs->pos[1], gs->pos[2]);
+			dGeomSetQuaternion(geom->geom_id, gs->rot);
+		}
+		geom->buffer = gs->buffer;
+		geom->sensor_last_state = gs->sensor_last_state;
+		Geom::pool_colliding[i] = gs->colliding;
+	}
+
+	//joints
+	js = (Joint_State*)gs;
+	for (joint=Joint::head; joint; joint=joint->next, ++js)
+		joint->buffer = js->buffer;
+
+	//cars
+	cs = (Car_State*)js;
+	for (car=Car::head; car; car=car->next, ++cs)
+	{
+		car->throttle = cs->throttle;
+		car->steering = cs->steering;
+		car->velocity = cs->velocity;
+		car->dir = cs->dir;
+		car->oldsteerlimit = cs->oldsteerlimit;
+		car->drift_brakes = cs->drift_brakes;
+	}
+
+	return true;
+}
+
+size_t Snapshot::Size()
+{
+	return data.size();
+}
+
+bool Snapshot::Write(const char *file)
+{
+	Log_Add(1, "Writing snapshot to \"%s\"", file);
+
+	FILE *fp = fopen(file, "wb");
+	if (!fp)
+	{
+		Log_Add(-1, "Could not open \"%s\" for writing snapshot", file);
+		return false;
+	}
+
+	bool ok = (fwrite(&data[0], data.size(), 1, fp) == 1);
+	fclose(fp);
+
+	if (!ok)
+		Log_Add(-1, "Could not write snapshot to \"%s\"", file);
+
+	return ok;
+}
+
+bool Snapshot::Read(const char *file)
+{
+	Log_Add(1, "Reading snapshot from \"%s\"", file);
+
+	FILE *fp = fopen(file, "rb");
+	if (!fp)
+	{
+		Log_Add(-1, "Could not open \"%s\" for reading snapshot", file);
+		return false;
+	}
+
+	//check header first
+	Snapshot_Header header;
+	if (	fread(&header, sizeof(Snapshot_Header), 1, fp) != 1 ||
+		memcmp(header.magic, "RCSS", 4) || header.version != SNAPSHOT_VERSION)
+	{
+		Log_Add(-1, "\"%s\" is not a (supported) snapshot", file);
+		fclose(fp);
+		return false;
+	}
+
+	if (header.real_size != sizeof(dReal))
+	{
+		Log_Add(-1, "\"%s\" was saved with different ode precision", file);
+		fclose(fp);
+		return false;
+	}
+
+	//counts must fit in (and fill) the rest of the file
+	long end = -1;
+	if (!fseek(fp, 0, SEEK_END))
+		end = ftell(fp);
+
+	if (end < (long)sizeof(Snapshot_Header) || fseek(fp, sizeof(Snapshot_Header), SEEK_SET))
+	{
+		Log_Add(-1, "Could not read snapshot \"%s\"", file);
+		fclose(fp);
+		return false;
+	}
+
+	size_t size = end-sizeof(Snapshot_Header), left = size;
+	if (	!Snapshot_Part(&left, header.bodies, sizeof(Body_State)) ||
+		!Snapshot_Part(&left, header.geoms, sizeof(Geom_State)) ||
+		!Snapshot_Part(&left, header.joints, sizeof(Joint_State)) ||
+		!Snapshot_Part(&left, header.cars, sizeof(Car_State)) || left)
+	{
+		Log_Add(-1, "Snapshot \"%s\" is truncated or corrupt", file);
+		fclose(fp);
+		return false;
+	}
+
+	data.resize(sizeof(Snapshot_Header)+size);
+	memcpy(&data[0], &header, sizeof(Snapshot_Header));
+
+	if (size && fread(&data[sizeof(Snapshot_Header)], size, 1, fp) != 1)
+	{
+		Log_Add(-1, "Could not read snapshot \"%s\"", file);
+		data.clear();
+		fclose(fp);
+		return false;
+	}
+
+	fclose(fp);
+	return true;
+}
+
+
+//
+//ring of snapshots:
+//
+Snapshot *Snapshot::ring = NULL;
+int Snapshot::ring_size = 0;
+int Snapshot::ring_count = 0;
+int Snapshot::ring_last = 0;
+dReal Snapshot::ring_time = 0.0;
+bool Snapshot::ring_rewind = false;
+
+void Snapshot::Ring_Init(int size)
+{
+	Log_Add(2, "Keeping %i snapshots for rewinding", size);
+
+	ring = new Snapshot[size];
+	ring_size = size;
+	ring_count = 0;
+	ring_last = size-1;
+	ring_time = 0.0;
+}
+
+void Snapshot::Ring_Step(dReal step)
+{
+	if (!ring)
+		return;
+
+	ring_time += step;
+
+	//one each second
+	if (ring_time < 1.0)
+		return;
+
+	ring_time -= 1.0;
+	ring_last = (ring_last+1)%ring_size;
+	ring[ring_last].Save();
+
+	if (ring_count < ring_size)
+		++ring_count;
+}
+
+//only sets flag: restoring changes ode state and the static render tree, both
+//only touched by simulation thread (which rewinds before its next step)
+void Snapshot::Ring_Request_Rewind()
+{
+	ring_rewind = true;
+}
+
+void Snapshot::Ring_Process_Rewind()
+{
+	if (!ring_rewind)
+		return;
+
+	ring_rewind = false;
+	Ring_Rewind();
+}
+
+bool Snapshot::Ring_Rewind()
+{
+	//would no longer match the logged controls
+	if (Input_Log_Recording() || Input_Log_Replaying())
+	{
+		Log_Add(0, "WARNING: can not rewind while recording or replaying car controls");
+		return false;
+	}
+
+	if (!ring_count)
+	{
+		Log_Add(1, "No snapshot to rewind to");
+		return false;
+	}
+
+	//objects changed, all snapshots useless
+	if (!ring[ring_last].Restore())
+	{
+		ring_count = 0;
+		return false;
+	}
+
+	//next time, rewind further
+	--ring_count;
+	ring_last = (ring_last+ring_size-1)%ring_size;
+	ring_time = 0.0;
+	return true;
+}
+
+void Snapshot::Ring_Quit()
+{
+	delete[] ring;
+	ring = NULL;
+	ring_size = 0;
+	ring_count = 0;
+	ring_rewind = false;
+}
@@ -0,0 +1,64 @@
+/*
+ * ReCaged - a Free Software, Futuristic, Racing Game
+ *
+ * Copyright (C) 2015 Mats Wahlberg
+ *
+ * This file is part of ReCaged.
+ *
+ * ReCaged is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ReCaged is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ReCaged.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+
+#ifndef _ReCaged_SNAPSHOT_H
+#define _ReCaged_SNAPSHOT_H
+
+#include <vector>
+#include <ode/ode.h>
+#include <SDL/SDL_stdinc.h>
+
+//Snapshot: copy of the changing state of all bodies, geoms, joints and cars
+//(positions, rotations, velocities, enabled flags, event buffers and car
+//controls). Can only be restored while the same objects exists (not if any
+//was created or destroyed since), which is checked when restoring (using the
+//creation order of each body, geom, joint and car, so files only work for
+//races set up the same way).
+class Snapshot
+{
+	public:
+		void Save(); //store current state
+		bool Restore(); //return to stored state
+		size_t Size(); //in bytes
+
+		//binary file (versioned)
+		bool Write(const char *file);
+		bool Read(const char *file);
+
+		//ring of snapshots (one each second) for rewinding
+		static void Ring_Init(int size);
+		static void Ring_Step(dReal step); //after each step
+		static void Ring_Request_Rewind(); //go back to last snapshot (ode_mutex locked)
+		static void Ring_Process_Rewind(); //if requested (simulation thread, before step)
+		static void Ring_Quit();
+
+	private:
+		std::vector<Uint8> data;
+
+		static bool Ring_Rewind();
+
+		static Snapshot *ring;
+		static int ring_size, ring_count, ring_last;
+		static dReal ring_time;
+		static bool ring_rewind; //requested
+};
+
+#endif
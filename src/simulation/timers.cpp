@@ -22,6 +22,7 @@
 #include "timers.hpp"
 #include "geom.hpp"
 #include "assets/object.hpp"
+#include "interface/render_list.hpp"
 
 Animation_Timer *Animation_Timer::head = NULL;
 
@@ -77,6 +78,7 @@ void Animation_Timer::Events_Step(dReal  step)
 		dGeomID geom = (dGeomID)timer->script;
 		const dReal *pos = dGeomGetPosition(geom);
 		dGeomSetPosition(geom, pos[0], pos[1], timer->counter);
+		Render_List_Remove_Static((Geom*)dGeomGetData(geom)); //moving now
 
 		//depending on which direction counter goes (increase/decrease) determine if reached goal
 		if (	(timer->speed > 0 && timer->counter >= timer->goal) || //counter increased to goal
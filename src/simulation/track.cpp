@@ -30,14 +30,13 @@
 //TODO: can use arbitrary geoms and collisions instead, but better when lua
 void Track_Physics_Step()
 {
-	Body *body, *bnext = Body::head;
+	Body *body;
+	Geom *geom;
 
-	Geom *geom, *gnext;
-
-	while ((body = bnext))
+	//backwards (removing moves last body/geom into its place)
+	for (size_t b=Body::pool.size(); b>0; --b)
 	{
-		//store pointer to next (if removing below)
-		bnext = body->next;
+		body = Body::pool[b-1];
 
 		const dReal *pos = dBodyGetPosition(body->body_id); //get position
 		if (pos[2] < track.restart) //under restart height
@@ -52,10 +51,9 @@ void Track_Physics_Step()
 			{
 				//find all geoms that are attached to this body (proper cleanup)
 				//ode lacks a "dBodyGetGeom" routine (why?! it's easy to implement!)...
-				gnext = Geom::head;
-				while ((geom = gnext))
+				for (size_t g=Geom::pool.size(); g>0; --g)
 				{
-					gnext=geom->next; //needs this after possibly destroying the geom (avoid segfault)
+					geom = Geom::pool[g-1];
 					if (dGeomGetBody(geom->geom_id) == body->body_id)
 						delete geom;
 				}
@@ -25,6 +25,7 @@
 #include "collision_feedback.hpp"
 #include "common/internal.hpp" 
 #include "common/threads.hpp" 
+#include "common/log.hpp"
 #include "assets/track.hpp"
 
 //This code tries to implement a reasonably simple and realistic tyre friction model.
@@ -85,6 +86,9 @@
 	(A)[2]=(B)[2]*(C);}
 
 Wheel *Wheel::head = NULL;
+unsigned long Wheel::overflows = 0;
+unsigned long Wheel::mismatches = 0;
+
 //just some default, crappy, values (to ensure safe simulations)
 Wheel::Wheel()
 {
@@ -123,6 +127,29 @@ Wheel::Wheel()
 	alt_load = true;
 	alt_load_damp = true;
 
+	//allocate contact points once
+	point_max = internal.contact_points;
+	point_count = 0;
+	points = new pointstore[point_max];
+
+	//(all arrays in one allocation)
+	normal_x = new dReal[15*point_max];
+	normal_y = normal_x+point_max;
+	normal_z = normal_y+point_max;
+	point_slip_ratio = normal_z+point_max;
+	point_slip_angle = point_slip_ratio+point_max;
+	point_slip_x = point_slip_angle+point_max;
+	point_slip_y = point_slip_x+point_max;
+	point_depth = point_slip_y+point_max;
+	point_vel_z = point_depth+point_max;
+	point_erp = point_vel_z+point_max;
+	point_cfm = point_erp+point_max;
+	point_sensitivity = point_cfm+point_max;
+	point_surface_mu = point_sensitivity+point_max;
+	point_mu1 = point_surface_mu+point_max;
+	point_mu2 = point_mu1+point_max;
+	point_stepsize = 0.0;
+
 	rollrestorque=0.0;
 	rollresjoint=dJointCreateAMotor(simulation_thread.world, 0);
 	rollreswbody=NULL;
@@ -143,6 +170,9 @@ Wheel::~Wheel()
 		next->prev=prev;
 
 	dJointDestroy(rollresjoint);
+
+	delete[] points;
+	delete[] normal_x;
 }
 
 //find similar, close contact points and merge them
@@ -153,36 +183,62 @@ void Wheel::Physics_Step()
 	dJointID joint;
 	Geom *g1, *g2;
 	dContact *contact;
+	dReal x, y, z, mix_dot, wheeldivide;
+	const dReal *nx, *ny, *nz;
 	for (Wheel *wheel=head; wheel; wheel=wheel->next)
 	{
 		//create contact points (and modify for similar joints)
-		count=wheel->points.size();
-		dReal wheeldivide[count];
-		for (i=0; i<count; ++i)
-			wheeldivide[i]=1.0;
+		count=wheel->point_count;
+		nx=wheel->normal_x;
+		ny=wheel->normal_y;
+		nz=wheel->normal_z;
+		mix_dot=wheel->mix_dot;
 
-		for (i=0; i<count; ++i)
+		//friction for all points
+		wheel->Friction();
+
+		//compare with reference
+		if (internal.tyre_check)
 		{
-			//check matches
-			for (j=i+1; j<count; ++j)
+			dReal mu1, mu2;
+			for (i=0; i<count; ++i)
 			{
-				//normals are similar enough
-				if (VDot(wheel->points[j].contact.geom.normal, wheel->points[i].contact.geom.normal) > wheel->mix_dot)
+				wheel->Friction_Reference(i, &mu1, &mu2);
+
+				if (	fabs(mu1-wheel->point_mu1[i]) > 1e-9*(1.0+fabs(mu1)) ||
+					fabs(mu2-wheel->point_mu2[i]) > 1e-9*(1.0+fabs(mu2)) )
 				{
-					wheeldivide[i]+=1.0;
-					wheeldivide[j]+=1.0;
+					Log_Add(0, "WARNING: tyre friction mismatch: %g,%g (reference %g,%g)",
+							wheel->point_mu1[i], wheel->point_mu2[i], mu1, mu2);
+					++mismatches;
 				}
 			}
+		}
+
+		for (i=0; i<count; ++i)
+		{
+			//count all points with similar enough normals (including
+			//itself, removed below). no branches: can be vectorized
+			x=nx[i]; y=ny[i]; z=nz[i];
+			wheeldivide=0.0;
+			for (j=0; j<count; ++j)
+				wheeldivide += (nx[j]*x + ny[j]*y + nz[j]*z > mix_dot)? 1.0: 0.0;
+
+			//itself should always count
+			if (!(x*x + y*y + z*z > mix_dot))
+				wheeldivide+=1.0;
 
 			contact = &wheel->points[i].contact;
+			contact->surface.mu = wheel->point_mu1[i];
+			contact->surface.mu2 = wheel->point_mu2[i];
 
 			//divide spring&damping values by wheeldivide
 			//(ironically, multiplying  cfm accomplishes that)
-			contact->surface.soft_cfm *= wheeldivide[i];
+			contact->surface.soft_cfm *= wheeldivide;
 
 			//and scale friction
-			contact->surface.mu /= wheeldivide[i];
-			contact->surface.mu2 /= wheeldivide[i];
+			contact->surface.mu /= wheeldivide;
+			contact->surface.mu2 /= wheeldivide;
 
 			//create
 			joint = dJointCreateContact (simulation_thread.world, simulation_thread.contactgroup, contact);
@@ -192,11 +248,11 @@ void Wheel::Physics_Step()
 			g1 = wheel->points[i].g1;
 			g2 = wheel->points[i].g2;
 			if (g1->buffer_event || g2->buffer_event || g1->force_to_body || g2->force_to_body)
-				new Collision_Feedback(joint, g1, g2);
+				Collision_Feedback::Add(joint, g1, g2);
 		}
 
 		//remove
-		wheel->points.clear();
+		wheel->point_count=0;
 
 
 		//create rolling resistance (using amotor joint)
@@ -270,7 +326,7 @@ void Wheel::Add_Contact(	dBodyID b1, dBodyID b2, Geom *g1, Geom *g2,
 		dJointAttach (c,b1,b2);
 
 		if (g1->buffer_event || g2->buffer_event || g1->force_to_body || g2->force_to_body)
-			new Collision_Feedback(c, g1, g2);
+			Collision_Feedback::Add(c, g1, g2);
 
 		return; //nothing more to do, rim mu already calculated
 	}
@@ -352,34 +408,191 @@ void Wheel::Add_Contact(	dBodyID b1, dBodyID b2, Geom *g1, Geom *g2,
 	//as defined (and convert to degrees)
 	slip_angle = (180.0/M_PI)* atan(Vsy/denom);
 
+	//
+	//2) store for computing friction later (for all points at once)
+	//
+	if (point_count < point_max)
+	{
+		int i = point_count++;
+		pointstore pstore={*contact, b1, b2, g1, g2};
+		points[i] = pstore;
+		normal_x[i] = Z[0];
+		normal_y[i] = Z[1];
+		normal_z[i] = Z[2];
+
+		point_slip_ratio[i] = slip_ratio;
+		point_slip_angle[i] = slip_angle;
+		point_slip_x[i] = Vsx;
+		point_slip_y[i] = Vsy;
+		point_depth[i] = contact->geom.depth;
+		point_vel_z[i] = VDot(Z, Vpoint);
+		point_erp[i] = contact->surface.soft_erp;
+		point_cfm[i] = contact->surface.soft_cfm;
+		point_sensitivity[i] = surface->sensitivity;
+		point_surface_mu[i] = surface->mu;
+		point_stepsize = stepsize;
+
+		//enable: separate mu for dir 1&2, specify dir 1
+		//(note: dir2 is automatically calculated by ode)
+		contact = &points[i].contact;
+		contact->surface.mode |= dContactMu2 | dContactFDir1;
+
+		if (alt_load)
+			contact->surface.mode ^= dContactApprox1;
+
+		//specify X direction
+		contact->fdir1[0] = X[0];
+		contact->fdir1[1] = X[1];
+		contact->fdir1[2] = X[2];
+	}
+	else
+	{
+		if (!overflows)
+			Log_Add(0, "WARNING: too many contact points for wheel (increase contact_points?)");
+		++overflows;
+	}
+
+	//
+	//3) rolling resistance (surface/wheel braking torque)
+	//
+	//(rolling speed and compression is ignored
+	//
+
+	//wheel rolling resistance (scaled by surface)
+	dReal res = rollres*surface->rollres;
+
+	//if more than current detected rolling resistance
+	if (res > rollrestorque)
+	{
+		//store torque, axle direction and bodies
+		rollrestorque=res;
+		rollresaxis[0]=wheelaxle[0];
+		rollresaxis[1]=wheelaxle[1];
+		rollresaxis[2]=wheelaxle[2];
+		rollreswbody=wbody;
+		rollresobody=obody;
+	}
+}
+
+
+//
+//computation of friction for stored points (continuation of the above).
+//
+//Uses second and third degree polynoms to interpolate points to get a
+//magic-formula-like curve.
+//
+//Then applies "combined slip/grip" (scale Fx and Fy to combine):
+//fdir1 and fdir2 are set so that a different mu can be given for fdir1
+//(along wheel heading) and fdir2 (sideways). Since ODE uses a less
+//realistic "box" (actually pyramid) friction approximation (movement
+//along both direction 1 and 2 results in more friction than movement
+//along only one direction). To solve this, lets apply a "combined
+//slip/grip" model. There are many different solutions to this.... This
+//is just based on an circle/ellipse friction curve and the x&y slips.
+//It's not at all as advanced as "Modified Nicolas-Comstock Model" (as
+//suggested by SAE), or the method suggested in:
+//http://www.control.lth.se/documents/2003/gaf%2B03.pdf
+//But it is reliable and simple and does seem to give a good result.
+//
+
+//all points at once: no branches or function calls in loop (all parts of
+//curves are computed, and the right one selected), so the compiler can
+//compute several points in parallel (simd)
+void Wheel::Friction()
+{
+	int count = point_count;
+
+	//local copies (not changed by writing results)
+	const dReal xs_mu=x_static_mu, xp_pos=x_peak_pos, xp_mu=x_peak_mu, xt_pos=x_tail_pos, xt_mu=x_tail_mu;
+	const dReal ys_mu=y_static_mu, yp_pos=y_peak_pos, yp_mu=y_peak_mu, yt_pos=y_tail_pos, yt_mu=y_tail_mu;
+	const dReal x_min=x_min_combine, y_min=y_min_combine, x_scale=x_scale_combine, y_scale=y_scale_combine;
+
+	const dReal *ratio=point_slip_ratio, *angle=point_slip_angle;
+	const dReal *Vsx=point_slip_x, *Vsy=point_slip_y;
+	const dReal *sens=point_sensitivity, *smu=point_surface_mu;
+	dReal *mu1=point_mu1, *mu2=point_mu2;
+
+	dReal t, t1, t2, x_mu, y_mu, denom;
+	int i;
+
+	//(the arrays never overlap, tell gcc not to worry)
+#pragma GCC ivdep
+	for (i=0; i<count; ++i)
+	{
+		//longitudinal
+		t=ratio[i]*sens[i];
+		t1=t/xp_pos;
+		t2=(t-xp_pos)/(xt_pos-xp_pos);
+		x_mu=	(t < xp_pos)? xs_mu+(xp_mu-xs_mu)*t1*(2.0-t1):
+			(t < xt_pos)? xp_mu+(xt_mu-xp_mu)*t2*t2*(3.0-2.0*t2):
+			xt_mu;
+
+		//lateral
+		t=angle[i]*sens[i];
+		t1=t/yp_pos;
+		t2=(t-yp_pos)/(yt_pos-yp_pos);
+		y_mu=	(t < yp_pos)? ys_mu+(yp_mu-ys_mu)*t1*(2.0-t1):
+			(t < yt_pos)? yp_mu+(yt_mu-yp_mu)*t2*t2*(3.0-2.0*t2):
+			yt_mu;
+
+		//combined
+		denom=(Vsx[i]<x_min)? x_min: Vsx[i];
+		x_mu/=sqrt(1.0+x_scale*Vsy[i]*Vsy[i]/(denom*denom));
+
+		denom=(Vsy[i]<y_min)? y_min: Vsy[i];
+		y_mu/=sqrt(1.0+y_scale*Vsx[i]*Vsx[i]/(denom*denom));
+
+		//scale with driving surface
+		mu1[i]=x_mu*smu[i];
+		mu2[i]=y_mu*smu[i];
+	}
+
+	//manually calculate Fz?
+	if (alt_load)
+	{
+		const dReal *depth=point_depth, *Vz=point_vel_z, *erp=point_erp, *cfm=point_cfm;
+		const dReal step=point_stepsize;
+		const bool damp=alt_load_damp;
+		dReal Fz;
+
+#pragma GCC ivdep
+		for (i=0; i<count; ++i)
+		{
+			Fz=erp[i]/(cfm[i]*step)*depth[i];
+			Fz-=damp? (1.0-erp[i])/cfm[i]*Vz[i]: 0.0;
+			Fz=(Fz < 0.0)? 0.0: Fz;
+
+			mu1[i]*=Fz;
+			mu2[i]*=Fz;
+		}
+	}
+}
+
+//one point at a time, the straightforward way (for checking the above)
+void Wheel::Friction_Reference(int i, dReal *mu1, dReal *mu2)
+{
+	dReal t, x_mu, y_mu, denom;
+	dReal Vsx=point_slip_x[i], Vsy=point_slip_y[i];
+
 	//manually calculate Fz?
 	dReal Fz=0;
 	if (alt_load)
 	{
-		dReal spring=contact->surface.soft_erp/(contact->surface.soft_cfm*stepsize);
-		Fz=spring*contact->geom.depth;
+		dReal spring=point_erp[i]/(point_cfm[i]*point_stepsize);
+		Fz=spring*point_depth[i];
 
 		if (alt_load_damp)
 		{
-			dReal damping=(1.0-contact->surface.soft_erp)/contact->surface.soft_cfm;
-			dReal Vz=VDot(Z, Vpoint);
-			Fz-=damping*Vz;
+			dReal damping=(1.0-point_erp[i])/point_cfm[i];
+			Fz-=damping*point_vel_z[i];
 		}
 
 		if (Fz < 0.0)
 			Fz=0.0;
 	}
-	//
-	//2.1) compute output values (almost):
-	//
-	//Uses second and third degree polynoms to interpolate points to get a
-	//magic-formula-like curve.
-	//
-
-	dReal t, x_mu, y_mu;
 
 	//longitudinal
-	t=slip_ratio*surface->sensitivity;
+	t=point_slip_ratio[i]*point_sensitivity[i];
 	if (t < x_peak_pos)
 	{
 		t=t/x_peak_pos;
@@ -394,7 +607,7 @@ void Wheel::Add_Contact(	dBodyID b1, dBodyID b2, Geom *g1, Geom *g2,
 		x_mu=x_tail_mu;
 
 	//lateral
-	t=slip_angle*surface->sensitivity;
+	t=point_slip_angle[i]*point_sensitivity[i];
 	if (t < y_peak_pos)
 	{
 		t=t/y_peak_pos;
@@ -408,22 +621,6 @@ void Wheel::Add_Contact(	dBodyID b1, dBodyID b2, Geom *g1, Geom *g2,
 	else
 		y_mu=y_tail_mu;
 
-	//
-	//2.2) combined slip/grip (scale Fx and Fy to combine)
-	//
-	//fdir1 and fdir2 are set so that a different mu can be given for fdir1
-	//(along wheel heading) and fdir2 (sideways). Since ODE uses a less
-	//realistic "box" (actually pyramid) friction approximation (movement
-	//along both direction 1 and 2 results in more friction than movement
-	//along only one direction). To solve this, lets apply a "combined
-	//slip/grip" model. There are many different solutions to this.... This
-	//is just based on an circle/ellipse friction curve and the x&y slips.
-	//It's not at all as advanced as "Modified Nicolas-Comstock Model" (as
-	//suggested by SAE), or the method suggested in:
-	//http://www.control.lth.se/documents/2003/gaf%2B03.pdf
-	//But it is reliable and simple and does seem to give a good result.
-	//
-
 	//prevent unstable at low velocity (prevents/oscilates static friction)
 	denom=(Vsx<x_min_combine)? x_min_combine: Vsx;
 
@@ -435,53 +632,13 @@ void Wheel::Add_Contact(	dBodyID b1, dBodyID b2, Geom *g1, Geom *g2,
 	denom=(Vsy<y_min_combine)? y_min_combine: Vsy;
 	y_mu/=sqrt(1.0+y_scale_combine*Vsx*Vsx/(denom*denom));
 
-	//
-	//2.3) set new friction values
-	//
-
-	//enable: separate mu for dir 1&2, specify dir 1
-	//(note: dir2 is automatically calculated by ode)
-	contact->surface.mode |= dContactMu2 | dContactFDir1;
-
-	//specify X direction
-	contact->fdir1[0] = X[0];
-	contact->fdir1[1] = X[1];
-	contact->fdir1[2] = X[2];
-
 	//specify mu1 and mu2 (scale with driving surface)
-	contact->surface.mu = x_mu*surface->mu;
-	contact->surface.mu2 = y_mu*surface->mu;
+	*mu1 = x_mu*point_surface_mu[i];
+	*mu2 = y_mu*point_surface_mu[i];
 
 	if (alt_load)
 	{
-		contact->surface.mode ^= dContactApprox1;
-		contact->surface.mu *= Fz;
-		contact->surface.mu2 *= Fz;
-	}
-
-	//store (applied later)
-	pointstore pstore={*contact, b1, b2, g1, g2};
-	points.push_back(pstore);
-
-	//
-	//4) rolling resistance (surface/wheel braking torque)
-	//
-	//(rolling speed and compression is ignored
-	//
-
-	//wheel rolling resistance (scaled by surface)
-	dReal res = rollres*surface->rollres;
-
-	//if more than current detected rolling resistance
-	if (res > rollrestorque)
-	{
-		//store torque, axle direction and bodies
-		rollrestorque=res;
-		rollresaxis[0]=wheelaxle[0];
-		rollresaxis[1]=wheelaxle[1];
-		rollresaxis[2]=wheelaxle[2];
-		rollreswbody=wbody;
-		rollresobody=obody;
+		*mu1 *= Fz;
+		*mu2 *= Fz;
 	}
 }
-
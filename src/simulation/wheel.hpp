@@ -36,6 +36,12 @@ class Wheel
 
 		static void Physics_Step();
 
+		//contact points dropped since start (more than contact_points)
+		static unsigned long overflows;
+
+		//friction computations not matching reference (tyre_check)
+		static unsigned long mismatches;
+
 		//used primarily by car, but can be used independently
 		Wheel();
 		~Wheel();
@@ -74,7 +80,22 @@ class Wheel
 			Geom *g1, *g2;
 		};
 
-		std::vector<pointstore> points;
+		//fixed number of points (internal.contact_points), and normals
+		//of points stored separately (x,y,z) for comparing
+		pointstore *points;
+		dReal *normal_x, *normal_y, *normal_z;
+		int point_count, point_max;
+
+		//values for each point, for computing friction of all at once
+		dReal *point_slip_ratio, *point_slip_angle;
+		dReal *point_slip_x, *point_slip_y; //slip velocities
+		dReal *point_depth, *point_vel_z, *point_erp, *point_cfm; //for load
+		dReal *point_sensitivity, *point_surface_mu; //from surface
+		dReal *point_mu1, *point_mu2; //results
+		dReal point_stepsize;
+
+		void Friction();
+		void Friction_Reference(int i, dReal *mu1, dReal *mu2);
 
 		//rolling resistance
 		dJointID rollresjoint;